@@ -6,37 +6,72 @@
 #include <cstdlib>
 #include <cstdint>
 #include <algorithm>
+#include <iterator>
+#include <vector>
 #include "bst.h"
+#include "frozen_tree.h"
+#include "fork_join.h"
 
 struct KeyError { };
 
 /**
-* A special kind of node for an AVL tree, which adds the balance as a data member, plus
+* The subtree size an order statistic AVLTree keeps in each node. Plain AVL
+* trees get the empty version, which takes no room in the node, and whose
+* setter does nothing so the tree code can call it either way.
+*/
+template <bool Enabled>
+class SubtreeSize
+{
+public:
+    std::size_t getSize() const { return size_; }
+    void setSize(std::size_t size) { size_ = size; }
+
+protected:
+    std::size_t size_;
+};
+
+template <>
+class SubtreeSize<false>
+{
+public:
+    std::size_t getSize() const { return 0; }
+    void setSize(std::size_t) { }
+};
+
+/**
+* A special kind of node for an AVL tree, which adds the balance, plus
 * other additional helper functions. You do NOT need to implement any functionality or
 * add additional data members or helper functions.
+*
+* The balance is kept in the tag bits of the parent pointer (see Node in bst.h) as
+* balance + 2, so -2..2 fits in 3 bits and an AVLNode is exactly the size of a Node.
+* With CountSizes the node also holds the number of nodes in its subtree.
 */
-template <typename Key, typename Value>
-class AVLNode : public Node<Key, Value>
+template <typename Key, typename Value, bool CountSizes = false>
+class AVLNode : public Node<Key, Value>, public SubtreeSize<CountSizes>
 {
 public:
     // Constructor/destructor.
-    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value>* parent);
-    virtual ~AVLNode();
+    AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, CountSizes>* parent);
+    template<typename... Args>
+    AVLNode(InPlaceItem tag, AVLNode<Key, Value, CountSizes>* parent, Args&&... args);
+    ~AVLNode();
 
     // Getter/setter for the node's height.
     int8_t getBalance () const;
     void setBalance (int8_t balance);
     void updateBalance(int8_t diff);
 
-    // Getters for parent, left, and right. These need to be redefined since they
-    // return pointers to AVLNodes - not plain Nodes. See the Node class in bst.h
-    // for more information.
-    virtual AVLNode<Key, Value>* getParent() const override;
-    virtual AVLNode<Key, Value>* getLeft() const override;
-    virtual AVLNode<Key, Value>* getRight() const override;
+    // Getters for parent, left, and right. These hide the Node versions since they
+    // return pointers to AVLNodes - not plain Nodes. They are not virtual, so a call
+    // is just a load. See the Node class in bst.h for more information.
+    AVLNode<Key, Value, CountSizes>* getParent() const;
+    AVLNode<Key, Value, CountSizes>* getLeft() const;
+    AVLNode<Key, Value, CountSizes>* getRight() const;
 
 protected:
-    int8_t balance_;    // effectively a signed char
+    // the tag holds balance + 2 so the transient -2 and 2 fit too
+    static const int BALANCE_BIAS = 2;
 };
 
 /*
@@ -48,73 +83,87 @@ protected:
 /**
 * An explicit constructor to initialize the elements by calling the base class constructor
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value> *parent) :
-    Node<Key, Value>(key, value, parent), balance_(0)
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes>::AVLNode(const Key& key, const Value& value, AVLNode<Key, Value, CountSizes> *parent) :
+    Node<Key, Value>(key, value, parent)
+{
+    setBalance(0);
+    this->setSize(1);
+}
+
+/**
+* An in-place constructor that forwards the item arguments to the base class constructor
+*/
+template<class Key, class Value, bool CountSizes>
+template<typename... Args>
+AVLNode<Key, Value, CountSizes>::AVLNode(InPlaceItem tag, AVLNode<Key, Value, CountSizes> *parent, Args&&... args) :
+    Node<Key, Value>(tag, parent, std::forward<Args>(args)...)
 {
+    setBalance(0);
+    this->setSize(1);
 }
 
 /**
 * A destructor which does nothing.
 */
-template<class Key, class Value>
-AVLNode<Key, Value>::~AVLNode()
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes>::~AVLNode()
 {
 }
 
 /**
 * A getter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-int8_t AVLNode<Key, Value>::getBalance() const
+template<class Key, class Value, bool CountSizes>
+int8_t AVLNode<Key, Value, CountSizes>::getBalance() const
 {
-    return balance_;
+    return static_cast<int8_t>(static_cast<int>(this->getTag()) - BALANCE_BIAS);
 }
 
 /**
 * A setter for the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::setBalance(int8_t balance)
+template<class Key, class Value, bool CountSizes>
+void AVLNode<Key, Value, CountSizes>::setBalance(int8_t balance)
 {
-    balance_ = balance;
+    this->setTag(static_cast<unsigned>(balance + BALANCE_BIAS));
 }
 
 /**
 * Adds diff to the balance of a AVLNode.
 */
-template<class Key, class Value>
-void AVLNode<Key, Value>::updateBalance(int8_t diff)
+template<class Key, class Value, bool CountSizes>
+void AVLNode<Key, Value, CountSizes>::updateBalance(int8_t diff)
 {
-    balance_ += diff;
+    setBalance(static_cast<int8_t>(getBalance() + diff));
 }
 
 /**
-* An overridden function for getting the parent since a static_cast is necessary to make sure
+* A hiding function for getting the parent since a static_cast is necessary to make sure
 * that our node is a AVLNode.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getParent() const
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes> *AVLNode<Key, Value, CountSizes>::getParent() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->parent_);
+    return static_cast<AVLNode<Key, Value, CountSizes>*>(Node<Key, Value>::getParent());
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getLeft() const
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes> *AVLNode<Key, Value, CountSizes>::getLeft() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->left_);
+    return static_cast<AVLNode<Key, Value, CountSizes>*>(this->left_);
 }
 
 /**
-* Overridden for the same reasons as above.
+* Hidden for the same reasons as above.
 */
-template<class Key, class Value>
-AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes> *AVLNode<Key, Value, CountSizes>::getRight() const
 {
-    return static_cast<AVLNode<Key, Value>*>(this->right_);
+    return static_cast<AVLNode<Key, Value, CountSizes>*>(this->right_);
 }
 
 
@@ -125,98 +174,298 @@ AVLNode<Key, Value> *AVLNode<Key, Value>::getRight() const
 */
 
 
-template <class Key, class Value>
+template <class Key, class Value, bool CountSizes = false>
 class AVLTree : public BinarySearchTree<Key, Value>
 {
 public:
-    virtual void insert (const std::pair<const Key, Value> &new_item); // TODO
+    AVLTree();
+    template<typename ForwardIt>
+    AVLTree(ForwardIt first, ForwardIt last);
+    template<typename ForwardIt>
+    void assign(ForwardIt first, ForwardIt last);
+    virtual std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+    insert (const std::pair<const Key, Value> &new_item); // TODO
     virtual void remove(const Key& key);  // TODO
+
+    // the move-aware insert(P&&), try_emplace and insert_or_assign come from
+    // BinarySearchTree and make AVLNodes through createNode()
+    using BinarySearchTree<Key, Value>::insert;
+    // hides the BinarySearchTree version so the item is built inside an AVLNode
+    template<typename... Args>
+    std::pair<typename BinarySearchTree<Key, Value>::iterator, bool> emplace(Args&&... args);
+
+    // Order statistics, only for trees made with CountSizes (see OrderStatTree).
+    // Positions count from 0 in key order and ranges are [lo, hi).
+    typename BinarySearchTree<Key, Value>::iterator select(std::size_t index) const;
+    std::size_t rank(const Key& key) const;
+    std::size_t count_range(const Key& lo, const Key& hi) const;
+
+    // read-only copy in a flat cache friendly layout, see frozen_tree.h
+    FrozenTree<Key, Value> freeze() const;
+
+    // Moving whole key ranges between trees in O(log n), without copying
+    // nodes. Neither tree may use a node pool.
+    void split(const Key& key, AVLTree<Key, Value, CountSizes>& right);
+    void join(AVLTree<Key, Value, CountSizes>& right);
+
+    // Set algebra that takes over the other tree's nodes, leaving it empty.
+    // Where both trees have a key this tree's value is kept. With a pool,
+    // subproblems down to about grain nodes are forked across its threads.
+    void unite(AVLTree<Key, Value, CountSizes>& other, ForkJoinPool* pool = NULL, std::size_t grain = 4096);
+    void intersect(AVLTree<Key, Value, CountSizes>& other, ForkJoinPool* pool = NULL, std::size_t grain = 4096);
+    void subtract(AVLTree<Key, Value, CountSizes>& other, ForkJoinPool* pool = NULL, std::size_t grain = 4096);
 protected:
-    virtual void nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2);
+    virtual Node<Key, Value>* createNode(Node<Key, Value>* parent, std::pair<Key, Value>&& new_item);
+    virtual void rebalanceInsert(Node<Key, Value>* node);
+    virtual void nodeSwap( AVLNode<Key, Value, CountSizes>* n1, AVLNode<Key, Value, CountSizes>* n2);
 
     // Add helper functions here
-    void rotateright(AVLNode<Key,Value>* right);
-    void rotateleft(AVLNode<Key,Value>* left);
-    void insertfix(AVLNode<Key,Value>* node);
-    void removefix(AVLNode<Key,Value>* node);
+    void rotateright(AVLNode<Key, Value, CountSizes>* right);
+    void rotateleft(AVLNode<Key, Value, CountSizes>* left);
+    void insertfix(AVLNode<Key, Value, CountSizes>* node);
+    bool growfix(AVLNode<Key, Value, CountSizes>* node);
+    void removefix(AVLNode<Key, Value, CountSizes>* node, int8_t diff);
+    template<typename ForwardIt>
+    AVLNode<Key, Value, CountSizes>* buildSorted(ForwardIt& next, std::size_t count, int& height);
+    void replaceWith(AVLNode<Key, Value, CountSizes>* root, std::size_t count, int height);
+    static std::size_t subtreeSize(AVLNode<Key, Value, CountSizes>* node);
+    static void updateSize(AVLNode<Key, Value, CountSizes>* node);
+    static void adjustPathSizes(AVLNode<Key, Value, CountSizes>* node, std::size_t count, bool grow);
+    void checkMovable(const AVLTree<Key, Value, CountSizes>& other) const;
+    static void splitNode(AVLNode<Key, Value, CountSizes>* node, int height, const Key& key,
+                          AVLNode<Key, Value, CountSizes>*& less, int& lessHeight,
+                          AVLNode<Key, Value, CountSizes>*& match,
+                          AVLNode<Key, Value, CountSizes>*& more, int& moreHeight);
+    static AVLNode<Key, Value, CountSizes>* joinNodes(AVLNode<Key, Value, CountSizes>* left, int lheight,
+                                                      AVLNode<Key, Value, CountSizes>* mid,
+                                                      AVLNode<Key, Value, CountSizes>* right, int rheight, int& height);
+    static AVLNode<Key, Value, CountSizes>* joinNodes(AVLNode<Key, Value, CountSizes>* left, int lheight,
+                                                      AVLNode<Key, Value, CountSizes>* right, int rheight, int& height);
+
+    enum SetOp { UNITE, INTERSECT, SUBTRACT };
+    void setOperation(SetOp op, AVLTree<Key, Value, CountSizes>& other, ForkJoinPool* pool, std::size_t grain);
+    AVLNode<Key, Value, CountSizes>* setOperation(SetOp op, AVLNode<Key, Value, CountSizes>* a, int aheight,
+                                                  AVLNode<Key, Value, CountSizes>* b, int bheight, int& height,
+                                                  std::size_t& matches, ForkJoinPool* pool, int grainHeight);
 };
 
-/*
- * Recall: If key is already in the tree, you should 
- * overwrite the current value with the updated value.
- */
-template<class Key, class Value>
-void AVLTree<Key, Value>::insert (const std::pair<const Key, Value> &new_item)
+/**
+* An AVLTree that keeps subtree sizes, for select(), rank(), size() and
+* count_range() in O(log n). Inserts and removes pay one extra walk to the root.
+*/
+template <class Key, class Value>
+using OrderStatTree = AVLTree<Key, Value, true>;
+
+/**
+* Default constructor, which points the node policy at AVLNode.
+*/
+template<class Key, class Value, bool CountSizes>
+AVLTree<Key, Value, CountSizes>::AVLTree()
 {
-    // TODO
-    // if the tree is empty it needs to be inserted as the root_
-    if(this->root_ == nullptr){
-      this->root_ = new AVLNode<Key, Value>(new_item.first, new_item.second, nullptr);
-      // you can then return because you are done
+    this->destroyNode_ = &BinarySearchTree<Key, Value>::template destroyNodeAs<AVLNode<Key, Value, CountSizes> >;
+}
+
+/**
+* Range constructor, which builds the tree from key/value pairs in O(n)
+* when they are already sorted. See assign().
+*/
+template<class Key, class Value, bool CountSizes>
+template<typename ForwardIt>
+AVLTree<Key, Value, CountSizes>::AVLTree(ForwardIt first, ForwardIt last)
+{
+    this->destroyNode_ = &BinarySearchTree<Key, Value>::template destroyNodeAs<AVLNode<Key, Value, CountSizes> >;
+    assign(first, last);
+}
+
+/**
+* Replaces the contents of the tree with the key/value pairs in [first, last)
+* without going through insert. Input sorted by strictly increasing key is
+* built in place in O(n); anything else is copied, sorted and deduplicated
+* first (a repeated key keeps its last value, just like repeated inserts).
+* The result is as balanced as possible and every balance is set directly.
+* The old items are only dropped once the new nodes are all made, so if
+* making one throws the tree is left as it was.
+*/
+template<class Key, class Value, bool CountSizes>
+template<typename ForwardIt>
+void AVLTree<Key, Value, CountSizes>::assign(ForwardIt first, ForwardIt last)
+{
+    // one pass to see if the keys are already strictly increasing
+    bool sorted = true;
+    std::size_t count = 0;
+    ForwardIt prev = first;
+    for(ForwardIt it = first; it != last; ++it, ++count){
+      if(count > 0 && !KeyCompare<Key>::less(prev->first, it->first)){
+        sorted = false;
+        break;
+      }
+      prev = it;
+    }
+
+    int height = 0;
+    if(sorted){
+      ForwardIt next = first;
+      replaceWith(buildSorted(next, count, height), count, height);
       return;
     }
 
-    // create pointers to the node you are currently on and the prev one
-    AVLNode<Key, Value>* current = static_cast<AVLNode<Key, Value>*>(this->root_);
-    AVLNode<Key, Value>* prev = nullptr;
+    // otherwise sort a copy, stable so equal keys stay in input order
+    std::vector<std::pair<Key, Value> > items(first, last);
+    std::stable_sort(items.begin(), items.end(),
+      [](const std::pair<Key, Value>& a, const std::pair<Key, Value>& b){ return KeyCompare<Key>::less(a.first, b.first); });
 
-    // traverse until you reach the the node or bottom
-    while(current != nullptr){
+    // keep only the last of each run of equal keys
+    std::size_t kept = 0;
+    for(std::size_t i = 0; i < items.size(); ++i){
+      if(i + 1 < items.size() && !KeyCompare<Key>::less(items[i].first, items[i + 1].first)){
+        continue;
+      }
+      if(kept != i){
+        items[kept] = std::move(items[i]);
+      }
+      ++kept;
+    }
+    items.resize(kept);
 
-      // check if the its already inside each time to just overwrite
-      if(current->getKey() == new_item.first){
-        current->setValue(new_item.second);
-        // able to return nothing else to be done
-        return;
-        
-      } else {
-        // if not store your current as prev so you can move down
-        prev = current;
-
-        // figure out which way to go like in the other file
-        if(current->getKey() < new_item.first){
-          current = current->getRight();
-        } else if(current->getKey() > new_item.first){
-          current = current->getLeft();
-        }
+    // the copies are not needed afterwards, so their items are moved into the nodes
+    std::move_iterator<typename std::vector<std::pair<Key, Value> >::iterator> next(items.begin());
+    replaceWith(buildSorted(next, items.size(), height), items.size(), height);
+}
+
+// helper for assign that drops the current nodes and puts the detached
+// subtree root, with count keys and the given height, in their place
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::replaceWith(AVLNode<Key, Value, CountSizes>* root, std::size_t count, int height)
+{
+    if(this->pool_ == NULL){
+      this->clear();
+    } else {
+      // the new nodes share the pool, so its slabs cannot just be released
+      this->actualclear(this->root_);
+    }
+    this->root_ = root;
+    this->setCount(count);
+    this->height_ = height;
+}
+
+// helper that builds a perfectly balanced subtree from the next count items
+// in order (left subtree, then the node, then the right subtree) so the
+// input is only walked forward once. height is set to the subtree height.
+// If making a node throws, everything built so far is freed.
+template<class Key, class Value, bool CountSizes>
+template<typename ForwardIt>
+AVLNode<Key, Value, CountSizes>* AVLTree<Key, Value, CountSizes>::buildSorted(ForwardIt& next, std::size_t count, int& height)
+{
+    if(count == 0){
+      height = 0;
+      return nullptr;
+    }
+
+    // give the right side the extra node so balances are only ever 0 or 1
+    std::size_t leftcount = (count - 1) / 2;
+    std::size_t rightcount = count - 1 - leftcount;
+
+    int lheight = 0;
+    int rheight = 0;
+    AVLNode<Key, Value, CountSizes>* left = buildSorted(next, leftcount, lheight);
+    AVLNode<Key, Value, CountSizes>* node = nullptr;
+    AVLNode<Key, Value, CountSizes>* right = nullptr;
+    try {
+      node = this->template allocateNode<AVLNode<Key, Value, CountSizes> >(InPlaceItem(), nullptr, *next);
+      ++next;
+      right = buildSorted(next, rightcount, rheight);
+    } catch(...) {
+      // the calls below freed their own part already
+      this->actualclear(left);
+      if(node != nullptr){
+        this->freeNode(node);
       }
+      throw;
     }
 
-  // now that you have found the leaf location to insert create the node to 
-  // be inserted and make its parent the previous node
-  AVLNode<Key, Value>* insert = new AVLNode<Key, Value>(new_item.first, new_item.second, prev);
+    // hook up the children
+    node->setLeft(left);
+    if(left != nullptr){
+      left->setParent(node);
+    }
+    node->setRight(right);
+    if(right != nullptr){
+      right->setParent(node);
+    }
 
-  // figure out which child to set it to for the parent
-  if(prev->getKey() < new_item.first){
-    prev->setRight(insert);
-  } else if(prev->getKey() > new_item.first){
-    prev->setLeft(insert);
-  }
+    // balance is the right height minus the left height, as in insertfix
+    node->setBalance(static_cast<int8_t>(rheight - lheight));
+    node->setSize(count);
+    height = std::max(lheight, rheight) + 1;
+    return node;
+}
 
-  // then finally call the helper function to fix the the tree
-  insertfix(insert);
+/*
+ * Recall: If key is already in the tree, you should 
+ * overwrite the current value with the updated value.
+ */
+template<class Key, class Value, bool CountSizes>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+AVLTree<Key, Value, CountSizes>::insert (const std::pair<const Key, Value> &new_item)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    // TODO
+    // the shared insert does the descent and calls insertfix through rebalanceInsert
+    std::pair<Node<Key, Value>*, bool> result =
+        this->template insertItem<AVLNode<Key, Value, CountSizes> >(new_item);
+    return std::make_pair(this->makeIterator(result.first), result.second);
+}
+
+// the inserts that go through a base class reference make their nodes here
+template<class Key, class Value, bool CountSizes>
+Node<Key, Value>* AVLTree<Key, Value, CountSizes>::createNode(Node<Key, Value>* parent, std::pair<Key, Value>&& new_item)
+{
+    return this->template allocateNode<AVLNode<Key, Value, CountSizes> >(InPlaceItem(),
+        static_cast<AVLNode<Key, Value, CountSizes>*>(parent), std::move(new_item));
+}
+
+/**
+* In-place insert, see BinarySearchTree::emplace().
+*/
+template<class Key, class Value, bool CountSizes>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+AVLTree<Key, Value, CountSizes>::emplace(Args&&... args)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result =
+        this->template emplaceItem<AVLNode<Key, Value, CountSizes> >(std::forward<Args>(args)...);
+    return std::make_pair(this->makeIterator(result.first), result.second);
+}
+
+// hook the shared insert calls once the new node is linked in
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::rebalanceInsert(Node<Key, Value>* node)
+{
+    insertfix(static_cast<AVLNode<Key, Value, CountSizes>*>(node));
 }
 
 /*
  * Recall: The writeup specifies that if a node has 2 children you
  * should swap with the predecessor and then remove.
  */
-template<class Key, class Value>
-void AVLTree<Key, Value>:: remove(const Key& key)
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>:: remove(const Key& key)
 {
+    TREE_TIME(TREE_OP_REMOVE);
     // TODO
     // find and save the node that we are trying to remove from the tree
     // using the key
     // can use inherited function if you static cast and use this pointer
-    AVLNode<Key, Value>* removal = static_cast<AVLNode<Key, Value>*>(this->internalFind(key));
+    AVLNode<Key, Value, CountSizes>* removal = static_cast<AVLNode<Key, Value, CountSizes>*>(this->internalFind(key));
 
     // create another pointer to store the predecessor of the removal if it
     // has two children
-    AVLNode<Key, Value>* pred = nullptr;
+    AVLNode<Key, Value, CountSizes>* pred = nullptr;
 
     // create another 2 pointers to store its child and parent for later
-    AVLNode<Key, Value>* child = nullptr;
-    AVLNode<Key, Value>* parent = nullptr;
+    AVLNode<Key, Value, CountSizes>* child = nullptr;
+    AVLNode<Key, Value, CountSizes>* parent = nullptr;
 
 
     // can just stop if the key provided isnt in the tree
@@ -228,7 +477,7 @@ void AVLTree<Key, Value>:: remove(const Key& key)
     if(removal->getRight() != nullptr && removal->getLeft() != nullptr){
       // store its predecessor and swap them if so
       // have to static cast and use this to use old functions
-      pred = static_cast<AVLNode<Key, Value>*>(BinarySearchTree<Key, Value>::predecessor(removal));
+      pred = static_cast<AVLNode<Key, Value, CountSizes>*>(BinarySearchTree<Key, Value>::predecessor(removal));
       this->nodeSwap(removal, pred);
     }
 
@@ -267,26 +516,543 @@ void AVLTree<Key, Value>:: remove(const Key& key)
     }
 
     // finally delete the node
-    delete removal;
+    this->freeNode(removal);
+    if(this->getCount() != this->UNKNOWN_COUNT){
+      this->setCount(this->getCount() - 1);
+    }
 
-    // fix balance and call helper if needed 
-    if(parent != nullptr){
-      parent->updateBalance(balchange);
-      //
-      removefix(parent);
+    // fix balance starting at the parent that lost a child
+    removefix(parent, balchange);
+}
+
+/**
+* Returns an iterator to the key at the given position in key order, or
+* end() if there are not that many keys. Used for percentiles, e.g.
+* select(size() * 95 / 100).
+*/
+template<class Key, class Value, bool CountSizes>
+typename BinarySearchTree<Key, Value>::iterator
+AVLTree<Key, Value, CountSizes>::select(std::size_t index) const
+{
+    static_assert(CountSizes, "select() needs an AVLTree with CountSizes, see OrderStatTree");
+    AVLNode<Key, Value, CountSizes>* curr = static_cast<AVLNode<Key, Value, CountSizes>*>(this->root_);
+    TREE_STAT(descents);
+    while(curr != nullptr){
+      TREE_STAT(descentSteps);
+      std::size_t leftsize = subtreeSize(curr->getLeft());
+      if(index < leftsize){
+        curr = curr->getLeft();
+      } else if(index == leftsize){
+        break;
+      } else {
+        // skip the left subtree and this node
+        index -= leftsize + 1;
+        curr = curr->getRight();
+      }
+    }
+    return this->makeIterator(curr);
+}
+
+/**
+* Returns how many keys in the tree are less than the given key, which is
+* the position the key has (or would have) in key order.
+*/
+template<class Key, class Value, bool CountSizes>
+std::size_t AVLTree<Key, Value, CountSizes>::rank(const Key& key) const
+{
+    static_assert(CountSizes, "rank() needs an AVLTree with CountSizes, see OrderStatTree");
+    std::size_t below = 0;
+    AVLNode<Key, Value, CountSizes>* curr = static_cast<AVLNode<Key, Value, CountSizes>*>(this->root_);
+    TREE_STAT(descents);
+    while(curr != nullptr){
+      TREE_STAT(descentSteps);
+      // one comparison per level, like internalFind
+      if(KeyCompare<Key>::less(curr->getKey(), key)){
+        below += subtreeSize(curr->getLeft()) + 1;
+        curr = curr->getRight();
+      } else {
+        curr = curr->getLeft();
+      }
+    }
+    return below;
+}
+
+/**
+* Returns how many keys k in the tree have lo <= k < hi.
+*/
+template<class Key, class Value, bool CountSizes>
+std::size_t AVLTree<Key, Value, CountSizes>::count_range(const Key& lo, const Key& hi) const
+{
+    if(!KeyCompare<Key>::less(lo, hi)){
+      return 0;
+    }
+    return rank(hi) - rank(lo);
+}
+
+/**
+* Copies the tree into a FrozenTree, whose lookups walk one flat array
+* instead of chasing node pointers. The tree itself is left as it is, so
+* later changes to it are not seen by the snapshot.
+*/
+template<class Key, class Value, bool CountSizes>
+FrozenTree<Key, Value> AVLTree<Key, Value, CountSizes>::freeze() const
+{
+    return FrozenTree<Key, Value>(this->begin(), this->end());
+}
+
+/**
+* Moves every item with a key not less than key into right, which must be
+* empty, and keeps the ones below it. Runs in O(log n): the tree is cut
+* along the search path and the pieces are joined back up, no node is
+* copied or reallocated.
+*/
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::split(const Key& key, AVLTree<Key, Value, CountSizes>& right)
+{
+    checkMovable(right);
+    if(right.root_ != nullptr) throw std::logic_error("split() needs an empty tree for the upper keys");
+
+    AVLNode<Key, Value, CountSizes>* root = static_cast<AVLNode<Key, Value, CountSizes>*>(this->root_);
+    std::size_t count = this->getCount();
+    this->root_ = nullptr;
+
+    AVLNode<Key, Value, CountSizes>* less = nullptr;
+    AVLNode<Key, Value, CountSizes>* match = nullptr;
+    AVLNode<Key, Value, CountSizes>* more = nullptr;
+    int lessHeight = 0, moreHeight = 0;
+    splitNode(root, this->height_, key, less, lessHeight, match, more, moreHeight);
+    if(match != nullptr){
+      more = joinNodes(nullptr, 0, match, more, moreHeight, moreHeight);
+    }
+    this->root_ = less;
+    this->height_ = lessHeight;
+    right.root_ = more;
+    right.height_ = moreHeight;
+
+    // subtree sizes say how many keys went each way, without them that is
+    // only known when one side got all of them
+    if(CountSizes){
+      this->setCount(subtreeSize(less));
+      right.setCount(subtreeSize(more));
+    } else {
+      this->setCount(less == nullptr ? 0 : (more == nullptr ? count : this->UNKNOWN_COUNT));
+      right.setCount(more == nullptr ? 0 : (less == nullptr ? count : this->UNKNOWN_COUNT));
     }
 }
 
+/**
+* Moves every item of right onto the end of this tree, leaving right empty.
+* Every key here must be less than every key in right, otherwise
+* std::invalid_argument is thrown and neither tree changes. Runs in
+* O(log n).
+*/
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::join(AVLTree<Key, Value, CountSizes>& right)
+{
+    checkMovable(right);
+    if(right.root_ == nullptr){
+      return;
+    }
+    if(this->root_ == nullptr){
+      std::swap(this->root_, right.root_);
+      this->setCount(right.getCount());
+      right.setCount(0);
+      std::swap(this->height_, right.height_);
+      return;
+    }
+    if(!KeyCompare<Key>::less(this->getLargestNode()->getKey(), right.getSmallestNode()->getKey())){
+      throw std::invalid_argument("join() needs every key to be less than the other tree's keys");
+    }
+
+    // unlink the smallest node of right, it becomes the one that
+    // ties the two trees together
+    AVLNode<Key, Value, CountSizes>* mid = static_cast<AVLNode<Key, Value, CountSizes>*>(right.getSmallestNode());
+    AVLNode<Key, Value, CountSizes>* parent = mid->getParent();
+    AVLNode<Key, Value, CountSizes>* child = mid->getRight();
+    if(parent == nullptr){
+      right.root_ = child;
+    } else {
+      parent->setLeft(child);
+    }
+    if(child != nullptr){
+      child->setParent(parent);
+    }
+    right.removefix(parent, 1);
+
+    AVLNode<Key, Value, CountSizes>* lroot = static_cast<AVLNode<Key, Value, CountSizes>*>(this->root_);
+    AVLNode<Key, Value, CountSizes>* rroot = static_cast<AVLNode<Key, Value, CountSizes>*>(right.root_);
+    this->root_ = joinNodes(lroot, this->height_, mid, rroot, right.height_, this->height_);
+    if(this->getCount() == this->UNKNOWN_COUNT || right.getCount() == this->UNKNOWN_COUNT){
+      this->setCount(this->UNKNOWN_COUNT);
+    } else {
+      this->setCount(this->getCount() + right.getCount());
+    }
+    right.root_ = nullptr;
+    right.setCount(0);
+    right.height_ = 0;
+}
+
+/**
+* Adds every item of other whose key is not here yet, leaving other empty.
+* Costs O(m log(n/m + 1)) for trees of m <= n keys, rather than one
+* insert per item.
+*/
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::unite(AVLTree<Key, Value, CountSizes>& other, ForkJoinPool* pool, std::size_t grain)
+{
+    setOperation(UNITE, other, pool, grain);
+}
+
+/**
+* Keeps only the keys that other has too, leaving other empty.
+*/
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::intersect(AVLTree<Key, Value, CountSizes>& other, ForkJoinPool* pool, std::size_t grain)
+{
+    setOperation(INTERSECT, other, pool, grain);
+}
+
+/**
+* Removes every key that other has, leaving other empty.
+*/
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::subtract(AVLTree<Key, Value, CountSizes>& other, ForkJoinPool* pool, std::size_t grain)
+{
+    setOperation(SUBTRACT, other, pool, grain);
+}
+
+// helper that reads the size of a possibly empty subtree
+template<class Key, class Value, bool CountSizes>
+std::size_t AVLTree<Key, Value, CountSizes>::subtreeSize(AVLNode<Key, Value, CountSizes>* node)
+{
+    return node == nullptr ? 0 : node->getSize();
+}
+
+// helper that recomputes a node's size from its children
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::updateSize(AVLNode<Key, Value, CountSizes>* node)
+{
+    node->setSize(subtreeSize(node->getLeft()) + subtreeSize(node->getRight()) + 1);
+}
+
+// helper that adds count to or takes it from the size of node and all its ancestors
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::adjustPathSizes(AVLNode<Key, Value, CountSizes>* node, std::size_t count, bool grow)
+{
+    for(; node != nullptr; node = node->getParent()){
+      TREE_STAT(retraceSteps);
+      node->setSize(grow ? node->getSize() + count : node->getSize() - count);
+    }
+}
+
+// helper that refuses to move nodes into or out of a tree with a node pool,
+// since each pool can only take back its own nodes
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::checkMovable(const AVLTree<Key, Value, CountSizes>& other) const
+{
+    if(this->poolSlabNodes_ != 0 || other.poolSlabNodes_ != 0){
+      throw std::logic_error("moving nodes between trees needs trees without node pools");
+    }
+}
+
+// helper for split that cuts the detached subtree at node, which is height
+// tall, into detached subtrees of the keys less than and greater than key,
+// and the node with key itself if there is one
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::splitNode(AVLNode<Key, Value, CountSizes>* node, int height, const Key& key,
+                                                AVLNode<Key, Value, CountSizes>*& less, int& lessHeight,
+                                                AVLNode<Key, Value, CountSizes>*& match,
+                                                AVLNode<Key, Value, CountSizes>*& more, int& moreHeight)
+{
+    if(node == nullptr){
+      less = match = more = nullptr;
+      lessHeight = moreHeight = 0;
+      return;
+    }
+
+    // the balance says which child is the shorter one
+    AVLNode<Key, Value, CountSizes>* left = node->getLeft();
+    AVLNode<Key, Value, CountSizes>* right = node->getRight();
+    int lheight = node->getBalance() > 0 ? height - 2 : height - 1;
+    int rheight = node->getBalance() < 0 ? height - 2 : height - 1;
+    if(left != nullptr){
+      left->setParent(nullptr);
+    }
+    if(right != nullptr){
+      right->setParent(nullptr);
+    }
+
+    // split the side the key falls in, then node joins what is left of
+    // that side back to the untouched one
+    if(KeyCompare<Key>::less(key, node->getKey())){
+      splitNode(left, lheight, key, less, lessHeight, match, more, moreHeight);
+      more = joinNodes(more, moreHeight, node, right, rheight, moreHeight);
+    } else if(KeyCompare<Key>::less(node->getKey(), key)){
+      splitNode(right, rheight, key, less, lessHeight, match, more, moreHeight);
+      less = joinNodes(left, lheight, node, less, lessHeight, lessHeight);
+    } else {
+      less = left;
+      lessHeight = lheight;
+      more = right;
+      moreHeight = rheight;
+      match = node;
+      node->setLeft(nullptr);
+      node->setRight(nullptr);
+    }
+}
+
+// helper that joins the detached subtrees left and right, of the given
+// heights, under mid, whose key falls between them. mid is hung off the
+// edge of the taller one where the shorter one is about as tall, then
+// growfix rebalances upwards inside a scratch tree, whose root_ the
+// rotations keep pointing at the top. Sets height to the result's.
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes>* AVLTree<Key, Value, CountSizes>::joinNodes(AVLNode<Key, Value, CountSizes>* left, int lheight,
+                                                                           AVLNode<Key, Value, CountSizes>* mid,
+                                                                           AVLNode<Key, Value, CountSizes>* right, int rheight, int& height)
+{
+    mid->setParent(nullptr);
+    if(lheight <= rheight + 1 && rheight <= lheight + 1){
+      mid->setLeft(left);
+      mid->setRight(right);
+      if(left != nullptr){
+        left->setParent(mid);
+      }
+      if(right != nullptr){
+        right->setParent(mid);
+      }
+      mid->setBalance(rheight - lheight);
+      if(CountSizes){
+        updateSize(mid);
+      }
+      height = std::max(lheight, rheight) + 1;
+      return mid;
+    }
+
+    AVLTree<Key, Value, CountSizes> scratch;
+    if(lheight > rheight){
+      // walk down the right edge of left to the first subtree that is at
+      // most one taller than right
+      AVLNode<Key, Value, CountSizes>* spot = left;
+      AVLNode<Key, Value, CountSizes>* above = nullptr;
+      int h = lheight;
+      while(h > rheight + 1){
+        above = spot;
+        h -= spot->getBalance() < 0 ? 2 : 1;
+        spot = spot->getRight();
+      }
+      mid->setLeft(spot);
+      mid->setRight(right);
+      if(spot != nullptr){
+        spot->setParent(mid);
+      }
+      if(right != nullptr){
+        right->setParent(mid);
+      }
+      mid->setBalance(rheight - h);
+      above->setRight(mid);
+      mid->setParent(above);
+      if(CountSizes){
+        updateSize(mid);
+        adjustPathSizes(above, subtreeSize(right) + 1, true);
+      }
+      scratch.root_ = left;
+      height = scratch.growfix(mid) ? lheight + 1 : lheight;
+    } else {
+      // same down the left edge of right
+      AVLNode<Key, Value, CountSizes>* spot = right;
+      AVLNode<Key, Value, CountSizes>* above = nullptr;
+      int h = rheight;
+      while(h > lheight + 1){
+        above = spot;
+        h -= spot->getBalance() > 0 ? 2 : 1;
+        spot = spot->getLeft();
+      }
+      mid->setLeft(left);
+      mid->setRight(spot);
+      if(spot != nullptr){
+        spot->setParent(mid);
+      }
+      if(left != nullptr){
+        left->setParent(mid);
+      }
+      mid->setBalance(h - lheight);
+      above->setLeft(mid);
+      mid->setParent(above);
+      if(CountSizes){
+        updateSize(mid);
+        adjustPathSizes(above, subtreeSize(left) + 1, true);
+      }
+      scratch.root_ = right;
+      height = scratch.growfix(mid) ? rheight + 1 : rheight;
+    }
+
+    AVLNode<Key, Value, CountSizes>* joined = static_cast<AVLNode<Key, Value, CountSizes>*>(scratch.root_);
+    scratch.root_ = nullptr;
+    return joined;
+}
+
+// helper that joins two detached subtrees with no node in between, by
+// taking the smallest node of right out to go between them
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes>* AVLTree<Key, Value, CountSizes>::joinNodes(AVLNode<Key, Value, CountSizes>* left, int lheight,
+                                                                           AVLNode<Key, Value, CountSizes>* right, int rheight, int& height)
+{
+    if(left == nullptr){
+      height = rheight;
+      return right;
+    }
+    if(right == nullptr){
+      height = lheight;
+      return left;
+    }
+    AVLNode<Key, Value, CountSizes>* smallest = right;
+    while(smallest->getLeft() != nullptr){
+      smallest = smallest->getLeft();
+    }
+    AVLNode<Key, Value, CountSizes>* less = nullptr;
+    AVLNode<Key, Value, CountSizes>* mid = nullptr;
+    AVLNode<Key, Value, CountSizes>* more = nullptr;
+    int lessHeight = 0, moreHeight = 0;
+    splitNode(right, rheight, smallest->getKey(), less, lessHeight, mid, more, moreHeight);
+    return joinNodes(left, lheight, mid, more, moreHeight, height);
+}
+
+// helper that runs a set operation on the whole of both trees
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::setOperation(SetOp op, AVLTree<Key, Value, CountSizes>& other,
+                                                   ForkJoinPool* pool, std::size_t grain)
+{
+    checkMovable(other);
+    if(&other == this){
+      return;
+    }
+    // a subtree this tall has at least about grain nodes on its fuller side
+    int grainHeight = 1;
+    while(grainHeight < 64 && (std::size_t(1) << grainHeight) <= grain){
+      ++grainHeight;
+    }
+
+    AVLNode<Key, Value, CountSizes>* a = static_cast<AVLNode<Key, Value, CountSizes>*>(this->root_);
+    AVLNode<Key, Value, CountSizes>* b = static_cast<AVLNode<Key, Value, CountSizes>*>(other.root_);
+    std::size_t acount = this->getCount();
+    std::size_t bcount = other.getCount();
+    std::size_t matches = 0;
+    this->root_ = setOperation(op, a, this->height_, b, other.height_, this->height_, matches, pool, grainHeight);
+    other.root_ = nullptr;
+    other.setCount(0);
+    other.height_ = 0;
+
+    // the keys both trees had are enough to work out the new count
+    if(acount == this->UNKNOWN_COUNT || bcount == this->UNKNOWN_COUNT){
+      this->setCount(this->UNKNOWN_COUNT);
+    } else if(op == UNITE){
+      this->setCount(acount + bcount - matches);
+    } else if(op == INTERSECT){
+      this->setCount(matches);
+    } else {
+      this->setCount(acount - matches);
+    }
+}
+
+// recursive helper for the set operations on detached subtrees: b is cut
+// at the key of a's root, the two halves are solved on their own (forked
+// when both are big enough) and joined back, with a's root in between if
+// the result keeps it. Nodes that drop out are freed.
+template<class Key, class Value, bool CountSizes>
+AVLNode<Key, Value, CountSizes>* AVLTree<Key, Value, CountSizes>::setOperation(SetOp op,
+                                                                              AVLNode<Key, Value, CountSizes>* a, int aheight,
+                                                                              AVLNode<Key, Value, CountSizes>* b, int bheight, int& height,
+                                                                              std::size_t& matches, ForkJoinPool* pool, int grainHeight)
+{
+    matches = 0;
+    if(a == nullptr){
+      if(op == UNITE){
+        height = bheight;
+        return b;
+      }
+      this->actualclear(b);
+      height = 0;
+      return nullptr;
+    }
+    if(b == nullptr){
+      if(op == INTERSECT){
+        this->actualclear(a);
+        height = 0;
+        return nullptr;
+      }
+      height = aheight;
+      return a;
+    }
+
+    // take a apart at its root
+    AVLNode<Key, Value, CountSizes>* aleft = a->getLeft();
+    AVLNode<Key, Value, CountSizes>* aright = a->getRight();
+    int alheight = a->getBalance() > 0 ? aheight - 2 : aheight - 1;
+    int arheight = a->getBalance() < 0 ? aheight - 2 : aheight - 1;
+    if(aleft != nullptr){
+      aleft->setParent(nullptr);
+    }
+    if(aright != nullptr){
+      aright->setParent(nullptr);
+    }
+
+    AVLNode<Key, Value, CountSizes>* bless = nullptr;
+    AVLNode<Key, Value, CountSizes>* match = nullptr;
+    AVLNode<Key, Value, CountSizes>* bmore = nullptr;
+    int blheight = 0, bmheight = 0;
+    splitNode(b, bheight, a->getKey(), bless, blheight, match, bmore, bmheight);
+
+    AVLNode<Key, Value, CountSizes>* left = nullptr;
+    AVLNode<Key, Value, CountSizes>* right = nullptr;
+    int lheight = 0, rheight = 0;
+    std::size_t lmatches = 0, rmatches = 0;
+    auto solveLeft = [&]() {
+      left = setOperation(op, aleft, alheight, bless, blheight, lheight, lmatches, pool, grainHeight);
+    };
+    auto solveRight = [&]() {
+      right = setOperation(op, aright, arheight, bmore, bmheight, rheight, rmatches, pool, grainHeight);
+    };
+    if(pool != NULL && std::max(alheight, blheight) >= grainHeight && std::max(arheight, bmheight) >= grainHeight){
+      // the right half may run on a worker, so its counts are carried
+      // back to this thread
+      TreeOpStats rightStats;
+      pool->invoke(solveLeft, [&]() {
+        TreeOpStats before = treeOpStats();
+        solveRight();
+        rightStats = takeTreeOpStats(before);
+      });
+      addTreeOpStats(rightStats);
+    } else {
+      solveLeft();
+      solveRight();
+    }
+
+    // a's item wins over a copy of its key in b
+    matches = lmatches + rmatches;
+    if(match != nullptr){
+      this->freeNode(match);
+      ++matches;
+    }
+    bool keep = op == UNITE || (op == INTERSECT) == (match != nullptr);
+    if(keep){
+      return joinNodes(left, lheight, a, right, rheight, height);
+    }
+    this->freeNode(a);
+    return joinNodes(left, lheight, right, rheight, height);
+}
+
 // helper for rotating right
-template<class Key, class Value>
-void AVLTree<Key, Value>:: rotateright(AVLNode<Key,Value>* right){
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>:: rotateright(AVLNode<Key, Value, CountSizes>* right){
     // TODO
+    TREE_STAT(rotateRights);
     // store the 4 nodes to be used so that there can be no issues with
     // the order of operations and nothing is lost
-    AVLNode<Key, Value>* oroot = right;
-    AVLNode<Key, Value>* nroot = right->getLeft();
-    AVLNode<Key, Value>* parent = right->getParent();
-    AVLNode<Key, Value>* rchild = nroot->getRight();
+    AVLNode<Key, Value, CountSizes>* oroot = right;
+    AVLNode<Key, Value, CountSizes>* nroot = right->getLeft();
+    AVLNode<Key, Value, CountSizes>* parent = right->getParent();
+    AVLNode<Key, Value, CountSizes>* rchild = nroot->getRight();
 
     // Connect the new root to the old parent if there is one
     if(parent != nullptr){
@@ -312,18 +1078,25 @@ void AVLTree<Key, Value>:: rotateright(AVLNode<Key,Value>* right){
     if(rchild != nullptr){
       rchild->setParent(oroot);
     }
+
+    // the old root is now below the new one, so size it first
+    if(CountSizes){
+      updateSize(oroot);
+      updateSize(nroot);
+    }
 }
 
 // helper for rotating left
-template<class Key, class Value>
-void AVLTree<Key, Value>:: rotateleft(AVLNode<Key,Value>* left){
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>:: rotateleft(AVLNode<Key, Value, CountSizes>* left){
     // TODO
+    TREE_STAT(rotateLefts);
     // store the 4 nodes to be used so that there can be no issues with
     // the order of operations and nothing is lost
-    AVLNode<Key, Value>* oroot = left;
-    AVLNode<Key, Value>* nroot = left->getRight();
-    AVLNode<Key, Value>* parent = left->getParent();
-    AVLNode<Key, Value>* lchild = nroot->getLeft();
+    AVLNode<Key, Value, CountSizes>* oroot = left;
+    AVLNode<Key, Value, CountSizes>* nroot = left->getRight();
+    AVLNode<Key, Value, CountSizes>* parent = left->getParent();
+    AVLNode<Key, Value, CountSizes>* lchild = nroot->getLeft();
 
     // Connect the new root to the old parent if there is one
     if(parent != nullptr){
@@ -349,21 +1122,44 @@ void AVLTree<Key, Value>:: rotateleft(AVLNode<Key,Value>* left){
     if(lchild != nullptr){
       lchild->setParent(oroot);
     }
+
+    // the old root is now below the new one, so size it first
+    if(CountSizes){
+      updateSize(oroot);
+      updateSize(nroot);
+    }
 }
 
 // helper for fixing the balance after inserting
-template<class Key, class Value>
-void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>:: insertfix(AVLNode<Key, Value, CountSizes>* node){
     // TODO
     // REMEMBER BALANCE IS L-R
-    // get its parent and the while loop of traversal will go until
-    // this parent is nullptr (the current node is the root)
-    AVLNode<Key, Value>* parent = node->getParent();
+    AVLNode<Key, Value, CountSizes>* parent = node->getParent();
 
-    // also save a copy of the insertion so it can be edited
-    AVLNode<Key, Value>* current = node;
+    // every ancestor gains a node, even above where growfix stops;
+    // rotations then recompute the sizes of the nodes they move
+    if(CountSizes){
+      adjustPathSizes(parent, 1, true);
+    }
+
+    // the new leaf made its spot one level taller
+    if(growfix(node)){
+      this->height_++;
+    }
+}
+
+// helper for fixing the balance after the subtree at node got one level
+// taller, returns true if the whole tree did
+template<class Key, class Value, bool CountSizes>
+bool AVLTree<Key, Value, CountSizes>:: growfix(AVLNode<Key, Value, CountSizes>* node){
+    // the while loop of traversal will go until this parent is nullptr
+    // (the current node is the root)
+    AVLNode<Key, Value, CountSizes>* parent = node->getParent();
+    AVLNode<Key, Value, CountSizes>* current = node;
 
     while(parent != nullptr){
+      TREE_STAT(retraceSteps);
       // branch for which side it was added to (start with right)
       if(parent->getRight() == current){
 
@@ -372,7 +1168,7 @@ void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
 
         // check if its fully balanced so you can stop early because the child only helped
         if(parent->getBalance() == 0){
-          break;
+          return false;
         }
 
         // check if its fully unbalanced and fix if so
@@ -383,7 +1179,7 @@ void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
           if(current->getBalance() == -1){
 
             // current = right and child = left so store its child and balance
-            AVLNode<Key, Value>* child = current->getLeft();
+            AVLNode<Key, Value, CountSizes>* child = current->getLeft();
             int8_t childbal = child->getBalance();
 
             // rotate the child right and parent left
@@ -408,20 +1204,27 @@ void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
 
           // branch for if it needs double or single (single second)
           else if(current->getBalance() == 1){
-            // save child to change balances later
-            AVLNode<Key, Value>* child = current->getRight();
-
             // current = right and child = right so just rotate left with parent
             rotateleft(parent);
 
-            // now change balances to 0 because it is a triangle
-            child->setBalance(0);
+            // now change balances to 0, the child keeps its own balance
+            // since its subtrees do not move
             current->setBalance(0);
             parent->setBalance(0);
           }
 
+          // a balanced child only happens after a join, the rotation
+          // leaves the subtree one taller so keep going up from it
+          else {
+            rotateleft(parent);
+            current->setBalance(-1);
+            parent->setBalance(1);
+            parent = current->getParent();
+            continue;
+          }
+
           // now break because both cases where it was unbalanced we fixed it
-          break;
+          return false;
         }
         
       // branch for which side it was added to (finish with left)
@@ -432,7 +1235,7 @@ void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
 
         // check if its fully balanced so you can stop early because the child only helped
         if(parent->getBalance() == 0){
-          break;
+          return false;
         }
 
         // check if its fully unbalanced and fix if so
@@ -443,7 +1246,7 @@ void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
           if(current->getBalance() == 1){
 
             // current = left and child = right so store its child and balance
-            AVLNode<Key, Value>* child = current->getRight();
+            AVLNode<Key, Value, CountSizes>* child = current->getRight();
             int8_t childbal = child->getBalance();
 
             // rotate the child left and parent right
@@ -468,20 +1271,27 @@ void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
 
           // branch for if it needs double or single (single second)
           else if(current->getBalance() == -1){
-            // save child to change balances later
-            AVLNode<Key, Value>* child = current->getLeft();
-
             // current = left and child = left so just rotate right with parent
             rotateright(parent);
 
-            // now change balances to 0 because it is a triangle
-            child->setBalance(0);
+            // now change balances to 0, the child keeps its own balance
+            // since its subtrees do not move
             current->setBalance(0);
             parent->setBalance(0);
           }
 
+          // a balanced child only happens after a join, the rotation
+          // leaves the subtree one taller so keep going up from it
+          else {
+            rotateright(parent);
+            current->setBalance(1);
+            parent->setBalance(-1);
+            parent = current->getParent();
+            continue;
+          }
+
           // now break because both cases where it was unbalanced we fixed it
-          break;
+          return false;
         }
       }
 
@@ -489,177 +1299,179 @@ void AVLTree<Key, Value>:: insertfix(AVLNode<Key,Value>* node){
       current = parent;
       parent = parent->getParent();
     }
+    // the growth reached the root
+    return true;
 }
 
 // helper for fixing the balance after removing
-template<class Key, class Value>
-void AVLTree<Key, Value>:: removefix(AVLNode<Key,Value>* node){
+// node is the node whose subtree just got shorter on one side and
+// diff is the change to its balance (+1 lost a left level, -1 a right one)
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>:: removefix(AVLNode<Key, Value, CountSizes>* node, int8_t diff){
     // TODO
     // REMEMBER BALANCE IS L-R
-    // Save a copy of the parent so it can be edited
-    AVLNode<Key, Value>* current = node;
-    AVLNode<Key, Value>* parent = nullptr;
-
-    // get its parent and the while loop of traversal will go until
-    // this parent is nullptr (the current node is the root)
-    if(current != nullptr && current->getParent() != nullptr){
-      parent = current->getParent();
-    } else {
-      return;
+    // every ancestor of the removed node lost one, even above where the loop stops
+    if(CountSizes){
+      adjustPathSizes(node, 1, false);
     }
 
-    while(parent != nullptr){
-      // branch for which side was removed (start with right)
-      if(parent->getRight() == current){
-        // update the balance of the parent accordingly
-        parent->updateBalance(-1);
+    AVLNode<Key, Value, CountSizes>* current = node;
 
-        // if parent has a balance of 0 can't change anything
-        // but still need to move up so don't check
+    while(current != nullptr){
+      TREE_STAT(retraceSteps);
+      // figure out where to go next before any rotation moves current
+      AVLNode<Key, Value, CountSizes>* parent = current->getParent();
+      int8_t nextdiff = 0;
+      if(parent != nullptr){
+        if(parent->getLeft() == current){
+          nextdiff = 1;
+        } else {
+          nextdiff = -1;
+        }
+      }
 
-        // check if the new balance is now -1 
-        //(would've been balanced so just lost 1 child and no height changed)
-        if(parent->getBalance() == -1){
-          break;
+      // update the balance of the current node accordingly
+      current->updateBalance(diff);
 
-        }
+      // check if the new balance is now -1 or 1
+      //(would've been balanced so just lost 1 child and no height changed)
+      if(current->getBalance() == -1 || current->getBalance() == 1){
+        break;
+      }
 
-        // now check if new balance is 2 where you need to rotate
-        if(parent->getBalance() == -2){
-            // we now know the child is on the left so store it
-            AVLNode<Key, Value>* child = parent->getLeft();
+      // now check if new balance is -2 where you need to rotate
+      if(current->getBalance() == -2){
+          // we now know the child is on the left so store it
+          AVLNode<Key, Value, CountSizes>* child = current->getLeft();
 
-            // branch for if child is balanced
-            if(child->getBalance() == 0){
-              // left child and both children 
-              rotateright(parent);
-              // adjust balances
-              child->setBalance(1);
-              parent->setBalance(-1);
-              // break here because height doesn't increase or decrease
-              break;
-            }
+          // branch for if child is balanced
+          if(child->getBalance() == 0){
+            // left child and both children 
+            rotateright(current);
+            // adjust balances
+            child->setBalance(1);
+            current->setBalance(-1);
+            // break here because height doesn't increase or decrease
+            break;
+          }
 
-            // branch for if child has left child
-            else if(child->getBalance() == -1){
-             // left child and left child 
-              rotateright(parent);
-              // adjust balances
+          // branch for if child has left child
+          else if(child->getBalance() == -1){
+           // left child and left child 
+            rotateright(current);
+            // adjust balances
+            child->setBalance(0);
+            current->setBalance(0);
+            // don't break because height decreased
+          }
+
+          // branch for if child has right child
+          else if(child->getBalance() == 1){
+            // left child and right child so store its child and balance
+            AVLNode<Key, Value, CountSizes>* gchild = child->getRight();
+            int8_t gchildbal = gchild->getBalance();
+
+            // rotate the gchild left and child right
+            rotateleft(child);
+            rotateright(current);
+
+            // update the balances depending on its original
+            if(gchildbal == 0){
               child->setBalance(0);
-              parent->setBalance(0);
-              // don't break because height decreased
+              gchild->setBalance(0);
+              current->setBalance(0);
+            }   else if(gchildbal == -1){
+              child->setBalance(0);
+              gchild->setBalance(0);
+              current->setBalance(1);
+            } else if(gchildbal == 1){
+              child->setBalance(-1);
+              gchild->setBalance(0);
+              current->setBalance(0);
             }
+            // don't break because height decreased
+          }
+      }
 
-            // branch for if child has right child
-            else if(child->getBalance() == 1){
-              // left child and right child so store its child and balance
-              AVLNode<Key, Value>* gchild = child->getRight();
-              int8_t gchildbal = gchild->getBalance();
-
-              // rotate the gchild left and child right
-              rotateleft(child);
-              rotateright(parent);
-
-              // update the balances depending on its original
-              if(gchildbal == 0){
-                child->setBalance(0);
-                gchild->setBalance(0);
-                parent->setBalance(0);
-              }   else if(gchildbal == -1){
-                child->setBalance(0);
-                gchild->setBalance(0);
-                parent->setBalance(1);
-              } else if(gchildbal == 1){
-                child->setBalance(-1);
-                gchild->setBalance(0);
-                parent->setBalance(0);
-              }
-              // don't break because height decreased
-            }
-        }
-      // branch for which side was removed (end with left)
-      } else if(parent->getLeft() == current){
-        // update the balance of the parent accordingly
-        parent->updateBalance(1);
+      // now check if new balance is 2 where you need to rotate
+      else if(current->getBalance() == 2){
+          // we now know the child is on the right so store it
+          AVLNode<Key, Value, CountSizes>* child = current->getRight();
 
-        // if parent has a balance of 0 can't change anything
-        // but still need to move up so don't check
+         // branch for if child is balanced
+          if(child->getBalance() == 0){
+            // right child and both children 
+            rotateleft(current);
+            // adjust balances
+            child->setBalance(-1);
+            current->setBalance(1);
+            // break here because height doesn't increase or decrease
+            break;
+          }
 
-        // check if the new balance is now 1 
-        //(would've been balanced so just lost 1 child and no height changed)
-        if(parent->getBalance() == 1){
-          break;
+          // branch for if child has right child
+          else if(child->getBalance() == 1){
+            // right child and right child 
+            rotateleft(current);
+            // adjust balances
+            child->setBalance(0);
+            current->setBalance(0);
+            // don't break because height decreased
+          }
 
-        }
-        // now check if new balance is 2 where you need to rotate
-        if(parent->getBalance() == 2){
-            // we now know the child is on the right so store it
-            AVLNode<Key, Value>* child = parent->getRight();
-
-           // branch for if child is balanced
-            if(child->getBalance() == 0){
-              // right child and both children 
-             rotateleft(parent);
-              // adjust balances
-              child->setBalance(-1);
-              parent->setBalance(1);
-              // break here because height doesn't increase or decrease
-              break;
-            }
+          // branch for if child has left child
+          else if(child->getBalance() == -1){
+            // right child and left child so store its child and balance
+            AVLNode<Key, Value, CountSizes>* gchild = child->getLeft();
+            int8_t gchildbal = gchild->getBalance();
+
+            // rotate the child right and parent left
+            rotateright(child);
+            rotateleft(current);
 
-            // branch for if child has right child
-            else if(child->getBalance() == 1){
-              // right child and right child 
-              rotateleft(parent);
-              // adjust balances
+            // update the balances depending on its original
+            if(gchildbal == 0){
               child->setBalance(0);
-              parent->setBalance(0);
-              // don't break because height decreased
+              gchild->setBalance(0);
+              current->setBalance(0);
+            } else if(gchildbal == -1){
+              child->setBalance(1);
+              gchild->setBalance(0);
+              current->setBalance(0);
+            } else if(gchildbal == 1){
+              child->setBalance(0);
+              gchild->setBalance(0);
+              current->setBalance(-1);
             }
-
-            // branch for if child has left child
-            else if(child->getBalance() == -1){
-              // right child and left child so store its child and balance
-              AVLNode<Key, Value>* gchild = child->getLeft();
-              int8_t gchildbal = gchild->getBalance();
-
-              // rotate the child right and parent left
-              rotateright(child);
-              rotateleft(parent);
-
-              // update the balances depending on its original
-              if(gchildbal == 0){
-                child->setBalance(0);
-                gchild->setBalance(0);
-                parent->setBalance(0);
-              } else if(gchildbal == -1){
-                child->setBalance(1);
-                gchild->setBalance(0);
-                parent->setBalance(0);
-              } else if(gchildbal == 1){
-                child->setBalance(0);
-                gchild->setBalance(0);
-                parent->setBalance(-1);
-              }
-              // don't break because height decreased
-           }
-        }
+            // don't break because height decreased
+         }
       }
-      // finally update for traversal
-        current = parent;
-        parent = parent->getParent();
+
+      // if the balance is 0 the height went down so keep going up,
+      // using the parent saved before any rotation
+      current = parent;
+      diff = nextdiff;
+    }
+
+    // ran off the top, so the whole tree is one shorter
+    if(current == nullptr){
+      this->height_--;
     }
 }
 
 
 
-template<class Key, class Value>
-void AVLTree<Key, Value>::nodeSwap( AVLNode<Key,Value>* n1, AVLNode<Key,Value>* n2)
+template<class Key, class Value, bool CountSizes>
+void AVLTree<Key, Value, CountSizes>::nodeSwap( AVLNode<Key, Value, CountSizes>* n1, AVLNode<Key, Value, CountSizes>* n2)
 {
     BinarySearchTree<Key, Value>::nodeSwap(n1, n2);
     int8_t tempB = n1->getBalance();
     n1->setBalance(n2->getBalance());
     n2->setBalance(tempB);
+    // sizes belong to the position in the tree, like balances
+    std::size_t tempS = n1->getSize();
+    n1->setSize(n2->getSize());
+    n2->setSize(tempS);
 }
 
 
@@ -0,0 +1,99 @@
+#ifndef BENCH_KEYS_H
+#define BENCH_KEYS_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+/**
+* Key workloads shared by the benchmarks, so they all skew their keys the
+* same way. Everything is seeded, so two runs do the same work.
+*/
+
+/**
+* Draws ranks 0 to n - 1, rank r coming up in proportion to
+* 1 / (r + 1)^exponent, so with an exponent near 1 a few ranks take most
+* of the draws. Like the <random> distributions it is called with the
+* engine to draw from, which the caller may go on using for other things.
+* Each draw is a binary search of the cumulative weights.
+*/
+class ZipfianDistribution
+{
+public:
+    ZipfianDistribution(std::size_t n, double exponent);
+
+    template<typename Engine>
+    std::size_t operator()(Engine& engine) const;
+
+    std::size_t size() const;
+
+private:
+    // cdf_[r] is the total weight of ranks 0 to r
+    std::vector<double> cdf_;
+};
+
+/**
+* Sets up n ranks with the given exponent; n must be at least 1.
+*/
+inline ZipfianDistribution::ZipfianDistribution(std::size_t n, double exponent)
+    : cdf_(n)
+{
+    double total = 0;
+    for(std::size_t i = 0; i < n; ++i) {
+        total += 1.0 / std::pow((double)(i + 1), exponent);
+        cdf_[i] = total;
+    }
+}
+
+/**
+* Returns the next rank drawn with engine.
+*/
+template<typename Engine>
+std::size_t ZipfianDistribution::operator()(Engine& engine) const
+{
+    std::uniform_real_distribution<double> uniform(0.0, cdf_.back());
+    std::size_t rank = std::lower_bound(cdf_.begin(), cdf_.end(), uniform(engine)) - cdf_.begin();
+    // rounding can put the draw just past the last total
+    return std::min(rank, cdf_.size() - 1);
+}
+
+/**
+* Returns how many ranks there are.
+*/
+inline std::size_t ZipfianDistribution::size() const
+{
+    return cdf_.size();
+}
+
+/**
+* Returns the n keys 0, stride, 2 * stride, ... shuffled with seed, for
+* handing out to ranks so the popular ones are scattered over the key
+* space instead of bunched at the low keys.
+*/
+inline std::vector<std::uint64_t> scatteredKeys(std::size_t n, std::uint64_t stride, std::uint64_t seed)
+{
+    std::vector<std::uint64_t> keys(n);
+    for(std::size_t i = 0; i < n; ++i) keys[i] = stride * i;
+    std::shuffle(keys.begin(), keys.end(), std::mt19937_64(seed));
+    return keys;
+}
+
+/**
+* Returns count keys drawn from ranked, ranked[r] being the key of rank r,
+* with Zipfian ranks of the given exponent drawn by a std::mt19937_64
+* seeded with seed.
+*/
+inline std::vector<std::uint64_t> zipfianKeys(const std::vector<std::uint64_t>& ranked, std::size_t count,
+                                              double exponent, std::uint64_t seed)
+{
+    ZipfianDistribution zipf(ranked.size(), exponent);
+    std::mt19937_64 rng(seed);
+    std::vector<std::uint64_t> keys(count);
+    for(std::size_t i = 0; i < count; ++i) keys[i] = ranked[zipf(rng)];
+    return keys;
+}
+
+#endif
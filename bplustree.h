@@ -0,0 +1,773 @@
+#ifndef BPLUSTREE_H
+#define BPLUSTREE_H
+
+#include <cstddef>
+#include <iterator>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include "bst.h"
+
+/**
+* The default fanout for a BPlusTree: as many items as fit in about 512 bytes
+* (eight cache lines), but never fewer than 8 or more than 128.
+*/
+template <typename Key, typename Value>
+struct BPlusTreeFanout
+{
+    static const std::size_t bytes = 512 / sizeof(std::pair<const Key, Value>);
+    static const std::size_t value = bytes < 8 ? 8 : (bytes > 128 ? 128 : bytes);
+};
+
+/**
+* A B+tree with the same interface as BinarySearchTree: insert, remove,
+* find, operator[], an in-order iterator, clear and empty.
+*
+* Every node holds up to Fanout keys side by side, so a descent touches a
+* few cache lines per level over about log(n) / log(Fanout) levels instead
+* of one scattered node per level over log2(n). Items only live in the
+* leaves, which are chained in key order for iteration. Inner nodes keep
+* just the separator keys and child pointers.
+*
+* Items are moved inside a node as keys come and go, so unlike the binary
+* trees any insert or remove invalidates iterators. Keys are kept in
+* std::pair<const Key, Value> for the iterator, so shifting an item copies
+* its key.
+*/
+template <typename Key, typename Value, std::size_t Fanout = BPlusTreeFanout<Key, Value>::value>
+class BPlusTree
+{
+    static_assert(Fanout >= 4, "a BPlusTree node needs room for at least 4 keys");
+
+protected:
+    typedef std::pair<const Key, Value> Item;
+
+    // common header, count is items in a leaf and keys in an inner node
+    struct BNode
+    {
+        std::size_t count;
+        bool leaf;
+    };
+
+    // one slot over Fanout so a node can overflow by one before it splits
+    struct Leaf : public BNode
+    {
+        Leaf* prev;
+        Leaf* next;
+        typename std::aligned_storage<sizeof(Item), alignof(Item)>::type slots[Fanout + 1];
+        Item* items() { return reinterpret_cast<Item*>(slots); }
+    };
+
+    struct Inner : public BNode
+    {
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type slots[Fanout + 1];
+        BNode* children[Fanout + 2];
+        Key* keys() { return reinterpret_cast<Key*>(slots); }
+    };
+
+public:
+    /**
+    * An iterator over the items in key order, walking the leaf chain.
+    */
+    class iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef value_type* pointer;
+        typedef value_type& reference;
+
+        iterator();
+
+        std::pair<const Key,Value>& operator*() const;
+        std::pair<const Key,Value>* operator->() const;
+
+        bool operator==(const iterator& rhs) const;
+        bool operator!=(const iterator& rhs) const;
+
+        iterator& operator++();
+        iterator operator++(int);
+        iterator& operator--();
+        iterator operator--(int);
+
+    protected:
+        friend class BPlusTree<Key, Value, Fanout>;
+        iterator(Leaf* leaf, std::size_t index, const BPlusTree<Key, Value, Fanout>* tree);
+        Leaf* leaf_;
+        std::size_t index_;
+        const BPlusTree<Key, Value, Fanout>* tree_;
+    };
+
+    BPlusTree();
+    ~BPlusTree();
+    std::pair<iterator, bool> insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+    bool empty() const;
+    std::size_t size() const;
+
+    iterator begin() const;
+    iterator end() const;
+    iterator find(const Key& key) const;
+    iterator lower_bound(const Key& key) const;
+    Value& operator[](const Key& key);
+    Value const & operator[](const Key& key) const;
+
+protected:
+    // deep enough for any tree that fits in memory, since every level
+    // at least doubles the number of items below it
+    static const std::size_t MAX_DEPTH = 64;
+    // fewest items or keys a node other than the root may hold
+    static const std::size_t MIN_ITEMS = Fanout / 2;
+    static const std::size_t MIN_KEYS = (Fanout - 1) / 2;
+
+    Leaf* descend(const Key& key, Inner** path, std::size_t* slots, std::size_t& depth) const;
+    static std::size_t childSlot(Inner* node, const Key& key);
+    static std::size_t itemSlot(Leaf* leaf, const Key& key);
+    void insertIntoParent(Inner** path, std::size_t* slots, std::size_t depth,
+                          BNode* left, const Key& separator, BNode* right);
+    void fixLeaf(Leaf* leaf, Inner** path, std::size_t* slots, std::size_t depth);
+    void fixInner(Inner** path, std::size_t* slots, std::size_t depth);
+    void removeFromInner(Inner* node, std::size_t keySlot);
+    void destroy(BNode* node);
+    template<typename T>
+    static void openGap(T* slots, std::size_t count, std::size_t pos);
+    template<typename T>
+    static void closeGap(T* slots, std::size_t count, std::size_t pos);
+    template<typename T>
+    static void moveSlots(T* from, std::size_t count, T* to);
+
+protected:
+    BNode* root_;
+    // ends of the leaf chain, for begin() and --end()
+    Leaf* head_;
+    Leaf* tail_;
+    std::size_t size_;
+
+private:
+    // no copying, a tree owns its nodes
+    BPlusTree(const BPlusTree&);
+    BPlusTree& operator=(const BPlusTree&);
+};
+
+/*
+---------------------------------------------------------
+Begin implementations for the BPlusTree::iterator class.
+---------------------------------------------------------
+*/
+
+template<class Key, class Value, std::size_t Fanout>
+BPlusTree<Key, Value, Fanout>::iterator::iterator(Leaf* leaf, std::size_t index, const BPlusTree<Key, Value, Fanout>* tree)
+    : leaf_(leaf), index_(index), tree_(tree)
+{
+}
+
+template<class Key, class Value, std::size_t Fanout>
+BPlusTree<Key, Value, Fanout>::iterator::iterator()
+    : leaf_(NULL), index_(0), tree_(NULL)
+{
+}
+
+template<class Key, class Value, std::size_t Fanout>
+std::pair<const Key,Value>&
+BPlusTree<Key, Value, Fanout>::iterator::operator*() const
+{
+    return leaf_->items()[index_];
+}
+
+template<class Key, class Value, std::size_t Fanout>
+std::pair<const Key,Value>*
+BPlusTree<Key, Value, Fanout>::iterator::operator->() const
+{
+    return &leaf_->items()[index_];
+}
+
+template<class Key, class Value, std::size_t Fanout>
+bool BPlusTree<Key, Value, Fanout>::iterator::operator==(const iterator& rhs) const
+{
+    return leaf_ == rhs.leaf_ && index_ == rhs.index_;
+}
+
+template<class Key, class Value, std::size_t Fanout>
+bool BPlusTree<Key, Value, Fanout>::iterator::operator!=(const iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Advances to the next item, moving on to the next leaf at the end of one.
+*/
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator&
+BPlusTree<Key, Value, Fanout>::iterator::operator++()
+{
+    ++index_;
+    if(index_ == leaf_->count){
+        leaf_ = leaf_->next;
+        index_ = 0;
+    }
+    return *this;
+}
+
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator
+BPlusTree<Key, Value, Fanout>::iterator::operator++(int)
+{
+    iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves back to the previous item. Stepping back from the end goes to the
+* last item of the last leaf.
+*/
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator&
+BPlusTree<Key, Value, Fanout>::iterator::operator--()
+{
+    if(leaf_ == NULL){
+        leaf_ = tree_->tail_;
+        index_ = leaf_->count - 1;
+    } else if(index_ == 0){
+        leaf_ = leaf_->prev;
+        index_ = leaf_->count - 1;
+    } else {
+        --index_;
+    }
+    return *this;
+}
+
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator
+BPlusTree<Key, Value, Fanout>::iterator::operator--(int)
+{
+    iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+-------------------------------------------------------
+End implementations for the BPlusTree::iterator class.
+-------------------------------------------------------
+*/
+
+/**
+* Default constructor for an empty tree.
+*/
+template<class Key, class Value, std::size_t Fanout>
+BPlusTree<Key, Value, Fanout>::BPlusTree()
+    : root_(NULL), head_(NULL), tail_(NULL), size_(0)
+{
+}
+
+template<class Key, class Value, std::size_t Fanout>
+BPlusTree<Key, Value, Fanout>::~BPlusTree()
+{
+    clear();
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is already there,
+* like BinarySearchTree::insert. A full leaf is split in two and the split
+* is passed up as far as it goes; the tree only grows taller at the root.
+* Returns an iterator to the item and whether a new item was added.
+*/
+template<class Key, class Value, std::size_t Fanout>
+std::pair<typename BPlusTree<Key, Value, Fanout>::iterator, bool>
+BPlusTree<Key, Value, Fanout>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    if(root_ == NULL){
+        Leaf* leaf = new Leaf;
+        leaf->count = 0;
+        leaf->leaf = true;
+        leaf->prev = NULL;
+        leaf->next = NULL;
+        root_ = head_ = tail_ = leaf;
+    }
+
+    Inner* path[MAX_DEPTH];
+    std::size_t slots[MAX_DEPTH];
+    std::size_t depth = 0;
+    Leaf* leaf = descend(keyValuePair.first, path, slots, depth);
+    std::size_t pos = itemSlot(leaf, keyValuePair.first);
+    Item* items = leaf->items();
+
+    // overwrite an existing value
+    if(pos < leaf->count && !KeyCompare<Key>::less(keyValuePair.first, items[pos].first)){
+        items[pos].second = keyValuePair.second;
+        return std::make_pair(iterator(leaf, pos, this), false);
+    }
+
+    openGap(items, leaf->count, pos);
+    new (items + pos) Item(keyValuePair);
+    ++leaf->count;
+    ++size_;
+    if(leaf->count <= Fanout){
+        return std::make_pair(iterator(leaf, pos, this), true);
+    }
+
+    // split the overfull leaf, the upper half goes to a new right sibling
+    Leaf* right = new Leaf;
+    right->leaf = true;
+    std::size_t keep = leaf->count / 2;
+    right->count = leaf->count - keep;
+    moveSlots(items + keep, right->count, right->items());
+    leaf->count = keep;
+
+    right->prev = leaf;
+    right->next = leaf->next;
+    if(leaf->next != NULL){
+        leaf->next->prev = right;
+    } else {
+        tail_ = right;
+    }
+    leaf->next = right;
+
+    iterator result = pos < keep ? iterator(leaf, pos, this) : iterator(right, pos - keep, this);
+    insertIntoParent(path, slots, depth, leaf, right->items()[0].first, right);
+    return std::make_pair(result, true);
+}
+
+/**
+* Removes the key if it is there. A leaf left less than half full borrows
+* an item from a sibling, or is merged with one, and the parent is fixed
+* the same way if it lost a key. The tree only gets shorter at the root.
+*/
+template<class Key, class Value, std::size_t Fanout>
+void BPlusTree<Key, Value, Fanout>::remove(const Key& key)
+{
+    if(root_ == NULL){
+        return;
+    }
+
+    Inner* path[MAX_DEPTH];
+    std::size_t slots[MAX_DEPTH];
+    std::size_t depth = 0;
+    Leaf* leaf = descend(key, path, slots, depth);
+    std::size_t pos = itemSlot(leaf, key);
+    Item* items = leaf->items();
+    if(pos == leaf->count || KeyCompare<Key>::less(key, items[pos].first)){
+        return;
+    }
+
+    items[pos].~Item();
+    closeGap(items, leaf->count, pos);
+    --leaf->count;
+    --size_;
+
+    if(depth == 0){
+        // the root leaf may hold anything down to nothing at all
+        if(leaf->count == 0){
+            delete leaf;
+            root_ = head_ = tail_ = NULL;
+        }
+        return;
+    }
+    if(leaf->count < MIN_ITEMS){
+        fixLeaf(leaf, path, slots, depth);
+    }
+}
+
+/**
+* Deletes every node in the tree.
+*/
+template<class Key, class Value, std::size_t Fanout>
+void BPlusTree<Key, Value, Fanout>::clear()
+{
+    if(root_ != NULL){
+        destroy(root_);
+    }
+    root_ = head_ = tail_ = NULL;
+    size_ = 0;
+}
+
+template<class Key, class Value, std::size_t Fanout>
+bool BPlusTree<Key, Value, Fanout>::empty() const
+{
+    return root_ == NULL;
+}
+
+template<class Key, class Value, std::size_t Fanout>
+std::size_t BPlusTree<Key, Value, Fanout>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator
+BPlusTree<Key, Value, Fanout>::begin() const
+{
+    return iterator(head_, 0, this);
+}
+
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator
+BPlusTree<Key, Value, Fanout>::end() const
+{
+    return iterator(NULL, 0, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end().
+*/
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator
+BPlusTree<Key, Value, Fanout>::find(const Key& key) const
+{
+    iterator it = lower_bound(key);
+    if(it.leaf_ != NULL && KeyCompare<Key>::less(key, it->first)){
+        return end();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than the
+* given key, or end().
+*/
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::iterator
+BPlusTree<Key, Value, Fanout>::lower_bound(const Key& key) const
+{
+    if(root_ == NULL){
+        return end();
+    }
+    Inner* path[MAX_DEPTH];
+    std::size_t slots[MAX_DEPTH];
+    std::size_t depth = 0;
+    Leaf* leaf = descend(key, path, slots, depth);
+    std::size_t pos = itemSlot(leaf, key);
+    // past the end of this leaf the bound is the first item of the next one
+    if(pos == leaf->count){
+        return iterator(leaf->next, 0, this);
+    }
+    return iterator(leaf, pos, this);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value, std::size_t Fanout>
+Value& BPlusTree<Key, Value, Fanout>::operator[](const Key& key)
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+template<class Key, class Value, std::size_t Fanout>
+Value const & BPlusTree<Key, Value, Fanout>::operator[](const Key& key) const
+{
+    iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+// helper that walks from the root to the leaf that holds (or would hold)
+// the key, writing down each inner node and the child taken from it
+template<class Key, class Value, std::size_t Fanout>
+typename BPlusTree<Key, Value, Fanout>::Leaf*
+BPlusTree<Key, Value, Fanout>::descend(const Key& key, Inner** path, std::size_t* slots, std::size_t& depth) const
+{
+    BNode* curr = root_;
+    depth = 0;
+    while(!curr->leaf){
+        Inner* inner = static_cast<Inner*>(curr);
+        std::size_t slot = childSlot(inner, key);
+        path[depth] = inner;
+        slots[depth] = slot;
+        ++depth;
+        curr = inner->children[slot];
+    }
+    return static_cast<Leaf*>(curr);
+}
+
+// helper for the child to follow: the number of separators <= key, since
+// each separator is the smallest key that can be in the child to its right
+template<class Key, class Value, std::size_t Fanout>
+std::size_t BPlusTree<Key, Value, Fanout>::childSlot(Inner* node, const Key& key)
+{
+    Key* keys = node->keys();
+    std::size_t lo = 0;
+    std::size_t hi = node->count;
+    while(lo < hi){
+        std::size_t mid = (lo + hi) / 2;
+        if(KeyCompare<Key>::less(key, keys[mid])){
+            hi = mid;
+        } else {
+            lo = mid + 1;
+        }
+    }
+    return lo;
+}
+
+// helper for the first item in a leaf whose key is not less than key
+template<class Key, class Value, std::size_t Fanout>
+std::size_t BPlusTree<Key, Value, Fanout>::itemSlot(Leaf* leaf, const Key& key)
+{
+    Item* items = leaf->items();
+    std::size_t lo = 0;
+    std::size_t hi = leaf->count;
+    while(lo < hi){
+        std::size_t mid = (lo + hi) / 2;
+        if(KeyCompare<Key>::less(items[mid].first, key)){
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// helper that adds the separator and new right node to the parent of left,
+// splitting the parent in turn if it overflows. depth is how many inner
+// nodes are above left.
+template<class Key, class Value, std::size_t Fanout>
+void BPlusTree<Key, Value, Fanout>::insertIntoParent(Inner** path, std::size_t* slots, std::size_t depth,
+                                                     BNode* left, const Key& separator, BNode* right)
+{
+    // left was the root, so the tree grows a level
+    if(depth == 0){
+        Inner* root = new Inner;
+        root->leaf = false;
+        root->count = 1;
+        new (root->keys()) Key(separator);
+        root->children[0] = left;
+        root->children[1] = right;
+        root_ = root;
+        return;
+    }
+
+    Inner* parent = path[depth - 1];
+    std::size_t slot = slots[depth - 1];
+    Key* keys = parent->keys();
+    openGap(keys, parent->count, slot);
+    new (keys + slot) Key(separator);
+    for(std::size_t i = parent->count + 1; i > slot + 1; --i){
+        parent->children[i] = parent->children[i - 1];
+    }
+    parent->children[slot + 1] = right;
+    ++parent->count;
+    if(parent->count <= Fanout){
+        return;
+    }
+
+    // split the overfull inner node around its middle key, which moves up
+    Inner* sibling = new Inner;
+    sibling->leaf = false;
+    std::size_t mid = parent->count / 2;
+    sibling->count = parent->count - mid - 1;
+    moveSlots(keys + mid + 1, sibling->count, sibling->keys());
+    for(std::size_t i = 0; i <= sibling->count; ++i){
+        sibling->children[i] = parent->children[mid + 1 + i];
+    }
+    Key promoted(std::move(keys[mid]));
+    keys[mid].~Key();
+    parent->count = mid;
+
+    insertIntoParent(path, slots, depth - 1, parent, promoted, sibling);
+}
+
+// helper for a leaf that fell under half full: take an item from a sibling
+// with some to spare, otherwise merge with a sibling and fix the parent
+template<class Key, class Value, std::size_t Fanout>
+void BPlusTree<Key, Value, Fanout>::fixLeaf(Leaf* leaf, Inner** path, std::size_t* slots, std::size_t depth)
+{
+    Inner* parent = path[depth - 1];
+    std::size_t slot = slots[depth - 1];
+    Leaf* left = slot > 0 ? static_cast<Leaf*>(parent->children[slot - 1]) : NULL;
+    Leaf* right = slot < parent->count ? static_cast<Leaf*>(parent->children[slot + 1]) : NULL;
+
+    // borrow the last item of the left sibling
+    if(left != NULL && left->count > MIN_ITEMS){
+        Item* items = leaf->items();
+        openGap(items, leaf->count, 0);
+        moveSlots(left->items() + left->count - 1, 1, items);
+        --left->count;
+        ++leaf->count;
+        parent->keys()[slot - 1] = items[0].first;
+        return;
+    }
+
+    // borrow the first item of the right sibling
+    if(right != NULL && right->count > MIN_ITEMS){
+        Item* ritems = right->items();
+        moveSlots(ritems, 1, leaf->items() + leaf->count);
+        closeGap(ritems, right->count, 0);
+        --right->count;
+        ++leaf->count;
+        parent->keys()[slot] = ritems[0].first;
+        return;
+    }
+
+    // merge the right one of the pair into the left one
+    std::size_t keySlot = slot;
+    if(left != NULL){
+        right = leaf;
+        leaf = left;
+        keySlot = slot - 1;
+    }
+    moveSlots(right->items(), right->count, leaf->items() + leaf->count);
+    leaf->count += right->count;
+    leaf->next = right->next;
+    if(right->next != NULL){
+        right->next->prev = leaf;
+    } else {
+        tail_ = leaf;
+    }
+    delete right;
+
+    removeFromInner(parent, keySlot);
+    fixInner(path, slots, depth - 1);
+}
+
+// helper for the inner node path[depth] after it lost a key: the root just
+// drops a level once it has a single child, anything else under half full
+// borrows through the parent or merges like a leaf does
+template<class Key, class Value, std::size_t Fanout>
+void BPlusTree<Key, Value, Fanout>::fixInner(Inner** path, std::size_t* slots, std::size_t depth)
+{
+    Inner* node = path[depth];
+    if(depth == 0){
+        if(node->count == 0){
+            root_ = node->children[0];
+            delete node;
+        }
+        return;
+    }
+    if(node->count >= MIN_KEYS){
+        return;
+    }
+
+    Inner* parent = path[depth - 1];
+    std::size_t slot = slots[depth - 1];
+    Key* pkeys = parent->keys();
+    Inner* left = slot > 0 ? static_cast<Inner*>(parent->children[slot - 1]) : NULL;
+    Inner* right = slot < parent->count ? static_cast<Inner*>(parent->children[slot + 1]) : NULL;
+
+    // rotate the left sibling's last child over, through the parent's separator
+    if(left != NULL && left->count > MIN_KEYS){
+        Key* keys = node->keys();
+        openGap(keys, node->count, 0);
+        new (keys) Key(std::move(pkeys[slot - 1]));
+        for(std::size_t i = node->count + 1; i > 0; --i){
+            node->children[i] = node->children[i - 1];
+        }
+        node->children[0] = left->children[left->count];
+        pkeys[slot - 1] = std::move(left->keys()[left->count - 1]);
+        left->keys()[left->count - 1].~Key();
+        --left->count;
+        ++node->count;
+        return;
+    }
+
+    // rotate the right sibling's first child over the same way
+    if(right != NULL && right->count > MIN_KEYS){
+        Key* rkeys = right->keys();
+        new (node->keys() + node->count) Key(std::move(pkeys[slot]));
+        node->children[node->count + 1] = right->children[0];
+        pkeys[slot] = std::move(rkeys[0]);
+        rkeys[0].~Key();
+        closeGap(rkeys, right->count, 0);
+        for(std::size_t i = 0; i < right->count; ++i){
+            right->children[i] = right->children[i + 1];
+        }
+        --right->count;
+        ++node->count;
+        return;
+    }
+
+    // merge the right one of the pair into the left one, pulling the
+    // separator between them down
+    std::size_t keySlot = slot;
+    if(left != NULL){
+        right = node;
+        node = left;
+        keySlot = slot - 1;
+    }
+    Key* keys = node->keys();
+    new (keys + node->count) Key(std::move(pkeys[keySlot]));
+    moveSlots(right->keys(), right->count, keys + node->count + 1);
+    for(std::size_t i = 0; i <= right->count; ++i){
+        node->children[node->count + 1 + i] = right->children[i];
+    }
+    node->count += right->count + 1;
+    delete right;
+
+    removeFromInner(parent, keySlot);
+    fixInner(path, slots, depth - 1);
+}
+
+// helper that drops a separator and the child to its right from an inner node
+template<class Key, class Value, std::size_t Fanout>
+void BPlusTree<Key, Value, Fanout>::removeFromInner(Inner* node, std::size_t keySlot)
+{
+    Key* keys = node->keys();
+    keys[keySlot].~Key();
+    closeGap(keys, node->count, keySlot);
+    for(std::size_t i = keySlot + 1; i < node->count; ++i){
+        node->children[i] = node->children[i + 1];
+    }
+    --node->count;
+}
+
+// helper that deletes a subtree, running the destructor of every item and key
+template<class Key, class Value, std::size_t Fanout>
+void BPlusTree<Key, Value, Fanout>::destroy(BNode* node)
+{
+    if(node->leaf){
+        Leaf* leaf = static_cast<Leaf*>(node);
+        for(std::size_t i = 0; i < leaf->count; ++i){
+            leaf->items()[i].~Item();
+        }
+        delete leaf;
+        return;
+    }
+    Inner* inner = static_cast<Inner*>(node);
+    for(std::size_t i = 0; i <= inner->count; ++i){
+        destroy(inner->children[i]);
+    }
+    for(std::size_t i = 0; i < inner->count; ++i){
+        inner->keys()[i].~Key();
+    }
+    delete inner;
+}
+
+// helper that moves slots [pos, count) up by one, leaving pos empty
+template<class Key, class Value, std::size_t Fanout>
+template<typename T>
+void BPlusTree<Key, Value, Fanout>::openGap(T* slots, std::size_t count, std::size_t pos)
+{
+    for(std::size_t i = count; i > pos; --i){
+        new (slots + i) T(std::move(slots[i - 1]));
+        slots[i - 1].~T();
+    }
+}
+
+// helper that moves slots (pos, count) down by one over the empty slot pos
+template<class Key, class Value, std::size_t Fanout>
+template<typename T>
+void BPlusTree<Key, Value, Fanout>::closeGap(T* slots, std::size_t count, std::size_t pos)
+{
+    for(std::size_t i = pos; i + 1 < count; ++i){
+        new (slots + i) T(std::move(slots[i + 1]));
+        slots[i + 1].~T();
+    }
+}
+
+// helper that moves count slots to empty storage somewhere else
+template<class Key, class Value, std::size_t Fanout>
+template<typename T>
+void BPlusTree<Key, Value, Fanout>::moveSlots(T* from, std::size_t count, T* to)
+{
+    for(std::size_t i = 0; i < count; ++i){
+        new (to + i) T(std::move(from[i]));
+        from[i].~T();
+    }
+}
+
+#endif
@@ -1,7 +1,11 @@
 #include <iostream>
 #include <map>
+#include <vector>
 #include "bst.h"
 #include "avlbst.h"
+#include "bplustree.h"
+#include "persistent_avl.h"
+#include "splaybst.h"
 
 using namespace std;
 
@@ -25,6 +29,12 @@ int main(int argc, char *argv[])
     }
     cout << "Erasing b" << endl;
     bt.remove('b');
+    for(char c = 'c'; c <= 'f'; ++c) {
+        bt.insert(std::make_pair(c, c - 'a' + 1));
+    }
+    cout << "After adding c to f: " << bt.size() << " keys, height " << bt.height() << ", "
+         << (bt.isBalanced() ? "balanced" : "not balanced")
+         << (bt.isBalanced() == bt.verifyBalance() ? "" : " (WRONG)") << endl;
 
     // AVL Tree Tests
     AVLTree<char,int> at;
@@ -44,5 +54,184 @@ int main(int argc, char *argv[])
     cout << "Erasing b" << endl;
     at.remove('b');
 
+    // Pooled AVL Tree Tests
+    AVLTree<int,int> pt;
+    pt.enablePool(16);
+    for(int i = 0; i < 40; ++i) {
+        pt.insert(std::make_pair(i, i * i));
+    }
+    for(int i = 0; i < 40; i += 2) {
+        pt.remove(i);
+    }
+    NodePoolStats stats = pt.poolStats();
+    cout << "\nPooled AVLTree: " << stats.liveNodes << " live nodes, "
+         << stats.bytesLive << " of " << stats.bytesReserved << " bytes in use" << endl;
+    pt.clear();
+
+    // Bulk loaded AVL Tree Tests
+    vector<pair<int,int> > sorted;
+    for(int i = 0; i < 10; ++i) {
+        sorted.push_back(std::make_pair(i, i * 10));
+    }
+    AVLTree<int,int> bt2(sorted.begin(), sorted.end());
+    bt2.insert(std::make_pair(10, 100));
+    bt2.remove(3);
+    cout << "\nBulk loaded AVLTree is " << (bt2.isBalanced() ? "balanced" : "NOT balanced") << ":";
+    for(AVLTree<int,int>::iterator it = bt2.begin(); it != bt2.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Upsert Tests, through a base class reference so the AVL nodes still get made
+    AVLTree<string,int> counts;
+    BinarySearchTree<string,int>& base = counts;
+    const char* words[] = {"pear", "fig", "pear", "kiwi", "fig", "pear"};
+    for(int i = 0; i < 6; ++i) {
+        std::pair<BinarySearchTree<string,int>::iterator, bool> hit = base.try_emplace(words[i], 0);
+        hit.first->second++;
+    }
+    std::pair<BinarySearchTree<string,int>::iterator, bool> res = base.insert_or_assign("kiwi", 7);
+    cout << "\nUpserted AVLTree is " << (counts.isBalanced() ? "balanced" : "NOT balanced")
+         << ", kiwi " << (res.second ? "added" : "assigned") << ":";
+    for(AVLTree<string,int>::iterator it = counts.begin(); it != counts.end(); ++it) {
+        cout << " " << it->first << "=" << it->second;
+    }
+    cout << endl;
+
+    // Order statistic AVL Tree Tests
+    OrderStatTree<int,int> ot;
+    for(int i = 0; i < 100; ++i) {
+        ot.insert(std::make_pair((i * 37) % 100, i));
+    }
+    for(int i = 0; i < 100; i += 3) {
+        ot.remove(i);
+    }
+    cout << "\nOrderStatTree has " << ot.size() << " keys, median " << ot.select(ot.size() / 2)->first
+         << ", rank of 50 is " << ot.rank(50) << ", " << ot.count_range(10, 20) << " keys in [10, 20)" << endl;
+
+    // Range query Tests
+    cout << "\nKeys in [10, 20):";
+    ot.for_each_in_range(10, 20, [](const std::pair<const int,int>& item) { cout << " " << item.first; });
+    cout << endl << "lower_bound(12) is " << ot.lower_bound(12)->first
+         << ", upper_bound(13) is " << ot.upper_bound(13)->first << endl;
+
+    // Reverse iterator Tests
+    cout << "\nLargest 3 keys:";
+    OrderStatTree<int,int>::const_reverse_iterator rit = ot.crbegin();
+    for(int i = 0; i < 3 && rit != ot.crend(); ++i, ++rit) {
+        cout << " " << rit->first;
+    }
+    cout << ", last key via --end() is " << (--ot.end())->first << endl;
+
+    // Split and join Tests
+    OrderStatTree<int,int> upper;
+    ot.split(50, upper);
+    cout << "\nSplit at 50: " << ot.size() << " keys below, " << upper.size() << " from 50 up, smallest "
+         << upper.begin()->first << ", both " << (ot.isBalanced() && upper.isBalanced() ? "balanced" : "NOT balanced");
+    ot.join(upper);
+    cout << "; joined back " << ot.size() << " keys, " << (ot.isBalanced() ? "balanced" : "NOT balanced") << endl;
+
+    // Set operation Tests
+    ForkJoinPool setPool(2);
+    OrderStatTree<int,int> evens, odds, tens;
+    for(int i = 0; i < 100; ++i) {
+        (i % 2 ? odds : evens).insert(std::make_pair(i, i));
+        if(i % 10 == 0) tens.insert(std::make_pair(i, -i));
+    }
+    evens.subtract(tens, &setPool, 8);
+    evens.unite(odds, &setPool, 8);
+    cout << "\nEvens minus tens plus odds has " << evens.size() << " keys, "
+         << (evens.isBalanced() ? "balanced" : "NOT balanced") << endl;
+
+    // Frozen snapshot Tests
+    FrozenTree<int,int> frozen = ot.freeze();
+    ot.insert(std::make_pair(3, 3));
+    cout << "\nFrozen snapshot has " << frozen.size() << " keys, " << (frozen.find(3) == frozen.end() ? "no 3" : "a 3")
+         << ", lower_bound(12) is " << frozen.lower_bound(12)->first << ", first keys:";
+    FrozenTree<int,int>::const_iterator fit = frozen.begin();
+    for(int i = 0; i < 4; ++i, ++fit) {
+        cout << " " << fit->first;
+    }
+    cout << endl;
+
+    // B+ tree Tests
+    BPlusTree<int,int,4> bp;
+    for(int i = 0; i < 50; ++i) {
+        bp.insert(std::make_pair((i * 7) % 50, i));
+    }
+    for(int i = 0; i < 50; i += 2) {
+        bp.remove(i);
+    }
+    cout << "\nBPlusTree has " << bp.size() << " keys, [25] is " << bp[25] << ", keys:";
+    for(BPlusTree<int,int,4>::iterator it = bp.begin(); it != bp.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Persistent AVL Tree Tests
+    PersistentAVLTree<int,int> live;
+    for(int i = 0; i < 20; ++i) {
+        live.insert(std::make_pair(i, i));
+    }
+    PersistentAVLTree<int,int> snap = live.snapshot();
+    for(int i = 0; i < 20; i += 2) {
+        live.remove(i);
+    }
+    live.insert(std::make_pair(1, 100));
+    cout << "\nPersistentAVLTree has " << live.size() << " keys, [1] is " << live[1]
+         << "; its snapshot has " << snap.size() << " keys, [1] is " << snap[1]
+         << ", both " << (live.isBalanced() && snap.isBalanced() ? "balanced" : "NOT balanced") << endl;
+
+    // Splay Tree Tests
+    SplayTree<int,int> st;
+    for(int i = 0; i < 16; ++i) {
+        st.insert(std::make_pair(i, i * i));
+    }
+    int sortedHeight = st.height();
+    st.find(0);
+    int foundHeight = st.height();
+    st.remove(8);
+    st.remove(99);
+    cout << "\nSplayTree has " << st.size() << " keys, height " << sortedHeight << " after sorted inserts and "
+         << foundHeight << " after find(0)," << (st.isBalanced() == st.verifyBalance() ? "" : " (WRONG)")
+         << " [5] is " << st.find(5)->second << ", keys:";
+    for(SplayTree<int,int>::iterator it = st.begin(); it != st.end(); ++it) {
+        cout << " " << it->first;
+    }
+    cout << endl;
+
+    // Hot path counter Tests, only when built with make DEFS=-DTREE_STATS
+    if(TREE_STATS_ENABLED) {
+        resetTreeOpStats();
+        AVLTree<int,int> counted;
+        for(int i = 0; i < 64; ++i) {
+            counted.insert(std::make_pair(i, i));
+        }
+        counted.remove(31);
+        TreeOpStats ops = treeOpStats();
+        cout << "\n64 inserts and a remove: " << ops.comparisons << " comparisons, " << ops.descentSteps
+             << " steps in " << ops.descents << " descents, " << ops.rotateLefts << " left and "
+             << ops.rotateRights << " right rotations, " << ops.nodeSwaps << " swaps, "
+             << ops.retraceSteps << " retrace steps, " << ops.allocations << " allocations, "
+             << ops.frees << " frees" << endl;
+    }
+
+    // Latency histogram Tests, only when built with make DEFS=-DTREE_LATENCY
+    if(TREE_LATENCY_ENABLED) {
+        resetTreeLatencies();
+        AVLTree<int,int> timed;
+        for(int i = 0; i < 1000; ++i) {
+            timed.insert(std::make_pair((i * 7919) % 1000, i));
+        }
+        for(AVLTree<int,int>::iterator it = timed.begin(); it != timed.end(); ++it) {
+            timed.find(it->first);
+        }
+        for(int i = 0; i < 1000; i += 2) {
+            timed.remove(i);
+        }
+        cout << "\nLatencies of 1000 inserts, finds and steps and 500 removes (ns):" << endl;
+        writeTreeLatencies(cout);
+    }
+
     return 0;
 }
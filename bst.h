@@ -4,21 +4,76 @@
 #include <iostream>
 #include <exception>
 #include <cstdlib>
+#include <algorithm>
 #include <utility>
+#include <cstdint>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <tuple>
+#include <iterator>
+#include <cstddef>
+#include <atomic>
+#include "node_pool.h"
+#include "node_reclaimer.h"
+#include "tree_stats.h"
+#include "tree_latency.h"
+
+/**
+ * The key ordering every descent in the trees goes through.
+ * Only operator< is needed: a descent makes one call per level
+ * and checks for equality once at the bottom, instead of testing
+ * ==, > and < at every node. Specialize this for key types that
+ * have a cheaper or different ordering. Specializations that
+ * want to show up in the comparison counter (see tree_stats.h)
+ * need their own TREE_STAT(comparisons).
+ */
+template <typename Key>
+struct KeyCompare
+{
+    static bool less(const Key& a, const Key& b);
+};
+
+/**
+* Returns true if a orders before b.
+*/
+template<typename Key>
+bool KeyCompare<Key>::less(const Key& a, const Key& b)
+{
+    TREE_STAT(comparisons);
+    return a < b;
+}
+
+/**
+ * Tag for the Node constructors that build the item in place
+ * from whatever arguments were handed to emplace().
+ */
+struct InPlaceItem { };
 
 /**
  * A templated class for a Node in a search tree.
- * The getters for parent/left/right are virtual so
- * that they can be overridden for future kinds of
- * search trees, such as Red Black trees, Splay trees,
- * and AVL trees.
+ * The getters for parent/left/right are not virtual.
+ * Future kinds of search trees, such as Red Black trees,
+ * Splay trees, and AVL trees, hide them with versions that
+ * return their own node type, so every step of a traversal
+ * is a direct load the compiler can inline. Nodes carry no
+ * vtable, so trees destroy them through their node policy
+ * (see BinarySearchTree::destroyNode_).
+ *
+ * Nodes are aligned to at least 8 bytes, even where pointers
+ * only need 4, so the low three bits of the parent pointer are
+ * always zero. They are kept as a small tag that derived nodes
+ * can use (AVLNode keeps its balance there) instead of paying
+ * for another padded data member.
  */
 template <typename Key, typename Value>
-class Node
+class alignas(8) Node
 {
 public:
     Node(const Key& key, const Value& value, Node<Key, Value>* parent);
-    virtual ~Node();
+    template<typename... Args>
+    Node(InPlaceItem, Node<Key, Value>* parent, Args&&... args);
+    ~Node();
 
     const std::pair<const Key, Value>& getItem() const;
     std::pair<const Key, Value>& getItem();
@@ -26,18 +81,28 @@ public:
     const Value& getValue() const;
     Value& getValue();
 
-    virtual Node<Key, Value>* getParent() const;
-    virtual Node<Key, Value>* getLeft() const;
-    virtual Node<Key, Value>* getRight() const;
+    Node<Key, Value>* getParent() const;
+    Node<Key, Value>* getLeft() const;
+    Node<Key, Value>* getRight() const;
 
     void setParent(Node<Key, Value>* parent);
     void setLeft(Node<Key, Value>* left);
     void setRight(Node<Key, Value>* right);
     void setValue(const Value &value);
+    void setValue(Value&& value);
 
 protected:
+    // number of tag bits kept in the parent pointer
+    static const std::uintptr_t TAG_BITS = 3;
+    static const std::uintptr_t TAG_MASK = (std::uintptr_t(1) << TAG_BITS) - 1;
+    static_assert(TAG_MASK < 8, "the tag bits must fit in the alignment the class asks for");
+
+    unsigned getTag() const;
+    void setTag(unsigned tag);
+
     std::pair<const Key, Value> item_;
-    Node<Key, Value>* parent_;
+    // parent pointer with the tag in its low bits
+    std::uintptr_t parent_;
     Node<Key, Value>* left_;
     Node<Key, Value>* right_;
 };
@@ -54,7 +119,22 @@ protected:
 template<typename Key, typename Value>
 Node<Key, Value>::Node(const Key& key, const Value& value, Node<Key, Value>* parent) :
     item_(key, value),
-    parent_(parent),
+    parent_(reinterpret_cast<std::uintptr_t>(parent)),
+    left_(NULL),
+    right_(NULL)
+{
+}
+
+/**
+* In-place constructor, which builds the item straight from the arguments
+* (anything std::pair<const Key, Value> can be constructed from) so nothing
+* is copied on the way into the node.
+*/
+template<typename Key, typename Value>
+template<typename... Args>
+Node<Key, Value>::Node(InPlaceItem, Node<Key, Value>* parent, Args&&... args) :
+    item_(std::forward<Args>(args)...),
+    parent_(reinterpret_cast<std::uintptr_t>(parent)),
     left_(NULL),
     right_(NULL)
 {
@@ -116,16 +196,16 @@ Value& Node<Key, Value>::getValue()
 }
 
 /**
-* An implementation of the virtual function for retreiving the parent.
+* A getter for the parent.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getParent() const
 {
-    return parent_;
+    return reinterpret_cast<Node<Key, Value>*>(parent_ & ~TAG_MASK);
 }
 
 /**
-* An implementation of the virtual function for retreiving the left child.
+* A getter for the left child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getLeft() const
@@ -134,7 +214,7 @@ Node<Key, Value>* Node<Key, Value>::getLeft() const
 }
 
 /**
-* An implementation of the virtual function for retreiving the right child.
+* A getter for the right child.
 */
 template<typename Key, typename Value>
 Node<Key, Value>* Node<Key, Value>::getRight() const
@@ -148,7 +228,26 @@ Node<Key, Value>* Node<Key, Value>::getRight() const
 template<typename Key, typename Value>
 void Node<Key, Value>::setParent(Node<Key, Value>* parent)
 {
-    parent_ = parent;
+    // keep this node's tag, it belongs to the node and not to the link
+    parent_ = reinterpret_cast<std::uintptr_t>(parent) | (parent_ & TAG_MASK);
+}
+
+/**
+* A getter for the tag bits kept alongside the parent pointer.
+*/
+template<typename Key, typename Value>
+unsigned Node<Key, Value>::getTag() const
+{
+    return static_cast<unsigned>(parent_ & TAG_MASK);
+}
+
+/**
+* A setter for the tag bits, which leaves the parent pointer alone.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setTag(unsigned tag)
+{
+    parent_ = (parent_ & ~TAG_MASK) | (static_cast<std::uintptr_t>(tag) & TAG_MASK);
 }
 
 /**
@@ -178,12 +277,110 @@ void Node<Key, Value>::setValue(const Value& value)
     item_.second = value;
 }
 
+/**
+* A setter for the value of a node that takes over the passed value.
+*/
+template<typename Key, typename Value>
+void Node<Key, Value>::setValue(Value&& value)
+{
+    item_.second = std::move(value);
+}
+
 /*
   ---------------------------------------
   End implementations for the Node class.
   ---------------------------------------
 */
 
+/**
+ * The node a plain BinarySearchTree makes. It adds the height of its
+ * subtree, plus a tag bit saying its two subtrees differ in height by
+ * more than one, so the tree can keep height() and isBalanced() up to date
+ * as it changes instead of walking every node to answer them. Trees with
+ * their own node type (AVLTree) keep those answers their own way.
+ */
+template <typename Key, typename Value>
+class BSTNode : public Node<Key, Value>
+{
+public:
+    BSTNode(const Key& key, const Value& value, BSTNode<Key, Value>* parent);
+    template<typename... Args>
+    BSTNode(InPlaceItem tag, BSTNode<Key, Value>* parent, Args&&... args);
+
+    int getHeight() const;
+    void setHeight(int height);
+    bool isUnbalanced() const;
+    void setUnbalanced(bool unbalanced);
+
+    // the node type is what the tree handles, as for Node
+    BSTNode<Key, Value>* getParent() const;
+    BSTNode<Key, Value>* getLeft() const;
+    BSTNode<Key, Value>* getRight() const;
+
+protected:
+    int height_;
+};
+
+/**
+* A new node is a leaf, one tall and balanced.
+*/
+template<typename Key, typename Value>
+BSTNode<Key, Value>::BSTNode(const Key& key, const Value& value, BSTNode<Key, Value>* parent) :
+    Node<Key, Value>(key, value, parent),
+    height_(1)
+{
+}
+
+template<typename Key, typename Value>
+template<typename... Args>
+BSTNode<Key, Value>::BSTNode(InPlaceItem tag, BSTNode<Key, Value>* parent, Args&&... args) :
+    Node<Key, Value>(tag, parent, std::forward<Args>(args)...),
+    height_(1)
+{
+}
+
+template<typename Key, typename Value>
+int BSTNode<Key, Value>::getHeight() const
+{
+    return height_;
+}
+
+template<typename Key, typename Value>
+void BSTNode<Key, Value>::setHeight(int height)
+{
+    height_ = height;
+}
+
+template<typename Key, typename Value>
+bool BSTNode<Key, Value>::isUnbalanced() const
+{
+    return (this->getTag() & 1) != 0;
+}
+
+template<typename Key, typename Value>
+void BSTNode<Key, Value>::setUnbalanced(bool unbalanced)
+{
+    this->setTag(unbalanced ? 1 : 0);
+}
+
+template<typename Key, typename Value>
+BSTNode<Key, Value>* BSTNode<Key, Value>::getParent() const
+{
+    return static_cast<BSTNode<Key, Value>*>(Node<Key, Value>::getParent());
+}
+
+template<typename Key, typename Value>
+BSTNode<Key, Value>* BSTNode<Key, Value>::getLeft() const
+{
+    return static_cast<BSTNode<Key, Value>*>(this->left_);
+}
+
+template<typename Key, typename Value>
+BSTNode<Key, Value>* BSTNode<Key, Value>::getRight() const
+{
+    return static_cast<BSTNode<Key, Value>*>(this->right_);
+}
+
 /**
 * A templated unbalanced binary search tree.
 */
@@ -193,49 +390,111 @@ class BinarySearchTree
 public:
     BinarySearchTree(); //TODO
     virtual ~BinarySearchTree(); //TODO
-    virtual void insert(const std::pair<const Key, Value>& keyValuePair); //TODO
     virtual void remove(const Key& key); //TODO
     void clear(); //TODO
     bool isBalanced() const; //TODO
+    bool verifyBalance() const;
     void print() const;
     bool empty() const;
+    std::size_t size() const;
+    int height() const;
+    void enablePool(std::size_t nodesPerSlab = 1024);
+    NodePoolStats poolStats() const;
+    void setBackgroundClear(bool on);
 
     template<typename PPKey, typename PPValue>
     friend void prettyPrintBST(BinarySearchTree<PPKey, PPValue> & tree);
 public:
     /**
     * An internal iterator class for traversing the contents of the BST.
+    * It is bidirectional, and one template covers the const and reverse
+    * versions (see the typedefs below). Each iterator knows its tree so that
+    * stepping back from end() can find the last item.
     */
-    class iterator  // TODO
+    template<bool IsConst, bool IsReverse>
+    class Iterator  // TODO
     {
     public:
-        iterator();
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef typename std::conditional<IsConst, const value_type*, value_type*>::type pointer;
+        typedef typename std::conditional<IsConst, const value_type&, value_type&>::type reference;
 
-        std::pair<const Key,Value>& operator*() const;
-        std::pair<const Key,Value>* operator->() const;
+        Iterator();
+        // a mutable iterator converts to the const one going the same way
+        template<bool OtherConst, typename = typename std::enable_if<IsConst && !OtherConst>::type>
+        Iterator(const Iterator<OtherConst, IsReverse>& other);
 
-        bool operator==(const iterator& rhs) const;
-        bool operator!=(const iterator& rhs) const;
+        reference operator*() const;
+        pointer operator->() const;
 
-        iterator& operator++();
+        bool operator==(const Iterator& rhs) const;
+        bool operator!=(const Iterator& rhs) const;
+
+        Iterator& operator++();
+        Iterator operator++(int);
+        Iterator& operator--();
+        Iterator operator--(int);
 
     protected:
         friend class BinarySearchTree<Key, Value>;
-        iterator(Node<Key,Value>* ptr);
+        template<bool, bool> friend class Iterator;
+        Iterator(Node<Key,Value>* ptr, const BinarySearchTree<Key, Value>* tree);
         Node<Key, Value> *current_;
+        const BinarySearchTree<Key, Value>* tree_;
     };
 
+    typedef Iterator<false, false> iterator;
+    typedef Iterator<true, false> const_iterator;
+    typedef Iterator<false, true> reverse_iterator;
+    typedef Iterator<true, true> const_reverse_iterator;
+
 public:
     iterator begin() const;
     iterator end() const;
+    const_iterator cbegin() const;
+    const_iterator cend() const;
+    reverse_iterator rbegin() const;
+    reverse_iterator rend() const;
+    const_reverse_iterator crbegin() const;
+    const_reverse_iterator crend() const;
     iterator find(const Key& key) const;
+    // Ordered lookups: the first key >= key, the first key > key, and both.
+    iterator lower_bound(const Key& key) const;
+    iterator upper_bound(const Key& key) const;
+    std::pair<iterator, iterator> equal_range(const Key& key) const;
+    // Calls fn(item) for every item with lo <= key < hi, in key order.
+    template<typename Fn>
+    void for_each_in_range(const Key& lo, const Key& hi, Fn fn) const;
     Value& operator[](const Key& key);
     Value const & operator[](const Key& key) const;
 
+    // Each insert descends once and returns an iterator to the key and
+    // whether a new node was added. insert() and emplace() overwrite an
+    // existing value like insert_or_assign(); try_emplace() leaves it alone.
+    virtual std::pair<iterator, bool> insert(const std::pair<const Key, Value>& keyValuePair); //TODO
+    template<typename P>
+    typename std::enable_if<!std::is_lvalue_reference<P>::value &&
+                            std::is_constructible<std::pair<Key, Value>, P&&>::value,
+                            std::pair<iterator, bool> >::type
+    insert(P&& keyValuePair);
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args);
+    template<typename... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, M&& value);
+    template<typename M>
+    std::pair<iterator, bool> insert_or_assign(Key&& key, M&& value);
+
 protected:
     // Mandatory helper functions
     Node<Key, Value>* internalFind(const Key& k) const; // TODO
     Node<Key, Value> *getSmallestNode() const;  // TODO
+    Node<Key, Value> *getLargestNode() const;
     static Node<Key, Value>* predecessor(Node<Key, Value>* current); // TODO
     // Note:  static means these functions don't have a "this" pointer
     //        and instead just use the input argument.
@@ -245,14 +504,64 @@ protected:
     virtual void nodeSwap( Node<Key,Value>* n1, Node<Key,Value>* n2) ;
 
     // Add helper functions here
+    Node<Key, Value>* lowerBoundNode(const Key& key) const;
+    Node<Key, Value>* upperBoundNode(const Key& key) const;
+    Node<Key, Value>* findInsertPos(const Key& key, Node<Key, Value>*& parent, bool& goLeft) const;
     static Node<Key, Value>* successor(Node<Key, Value>* current);
+    void fixHeights(BSTNode<Key, Value>* node);
+    bool updateHeight(BSTNode<Key, Value>* node);
+    void removeNode(Node<Key, Value>* tbd);
+    static int nodeHeight(BSTNode<Key, Value>* node);
+    static std::size_t countNodes(Node<Key, Value>* node);
     void actualclear(Node<Key, Value>* current);
     bool actualbalanced(Node<Key, Value>* root, int& height) const;
+    template<typename NodeType, typename... Args>
+    NodeType* allocateNode(Args&&... args);
+    template<typename NodeType, typename P>
+    std::pair<Node<Key, Value>*, bool> insertItem(P&& keyValuePair);
+    template<typename NodeType, typename... Args>
+    std::pair<Node<Key, Value>*, bool> emplaceItem(Args&&... args);
+    std::pair<Node<Key, Value>*, bool> upsertItem(std::pair<Key, Value>&& keyValuePair);
+    template<typename K, typename... Args>
+    std::pair<Node<Key, Value>*, bool> tryEmplaceItem(K&& key, Args&&... args);
+    template<typename K, typename M>
+    std::pair<Node<Key, Value>*, bool> assignItem(K&& key, M&& value);
+    void linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool goLeft);
+    iterator makeIterator(Node<Key, Value>* node) const;
+    virtual Node<Key, Value>* createNode(Node<Key, Value>* parent, std::pair<Key, Value>&& keyValuePair);
+    virtual void rebalanceInsert(Node<Key, Value>* node);
+    void freeNode(Node<Key, Value>* node);
+    void destroyAll(Node<Key, Value>* current);
+    template<typename Fn>
+    static void teardown(Node<Key, Value>* current, Fn fn);
+    static void reclaimDetached(Node<Key, Value>* root, NodePool* pool, void (*destroyNode)(Node<Key, Value>* node));
+    template<typename NodeType>
+    static void destroyNodeAs(Node<Key, Value>* node);
+    std::size_t getCount() const;
+    void setCount(std::size_t count) const;
 
 
 protected:
     Node<Key, Value>* root_;
-    // You should not need other data members
+    // node storage, NULL means plain new/delete
+    NodePool* pool_;
+    // nodes per slab for the pool, 0 until enablePool() is called
+    std::size_t poolSlabNodes_;
+    // node policy: runs the destructor of the tree's actual node type,
+    // set by each tree's constructor since nodes have no vtable
+    void (*destroyNode_)(Node<Key, Value>* node);
+    // clear() hands the nodes to the NodeReclaimer instead of freeing them
+    bool backgroundClear_;
+    // number of keys, or UNKNOWN_COUNT after an AVLTree split without
+    // subtree sizes, until size() counts them again. Atomic since size()
+    // is const and readers sharing the tree may all store the recount;
+    // go through getCount() and setCount()
+    mutable std::atomic<std::size_t> count_;
+    static const std::size_t UNKNOWN_COUNT = ~std::size_t(0);
+    // height of the whole tree
+    int height_;
+    // number of nodes whose subtrees differ in height by more than one
+    std::size_t unbalanced_;
 };
 
 /*
@@ -262,33 +571,52 @@ Begin implementations for the BinarySearchTree::iterator class.
 */
 
 /**
-* Explicit constructor that initializes an iterator with a given node pointer.
+* Explicit constructor that initializes an iterator with a given node pointer
+* and the tree it belongs to.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator(Node<Key,Value> *ptr)
+template<bool IsConst, bool IsReverse>
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::Iterator(Node<Key,Value> *ptr, const BinarySearchTree<Key, Value>* tree)
 {
     // TODO
     // set current to passed in ptr
     current_ = ptr;
+    tree_ = tree;
 }
 
 /**
 * A default constructor that initializes the iterator to NULL.
 */
 template<class Key, class Value>
-BinarySearchTree<Key, Value>::iterator::iterator() 
+template<bool IsConst, bool IsReverse>
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::Iterator() 
 {
     // TODO
     // set current to null
     current_ = NULL;
+    tree_ = NULL;
+}
+
+/**
+* Converts an iterator to a const_iterator (or a reverse_iterator to a
+* const_reverse_iterator).
+*/
+template<class Key, class Value>
+template<bool IsConst, bool IsReverse>
+template<bool OtherConst, typename>
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::Iterator(const Iterator<OtherConst, IsReverse>& other)
+{
+    current_ = other.current_;
+    tree_ = other.tree_;
 }
 
 /**
 * Provides access to the item.
 */
 template<class Key, class Value>
-std::pair<const Key,Value> &
-BinarySearchTree<Key, Value>::iterator::operator*() const
+template<bool IsConst, bool IsReverse>
+typename BinarySearchTree<Key, Value>::template Iterator<IsConst, IsReverse>::reference
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator*() const
 {
     return current_->getItem();
 }
@@ -297,8 +625,9 @@ BinarySearchTree<Key, Value>::iterator::operator*() const
 * Provides access to the address of the item.
 */
 template<class Key, class Value>
-std::pair<const Key,Value> *
-BinarySearchTree<Key, Value>::iterator::operator->() const
+template<bool IsConst, bool IsReverse>
+typename BinarySearchTree<Key, Value>::template Iterator<IsConst, IsReverse>::pointer
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator->() const
 {
     return &(current_->getItem());
 }
@@ -308,9 +637,9 @@ BinarySearchTree<Key, Value>::iterator::operator->() const
 * as 'rhs'
 */
 template<class Key, class Value>
+template<bool IsConst, bool IsReverse>
 bool
-BinarySearchTree<Key, Value>::iterator::operator==(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator==(const Iterator& rhs) const
 {
     // TODO
     // return true or false depending on statement
@@ -326,9 +655,9 @@ BinarySearchTree<Key, Value>::iterator::operator==(
 * as 'rhs'
 */
 template<class Key, class Value>
+template<bool IsConst, bool IsReverse>
 bool
-BinarySearchTree<Key, Value>::iterator::operator!=(
-    const BinarySearchTree<Key, Value>::iterator& rhs) const
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator!=(const Iterator& rhs) const
 {
     // TODO
     // return true or false depending on statement
@@ -341,19 +670,65 @@ BinarySearchTree<Key, Value>::iterator::operator!=(
 
 /**
 * Advances the iterator's location using an in-order sequencing
+* (backwards for the reverse iterators).
 */
 template<class Key, class Value>
-typename BinarySearchTree<Key, Value>::iterator&
-BinarySearchTree<Key, Value>::iterator::operator++()
+template<bool IsConst, bool IsReverse>
+typename BinarySearchTree<Key, Value>::template Iterator<IsConst, IsReverse>&
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator++()
 {
+    TREE_TIME(TREE_OP_INCREMENT);
     // TODO
     // set current to the successor node
-    current_ = successor(current_);
+    current_ = IsReverse ? predecessor(current_) : successor(current_);
 
     // return a reference to the iterator object
     return *this;
 }
 
+/**
+* Post-increment, which returns where the iterator was.
+*/
+template<class Key, class Value>
+template<bool IsConst, bool IsReverse>
+typename BinarySearchTree<Key, Value>::template Iterator<IsConst, IsReverse>
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator++(int)
+{
+    Iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves the iterator's location back one step. Stepping back from the end
+* goes to the last item, found with one descent from the root.
+*/
+template<class Key, class Value>
+template<bool IsConst, bool IsReverse>
+typename BinarySearchTree<Key, Value>::template Iterator<IsConst, IsReverse>&
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator--()
+{
+    if(current_ == NULL){
+        current_ = IsReverse ? tree_->getSmallestNode() : tree_->getLargestNode();
+    } else {
+        current_ = IsReverse ? successor(current_) : predecessor(current_);
+    }
+    return *this;
+}
+
+/**
+* Post-decrement, which returns where the iterator was.
+*/
+template<class Key, class Value>
+template<bool IsConst, bool IsReverse>
+typename BinarySearchTree<Key, Value>::template Iterator<IsConst, IsReverse>
+BinarySearchTree<Key, Value>::Iterator<IsConst, IsReverse>::operator--(int)
+{
+    Iterator old(*this);
+    --(*this);
+    return old;
+}
+
 
 /*
 -------------------------------------------------------------
@@ -376,15 +751,29 @@ BinarySearchTree<Key, Value>::BinarySearchTree()
     // TODO
     // set root to null
     root_ = NULL;
+    // nodes come from new/delete until enablePool() is called
+    pool_ = NULL;
+    poolSlabNodes_ = 0;
+    backgroundClear_ = false;
+    setCount(0);
+    height_ = 0;
+    unbalanced_ = 0;
+    // this tree holds nodes that know their height
+    destroyNode_ = &destroyNodeAs<BSTNode<Key, Value> >;
 
 }
 
+template<typename Key, typename Value>
+const std::size_t BinarySearchTree<Key, Value>::UNKNOWN_COUNT;
+
 template<typename Key, typename Value>
 BinarySearchTree<Key, Value>::~BinarySearchTree()
 {
     // TODO
     // call clear function that we will implement
     clear();
+    // clear() already handed the slabs back so this just frees the pool itself
+    delete pool_;
     
 }
 
@@ -397,6 +786,43 @@ bool BinarySearchTree<Key, Value>::empty() const
     return root_ == NULL;
 }
 
+/**
+* Switches the tree over to a slab allocator for its nodes. Must be called
+* while the tree is empty since nodes made by new cannot go back to a pool.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::enablePool(std::size_t nodesPerSlab)
+{
+    if(root_ != NULL) throw std::logic_error("enablePool() requires an empty tree");
+    if(nodesPerSlab == 0) nodesPerSlab = 1;
+    // the pool itself is made on the first insert, once the node type is known
+    poolSlabNodes_ = nodesPerSlab;
+}
+
+/**
+* With on, clear() and the destructor only detach the nodes (and the node
+* pool, if any) and leave freeing them to a background thread, see
+* node_reclaimer.h, so they return in O(1) however big the tree is.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::setBackgroundClear(bool on)
+{
+    backgroundClear_ = on;
+}
+
+/**
+* Returns the node pool usage, or all zeros when no pool is in use.
+*/
+template<class Key, class Value>
+NodePoolStats BinarySearchTree<Key, Value>::poolStats() const
+{
+    if(pool_ != NULL){
+        return pool_->stats();
+    }
+    NodePoolStats none = {0, 0, 0, 0};
+    return none;
+}
+
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::print() const
 {
@@ -411,7 +837,7 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::begin() const
 {
-    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode());
+    BinarySearchTree<Key, Value>::iterator begin(getSmallestNode(), this);
     return begin;
 }
 
@@ -422,10 +848,56 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::end() const
 {
-    BinarySearchTree<Key, Value>::iterator end(NULL);
+    BinarySearchTree<Key, Value>::iterator end(NULL, this);
     return end;
 }
 
+/**
+* Const versions of begin() and end().
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::const_iterator
+BinarySearchTree<Key, Value>::cbegin() const
+{
+    return const_iterator(getSmallestNode(), this);
+}
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::const_iterator
+BinarySearchTree<Key, Value>::cend() const
+{
+    return const_iterator(NULL, this);
+}
+
+/**
+* Returns an iterator to the "largest" item in the tree that walks toward
+* the smallest, and its end. They step with predecessor() directly, so a
+* descending scan costs the same as an ascending one.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::reverse_iterator
+BinarySearchTree<Key, Value>::rbegin() const
+{
+    return reverse_iterator(getLargestNode(), this);
+}
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::reverse_iterator
+BinarySearchTree<Key, Value>::rend() const
+{
+    return reverse_iterator(NULL, this);
+}
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::const_reverse_iterator
+BinarySearchTree<Key, Value>::crbegin() const
+{
+    return const_reverse_iterator(getLargestNode(), this);
+}
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::const_reverse_iterator
+BinarySearchTree<Key, Value>::crend() const
+{
+    return const_reverse_iterator(NULL, this);
+}
+
 /**
 * Returns an iterator to the item with the given key, k
 * or the end iterator if k does not exist in the tree
@@ -434,11 +906,68 @@ template<class Key, class Value>
 typename BinarySearchTree<Key, Value>::iterator
 BinarySearchTree<Key, Value>::find(const Key & k) const
 {
+    TREE_TIME(TREE_OP_FIND);
     Node<Key, Value> *curr = internalFind(k);
-    BinarySearchTree<Key, Value>::iterator it(curr);
+    BinarySearchTree<Key, Value>::iterator it(curr, this);
     return it;
 }
 
+/**
+* Returns an iterator to the first item whose key is not less than the
+* given key, or end() if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::lower_bound(const Key& key) const
+{
+    return iterator(lowerBoundNode(key), this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than the
+* given key, or end() if there is none.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::upper_bound(const Key& key) const
+{
+    return iterator(upperBoundNode(key), this);
+}
+
+/**
+* Returns lower_bound(key) and upper_bound(key). Keys are unique, so the
+* range holds the item with the key or is empty.
+*/
+template<class Key, class Value>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, typename BinarySearchTree<Key, Value>::iterator>
+BinarySearchTree<Key, Value>::equal_range(const Key& key) const
+{
+    Node<Key, Value>* first = lowerBoundNode(key);
+    // the upper bound is the next node when the key is there, so there is
+    // no need for a second descent
+    Node<Key, Value>* last = first;
+    if(first != nullptr && !KeyCompare<Key>::less(key, first->getKey())){
+      last = successor(first);
+    }
+    return std::make_pair(iterator(first, this), iterator(last, this));
+}
+
+/**
+* Calls fn on every item with lo <= key < hi in key order. The first item is
+* found with one descent and the rest are reached with successor(), so a
+* scan costs O(log n + items in range).
+*/
+template<class Key, class Value>
+template<typename Fn>
+void BinarySearchTree<Key, Value>::for_each_in_range(const Key& lo, const Key& hi, Fn fn) const
+{
+    for(Node<Key, Value>* curr = lowerBoundNode(lo);
+        curr != nullptr && KeyCompare<Key>::less(curr->getKey(), hi);
+        curr = successor(curr)){
+      fn(curr->getItem());
+    }
+}
+
 /**
  * @precondition The key exists in the map
  * Returns the value associated with the key
@@ -463,58 +992,311 @@ Value const & BinarySearchTree<Key, Value>::operator[](const Key& key) const
 * The tree will not remain balanced when inserting.
 * Recall: If key is already in the tree, you should 
 * overwrite the current value with the updated value.
+* Returns an iterator to the item and whether a new node was added.
 */
 template<class Key, class Value>
-void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &keyValuePair)
 {
+    TREE_TIME(TREE_OP_INSERT);
     // TODO
-    // create a new node to be used
-    Node<Key, Value>* insertion = new Node<Key, Value>(keyValuePair.first, keyValuePair.second, nullptr);
+    std::pair<Node<Key, Value>*, bool> result = insertItem<BSTNode<Key, Value> >(keyValuePair);
+    return std::make_pair(iterator(result.first, this), result.second);
+}
 
-    // if the tree is empty then create a new node, set it to root, and return
-    if(root_ == nullptr){
-        root_ = insertion;
-        return;
+/**
+* An insert for temporary pairs (like the result of std::make_pair), so the
+* key and value are moved into the node instead of copied. New nodes come
+* from the virtual createNode() so derived trees still make their own nodes.
+*/
+template<class Key, class Value>
+template<typename P>
+typename std::enable_if<!std::is_lvalue_reference<P>::value &&
+                        std::is_constructible<std::pair<Key, Value>, P&&>::value,
+                        std::pair<typename BinarySearchTree<Key, Value>::iterator, bool> >::type
+BinarySearchTree<Key, Value>::insert(P&& keyValuePair)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result = upsertItem(std::pair<Key, Value>(std::forward<P>(keyValuePair)));
+    return std::make_pair(iterator(result.first, this), result.second);
+}
+
+/**
+* Builds a key/value pair from the arguments and moves it into the tree.
+* If the key was already there its value is moved over instead.
+* Returns an iterator to the item and whether a new node was added.
+* Derived trees hide this with a version that builds the item right inside
+* their own node type; this one is what runs through a base class reference.
+*/
+template<class Key, class Value>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+BinarySearchTree<Key, Value>::emplace(Args&&... args)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result = upsertItem(std::pair<Key, Value>(std::forward<Args>(args)...));
+    return std::make_pair(makeIterator(result.first), result.second);
+}
+
+/**
+* Adds the key with a value built from the arguments, unless the key is
+* already in the tree. Then nothing is built or moved and the old value stays.
+* Returns an iterator to the item and whether a new node was added.
+*/
+template<class Key, class Value>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+BinarySearchTree<Key, Value>::try_emplace(const Key& key, Args&&... args)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result = tryEmplaceItem(key, std::forward<Args>(args)...);
+    return std::make_pair(iterator(result.first, this), result.second);
+}
+template<class Key, class Value>
+template<typename... Args>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+BinarySearchTree<Key, Value>::try_emplace(Key&& key, Args&&... args)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result = tryEmplaceItem(std::move(key), std::forward<Args>(args)...);
+    return std::make_pair(iterator(result.first, this), result.second);
+}
+
+/**
+* Adds the key with the given value, or assigns the value if the key is
+* already in the tree. Returns an iterator to the item and whether a new
+* node was added.
+*/
+template<class Key, class Value>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+BinarySearchTree<Key, Value>::insert_or_assign(const Key& key, M&& value)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result = assignItem(key, std::forward<M>(value));
+    return std::make_pair(iterator(result.first, this), result.second);
+}
+template<class Key, class Value>
+template<typename M>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+BinarySearchTree<Key, Value>::insert_or_assign(Key&& key, M&& value)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result = assignItem(std::move(key), std::forward<M>(value));
+    return std::make_pair(iterator(result.first, this), result.second);
+}
+
+/**
+* The virtual step behind the inserts that don't know the tree's node type,
+* which makes a node of that type and moves the key and value into it.
+*/
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::createNode(Node<Key, Value>* parent, std::pair<Key, Value>&& keyValuePair)
+{
+    return allocateNode<BSTNode<Key, Value> >(InPlaceItem(), static_cast<BSTNode<Key, Value>*>(parent), std::move(keyValuePair));
+}
+
+/**
+* The insert used by every tree. Finds the key or the spot it belongs in with
+* a single descent, overwrites an existing value or makes a node of the
+* tree's node type, and lets the tree rebalance. The item is forwarded so an
+* rvalue is moved, not copied.
+*/
+template<class Key, class Value>
+template<typename NodeType, typename P>
+std::pair<Node<Key, Value>*, bool> BinarySearchTree<Key, Value>::insertItem(P&& keyValuePair)
+{
+    // find the key or the spot it belongs in with a single descent
+    Node<Key, Value>* parent = nullptr;
+    bool goLeft = false;
+    Node<Key, Value>* existing = findInsertPos(keyValuePair.first, parent, goLeft);
+
+    // check if the key is already in the tree and just overwrite if so
+    if(existing != nullptr){
+        existing->setValue(std::forward<P>(keyValuePair).second);
+        return std::make_pair(existing, false);
     }
 
-    // create pointers for traversal and start at root
-    Node<Key, Value>* currentnode = root_;
-
-    while(currentnode != nullptr){
-        // check if the key is already in the tree
-        if(keyValuePair.first == currentnode->getKey()){
-            // if so set value, delete the create node because it is useless, and return
-            currentnode->setValue(keyValuePair.second);
-            delete insertion;
-            return;
-
-        // check if key is more than the current
-        } else if(keyValuePair.first > currentnode->getKey()){
-            // insert if theres no child on right
-            if(currentnode->getRight() == nullptr){ 
-                // attach new node through parent and child and return
-                insertion->setParent(currentnode);
-                currentnode->setRight(insertion);
-                return;
-            } else {
-                // continue to traverse
-                currentnode = currentnode->getRight();
-            }
+    // only now create the new node, attached to its parent
+    NodeType* insertion = allocateNode<NodeType>(InPlaceItem(), static_cast<NodeType*>(parent), std::forward<P>(keyValuePair));
+    linkNode(insertion, parent, goLeft);
+    rebalanceInsert(insertion);
+    return std::make_pair(insertion, true);
+}
 
-        // check if the key is less than the current
-        } else if(keyValuePair.first < currentnode->getKey()){
-            // insert if theres no child on left
-            if(currentnode->getLeft() == nullptr){
-                // attach new node through parent and child and return
-                insertion->setParent(currentnode);
-                currentnode->setLeft(insertion);
-                return;
-            } else {
-                // continue to traverse
-                currentnode = currentnode->getLeft();
-            }
+/**
+* The emplace used by every tree. The key is only known once the item is
+* built, so the node is made first and given back if the key already exists.
+*/
+template<class Key, class Value>
+template<typename NodeType, typename... Args>
+std::pair<Node<Key, Value>*, bool> BinarySearchTree<Key, Value>::emplaceItem(Args&&... args)
+{
+    NodeType* insertion = allocateNode<NodeType>(InPlaceItem(), nullptr, std::forward<Args>(args)...);
+
+    Node<Key, Value>* parent = nullptr;
+    bool goLeft = false;
+    Node<Key, Value>* existing = findInsertPos(insertion->getKey(), parent, goLeft);
+
+    // move the freshly built value over the old one and drop the spare node
+    if(existing != nullptr){
+        existing->setValue(std::move(insertion->getValue()));
+        freeNode(insertion);
+        return std::make_pair(existing, false);
+    }
+
+    insertion->setParent(parent);
+    linkNode(insertion, parent, goLeft);
+    rebalanceInsert(insertion);
+    return std::make_pair(static_cast<Node<Key, Value>*>(insertion), true);
+}
+
+/**
+* Like insertItem(), but for an item that is already a temporary, which is
+* moved into a node made by createNode().
+*/
+template<class Key, class Value>
+std::pair<Node<Key, Value>*, bool> BinarySearchTree<Key, Value>::upsertItem(std::pair<Key, Value>&& keyValuePair)
+{
+    Node<Key, Value>* parent = nullptr;
+    bool goLeft = false;
+    Node<Key, Value>* existing = findInsertPos(keyValuePair.first, parent, goLeft);
+
+    if(existing != nullptr){
+        existing->setValue(std::move(keyValuePair.second));
+        return std::make_pair(existing, false);
+    }
+
+    Node<Key, Value>* insertion = createNode(parent, std::move(keyValuePair));
+    linkNode(insertion, parent, goLeft);
+    rebalanceInsert(insertion);
+    return std::make_pair(insertion, true);
+}
+
+/**
+* The try_emplace used by every tree. The value is only built once the
+* descent has shown the key is missing.
+*/
+template<class Key, class Value>
+template<typename K, typename... Args>
+std::pair<Node<Key, Value>*, bool> BinarySearchTree<Key, Value>::tryEmplaceItem(K&& key, Args&&... args)
+{
+    Node<Key, Value>* parent = nullptr;
+    bool goLeft = false;
+    Node<Key, Value>* existing = findInsertPos(key, parent, goLeft);
+
+    // leave the old value and the arguments untouched
+    if(existing != nullptr){
+        return std::make_pair(existing, false);
+    }
+
+    Node<Key, Value>* insertion = createNode(parent, std::pair<Key, Value>(std::piecewise_construct,
+        std::forward_as_tuple(std::forward<K>(key)), std::forward_as_tuple(std::forward<Args>(args)...)));
+    linkNode(insertion, parent, goLeft);
+    rebalanceInsert(insertion);
+    return std::make_pair(insertion, true);
+}
+
+/**
+* The insert_or_assign used by every tree, which assigns over an existing
+* value or adds a node on the same descent.
+*/
+template<class Key, class Value>
+template<typename K, typename M>
+std::pair<Node<Key, Value>*, bool> BinarySearchTree<Key, Value>::assignItem(K&& key, M&& value)
+{
+    Node<Key, Value>* parent = nullptr;
+    bool goLeft = false;
+    Node<Key, Value>* existing = findInsertPos(key, parent, goLeft);
+
+    if(existing != nullptr){
+        existing->getValue() = std::forward<M>(value);
+        return std::make_pair(existing, false);
+    }
+
+    Node<Key, Value>* insertion = createNode(parent, std::pair<Key, Value>(std::forward<K>(key), std::forward<M>(value)));
+    linkNode(insertion, parent, goLeft);
+    rebalanceInsert(insertion);
+    return std::make_pair(insertion, true);
+}
+
+// helper that hangs a new node off its parent on the side the descent
+// ended on, or makes it the root of an empty tree
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::linkNode(Node<Key, Value>* node, Node<Key, Value>* parent, bool goLeft)
+{
+    if(parent == nullptr){
+        root_ = node;
+    } else if(goLeft){
+        parent->setLeft(node);
+    } else {
+        parent->setRight(node);
+    }
+    if(getCount() != UNKNOWN_COUNT){
+        setCount(getCount() + 1);
+    }
+}
+
+/**
+* Lets derived trees make iterators, whose node constructor is not public.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator
+BinarySearchTree<Key, Value>::makeIterator(Node<Key, Value>* node) const
+{
+    return iterator(node, this);
+}
+
+/**
+* Hook called after a new node is linked in. A plain BST does not rebalance,
+* it only brings the heights above the new leaf up to date.
+*/
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::rebalanceInsert(Node<Key, Value>* node)
+{
+    fixHeights(static_cast<BSTNode<Key, Value>*>(node->getParent()));
+}
+
+// helper that recomputes heights and balanced flags from node up to where
+// a height stays the same, since nothing above that can change, and then
+// the height of the whole tree
+template<class Key, class Value>
+void BinarySearchTree<Key, Value>::fixHeights(BSTNode<Key, Value>* node)
+{
+    for(; node != nullptr; node = node->getParent()){
+        TREE_STAT(retraceSteps);
+        if(!updateHeight(node)){
+            break;
         }
     }
+    height_ = nodeHeight(static_cast<BSTNode<Key, Value>*>(root_));
+}
+
+// helper that recomputes the height and balanced flag of one node from its
+// children, returns true if the height changed
+template<class Key, class Value>
+bool BinarySearchTree<Key, Value>::updateHeight(BSTNode<Key, Value>* node)
+{
+    int lheight = nodeHeight(node->getLeft());
+    int rheight = nodeHeight(node->getRight());
+    bool unbalanced = std::abs(rheight - lheight) > 1;
+    if(unbalanced != node->isUnbalanced()){
+        node->setUnbalanced(unbalanced);
+        unbalanced ? ++unbalanced_ : --unbalanced_;
+    }
+    int height = std::max(lheight, rheight) + 1;
+    if(height == node->getHeight()){
+        return false;
+    }
+    node->setHeight(height);
+    return true;
+}
+
+// helper that reads the height of a possibly empty subtree
+template<class Key, class Value>
+int BinarySearchTree<Key, Value>::nodeHeight(BSTNode<Key, Value>* node)
+{
+    return node == nullptr ? 0 : node->getHeight();
 }
 
 
@@ -526,6 +1308,7 @@ void BinarySearchTree<Key, Value>::insert(const std::pair<const Key, Value> &key
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::remove(const Key& key)
 {
+    TREE_TIME(TREE_OP_REMOVE);
     // TODO
     // Find the node to delete
     Node<Key, Value>* tbd = internalFind(key);
@@ -534,11 +1317,27 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
     if(tbd == nullptr){
       return;
     }
+    removeNode(tbd);
+}
 
+// helper that takes a node that is in the tree out of it and frees it,
+// swapping it with its predecessor first if it has two children
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::removeNode(Node<Key, Value>* tbd)
+{
     // If the node has two children then swap because it will always have 1 child after
     if(tbd->getRight() != nullptr && tbd->getLeft() != nullptr){
       Node<Key, Value>* predecess = predecessor(tbd);
       nodeSwap(tbd, predecess);
+      // heights and flags belong to the position in the tree
+      BSTNode<Key, Value>* moved = static_cast<BSTNode<Key, Value>*>(tbd);
+      BSTNode<Key, Value>* other = static_cast<BSTNode<Key, Value>*>(predecess);
+      int tempH = moved->getHeight();
+      moved->setHeight(other->getHeight());
+      other->setHeight(tempH);
+      bool tempU = moved->isUnbalanced();
+      moved->setUnbalanced(other->isUnbalanced());
+      other->setUnbalanced(tempU);
     }
 
     // save the pointer to the child now and initialize with nullptr
@@ -575,8 +1374,17 @@ void BinarySearchTree<Key, Value>::remove(const Key& key)
         tbdchild->setParent(nullptr);
       }
     }
+  // the removed node no longer counts, then everything above it shrinks
+  BSTNode<Key, Value>* above = static_cast<BSTNode<Key, Value>*>(tbd->getParent());
+  if(static_cast<BSTNode<Key, Value>*>(tbd)->isUnbalanced()){
+    --unbalanced_;
+  }
+  if(getCount() != UNKNOWN_COUNT){
+    setCount(getCount() - 1);
+  }
   // finally delete the node to be deleted
-  delete tbd;
+  freeNode(tbd);
+  fixHeights(above);
 }
 
 template<class Key, class Value>
@@ -632,28 +1440,145 @@ template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::clear()
 {
     // TODO
-    // call the recursive helper and start at root
-    actualclear(root_);
-    // clear the root data member to finish clearing everything
-    root_ = nullptr;
+    // hand everything to the background thread, the pool too, a new
+    // one is made on the next insert
+    if(backgroundClear_ && root_ != nullptr){
+        Node<Key, Value>* root = root_;
+        NodePool* pool = pool_;
+        void (*destroyNode)(Node<Key, Value>*) = destroyNode_;
+        root_ = nullptr;
+        pool_ = NULL;
+        setCount(0);
+        height_ = 0;
+        unbalanced_ = 0;
+        NodeReclaimer::instance().post([root, pool, destroyNode]() {
+            reclaimDetached(root, pool, destroyNode);
+        });
+        return;
+    }
+    // pooled nodes with trivially destructible items need no per-node work,
+    // the slabs can just be handed back all at once
+    if(pool_ != NULL){
+        if(!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<Value>::value){
+            destroyAll(root_);
+        }
+        pool_->release();
+        root_ = nullptr;
+    } else {
+        // call the helper and start at root
+        actualclear(root_);
+        // clear the root data member to finish clearing everything
+        root_ = nullptr;
+    }
+    setCount(0);
+    height_ = 0;
+    unbalanced_ = 0;
 }
 
-// recursive helper function for the clear function
+// helper function for the clear function
 template<typename Key, typename Value>
 void BinarySearchTree<Key, Value>::actualclear(Node<Key, Value>* current)
 {
-    // base case
-    if(current == nullptr){
+    teardown(current, [this](Node<Key, Value>* node) { freeNode(node); });
+}
+
+// helper that runs destructors on pooled nodes without returning them
+// one at a time, clear() releases the slabs afterwards
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::destroyAll(Node<Key, Value>* current)
+{
+    teardown(current, destroyNode_);
+}
+
+// helper that calls fn on every node of a subtree, which fn may free, in
+// O(1) extra space so a degenerate tree cannot overflow the stack: while
+// the top node has a left child it is rotated up, so the tree turns into
+// a list down the right and each top node with no left child can go
+template<typename Key, typename Value>
+template<typename Fn>
+void BinarySearchTree<Key, Value>::teardown(Node<Key, Value>* current, Fn fn)
+{
+    while(current != nullptr){
+        Node<Key, Value>* left = current->getLeft();
+        if(left != nullptr){
+            current->setLeft(left->getRight());
+            left->setRight(current);
+            current = left;
+        } else {
+            Node<Key, Value>* right = current->getRight();
+            fn(current);
+            current = right;
+        }
+    }
+}
+
+// helper the background thread runs to free a tree detached by clear(),
+// with the pool its nodes came from or NULL if they came from new
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::reclaimDetached(Node<Key, Value>* root, NodePool* pool,
+                                                   void (*destroyNode)(Node<Key, Value>* node))
+{
+    if(pool == NULL){
+        teardown(root, [destroyNode](Node<Key, Value>* node) {
+            destroyNode(node);
+            ::operator delete(node);
+        });
         return;
     }
+    if(!std::is_trivially_destructible<Key>::value || !std::is_trivially_destructible<Value>::value){
+        teardown(root, destroyNode);
+    }
+    delete pool;
+}
 
-    // recursive call for right subtree
-    actualclear(current->getRight());
-    // recursive call for left subtree
-    actualclear(current->getLeft());
+/**
+* Makes a node of the given type, from the pool if one is enabled.
+* Derived trees pass their own node type so the pool is sized for it.
+*/
+template<typename Key, typename Value>
+template<typename NodeType, typename... Args>
+NodeType* BinarySearchTree<Key, Value>::allocateNode(Args&&... args)
+{
+    TREE_STAT(allocations);
+    if(poolSlabNodes_ == 0){
+        return new NodeType(std::forward<Args>(args)...);
+    }
+    if(pool_ == NULL){
+        pool_ = new NodePool(sizeof(NodeType), alignof(NodeType), poolSlabNodes_);
+    }
+    void* storage = pool_->allocate();
+    try {
+        return new (storage) NodeType(std::forward<Args>(args)...);
+    } catch(...) {
+        pool_->deallocate(storage);
+        throw;
+    }
+}
 
-    // delete the current node
-    delete current;
+/**
+* Destroys a node made by allocateNode() and gives its storage back.
+*/
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::freeNode(Node<Key, Value>* node)
+{
+    TREE_STAT(frees);
+    // run the destructor for the real node type, then give the memory back
+    destroyNode_(node);
+    if(pool_ == NULL){
+        ::operator delete(node);
+    } else {
+        pool_->deallocate(node);
+    }
+}
+
+/**
+* Node policy hook that destroys a node as the given node type.
+*/
+template<typename Key, typename Value>
+template<typename NodeType>
+void BinarySearchTree<Key, Value>::destroyNodeAs(Node<Key, Value>* node)
+{
+    static_cast<NodeType*>(node)->~NodeType();
 }
 
 
@@ -682,6 +1607,24 @@ BinarySearchTree<Key, Value>::getSmallestNode() const
     return smallest;
 }
 
+/**
+* A helper function to find the largest node in the tree.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>*
+BinarySearchTree<Key, Value>::getLargestNode() const
+{
+    Node<Key, Value>* largest = root_;
+    if(largest == nullptr){
+        return nullptr;
+    }
+    // traverse down and right until you reach the largest node
+    while(largest->getRight() != nullptr){
+        largest = largest->getRight();
+    }
+    return largest;
+}
+
 /**
 * Helper function to find a node with given key, k and
 * return a pointer to it or NULL if no item with that key
@@ -691,36 +1634,186 @@ template<typename Key, typename Value>
 Node<Key, Value>* BinarySearchTree<Key, Value>::internalFind(const Key& key) const
 {
     // TODO
-    // create a node to return and initialize it to root
+    // walk all the way down with one comparison per level, remembering the
+    // last node whose key was not greater than the key we want
     Node<Key, Value>* keyintree = root_;
+    Node<Key, Value>* candidate = nullptr;
 
-    // traverse down the tree until its key is equal to the key and return it
+    TREE_STAT(descents);
     while(keyintree != nullptr){
-      if(keyintree->getKey() == key){
-        return keyintree;
-      } else if(keyintree->getKey() > key){
+      TREE_STAT(descentSteps);
+      if(KeyCompare<Key>::less(key, keyintree->getKey())){
         keyintree = keyintree->getLeft();
-      } else if(keyintree->getKey() < key){
+      } else {
+        candidate = keyintree;
         keyintree = keyintree->getRight();
       }
     }
 
+    // the candidate is <= key, so it matches exactly when it is not < key
+    if(candidate != nullptr && !KeyCompare<Key>::less(candidate->getKey(), key)){
+      return candidate;
+    }
+
     // only reached when key isnt in tree, then return null
     return nullptr;
 }
 
+// helper for lower_bound, which remembers the last node on the way down
+// whose key was not less than the key
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::lowerBoundNode(const Key& key) const
+{
+    Node<Key, Value>* curr = root_;
+    Node<Key, Value>* bound = nullptr;
+    TREE_STAT(descents);
+    while(curr != nullptr){
+      TREE_STAT(descentSteps);
+      if(KeyCompare<Key>::less(curr->getKey(), key)){
+        curr = curr->getRight();
+      } else {
+        bound = curr;
+        curr = curr->getLeft();
+      }
+    }
+    return bound;
+}
+
+// helper for upper_bound, the same walk but keeping nodes greater than the key
+template<class Key, class Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::upperBoundNode(const Key& key) const
+{
+    Node<Key, Value>* curr = root_;
+    Node<Key, Value>* bound = nullptr;
+    TREE_STAT(descents);
+    while(curr != nullptr){
+      TREE_STAT(descentSteps);
+      if(KeyCompare<Key>::less(key, curr->getKey())){
+        bound = curr;
+        curr = curr->getLeft();
+      } else {
+        curr = curr->getRight();
+      }
+    }
+    return bound;
+}
+
+/**
+* Helper for the insert paths. Descends once, one comparison per level like
+* internalFind, and returns the node holding key if there is one. Otherwise
+* returns NULL with parent set to the node the key should hang from (NULL for
+* an empty tree) and goLeft saying which side.
+*/
+template<typename Key, typename Value>
+Node<Key, Value>* BinarySearchTree<Key, Value>::findInsertPos(const Key& key, Node<Key, Value>*& parent, bool& goLeft) const
+{
+    Node<Key, Value>* current = root_;
+    Node<Key, Value>* candidate = nullptr;
+    parent = nullptr;
+    goLeft = false;
+
+    TREE_STAT(descents);
+    while(current != nullptr){
+      TREE_STAT(descentSteps);
+      parent = current;
+      if(KeyCompare<Key>::less(key, current->getKey())){
+        goLeft = true;
+        current = current->getLeft();
+      } else {
+        goLeft = false;
+        candidate = current;
+        current = current->getRight();
+      }
+    }
+
+    if(candidate != nullptr && !KeyCompare<Key>::less(candidate->getKey(), key)){
+      return candidate;
+    }
+    return nullptr;
+}
+
 /**
- * Return true iff the BST is balanced.
+ * Return true iff the BST is balanced. O(1), the tree keeps count of
+ * the nodes that are not.
  */
 template<typename Key, typename Value>
 bool BinarySearchTree<Key, Value>::isBalanced() const
 {
     // TODO
+    return unbalanced_ == 0;
+}
+
+/**
+ * Debug check that walks the whole tree to see if it is balanced, for
+ * testing what isBalanced() keeps track of.
+ */
+template<typename Key, typename Value>
+bool BinarySearchTree<Key, Value>::verifyBalance() const
+{
     // call the helper function with root_ data member and initialized height
     int height = 0;
     return actualbalanced(root_, height);
 }
 
+/**
+ * Returns the number of keys in the tree. O(1), apart from the first call
+ * after splitting an AVLTree that has no subtree sizes, which counts them.
+ * Like the other const members it is safe to call from several threads
+ * at once as long as none of them changes the tree.
+ */
+template<typename Key, typename Value>
+std::size_t BinarySearchTree<Key, Value>::size() const
+{
+    std::size_t count = getCount();
+    if(count == UNKNOWN_COUNT){
+        // readers that get here together all store the same count
+        count = countNodes(root_);
+        setCount(count);
+    }
+    return count;
+}
+
+/**
+ * Returns the number of levels in the tree, 0 when it is empty. O(1).
+ */
+template<typename Key, typename Value>
+int BinarySearchTree<Key, Value>::height() const
+{
+    return height_;
+}
+
+// helper that counts the nodes of a subtree by walking it in order
+template<typename Key, typename Value>
+std::size_t BinarySearchTree<Key, Value>::countNodes(Node<Key, Value>* node)
+{
+    std::size_t count = 0;
+    if(node == nullptr){
+        return count;
+    }
+    while(node->getLeft() != nullptr){
+        node = node->getLeft();
+    }
+    for(; node != nullptr; node = successor(node)){
+        ++count;
+    }
+    return count;
+}
+
+// helper that reads count_; relaxed is enough, the only racing stores are
+// recounts of a tree no one is changing
+template<typename Key, typename Value>
+std::size_t BinarySearchTree<Key, Value>::getCount() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+// helper that writes count_, see getCount()
+template<typename Key, typename Value>
+void BinarySearchTree<Key, Value>::setCount(std::size_t count) const
+{
+    count_.store(count, std::memory_order_relaxed);
+}
+
 template<typename Key, typename Value>
 bool BinarySearchTree<Key, Value>::actualbalanced(Node<Key, Value>* root, int& height) const
 {
@@ -811,6 +1904,7 @@ void BinarySearchTree<Key, Value>::nodeSwap( Node<Key,Value>* n1, Node<Key,Value
     if((n1 == n2) || (n1 == NULL) || (n2 == NULL) ) {
         return;
     }
+    TREE_STAT(nodeSwaps);
     Node<Key, Value>* n1p = n1->getParent();
     Node<Key, Value>* n1r = n1->getRight();
     Node<Key, Value>* n1lt = n1->getLeft();
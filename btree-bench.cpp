@@ -0,0 +1,88 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+#include "bplustree.h"
+
+using namespace std;
+
+// Compares AVLTree with BPlusTree at a few fanouts on random and sequential
+// workloads: n inserts, n lookups (half hits), then n removes. Sequential
+// means the keys arrive in increasing order; lookups and removes always go
+// in random order.
+// usage: ./btree-bench [numKeys]
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+}
+
+template<typename Tree>
+void run(const char* name, const vector<uint64_t>& inserts, const vector<uint64_t>& probes,
+         const vector<uint64_t>& removes)
+{
+    Tree tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < inserts.size(); ++i) tree.insert(std::make_pair(inserts[i], inserts[i]));
+    double insertNs = elapsedNs(start, inserts.size());
+
+    uint64_t hits = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        if(tree.find(probes[i]) != tree.end()) ++hits;
+    }
+    double findNs = elapsedNs(start, probes.size());
+
+    start = Clock::now();
+    for(size_t i = 0; i < removes.size(); ++i) tree.remove(removes[i]);
+    double removeNs = elapsedNs(start, removes.size());
+
+    cout << left << setw(20) << name << right << fixed << setprecision(1)
+         << setw(10) << insertNs << setw(10) << findNs << setw(10) << removeNs
+         << "   (" << hits << " hits, " << (tree.empty() ? "empty" : "NOT empty") << ")" << endl;
+}
+
+static void workload(const char* title, const vector<uint64_t>& inserts, const vector<uint64_t>& probes,
+                     const vector<uint64_t>& removes)
+{
+    cout << title << " (ns per op)" << endl;
+    cout << left << setw(20) << "tree" << right << setw(10) << "insert" << setw(10) << "find" << setw(10) << "remove" << endl;
+    run<AVLTree<uint64_t, uint64_t> >("AVLTree", inserts, probes, removes);
+    run<BPlusTree<uint64_t, uint64_t, 8> >("BPlusTree<8>", inserts, probes, removes);
+    run<BPlusTree<uint64_t, uint64_t, 16> >("BPlusTree<16>", inserts, probes, removes);
+    run<BPlusTree<uint64_t, uint64_t> >("BPlusTree<default>", inserts, probes, removes);
+    run<BPlusTree<uint64_t, uint64_t, 64> >("BPlusTree<64>", inserts, probes, removes);
+    run<BPlusTree<uint64_t, uint64_t, 128> >("BPlusTree<128>", inserts, probes, removes);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+
+    vector<uint64_t> sequential(n);
+    for(size_t i = 0; i < n; ++i) sequential[i] = 2 * i;
+    vector<uint64_t> random(sequential);
+    shuffle(random.begin(), random.end(), mt19937(12));
+    vector<uint64_t> removes(sequential);
+    shuffle(removes.begin(), removes.end(), mt19937(13));
+
+    // half hits and half misses
+    vector<uint64_t> probes(n);
+    mt19937_64 rng(14);
+    for(size_t i = 0; i < n; ++i) probes[i] = rng() % (2 * n);
+
+    cout << n << " keys, BPlusTree<default> fanout is "
+         << BPlusTreeFanout<uint64_t, uint64_t>::value << endl << endl;
+    workload("random inserts", random, probes, removes);
+    cout << endl;
+    workload("sequential inserts", sequential, probes, removes);
+    return 0;
+}
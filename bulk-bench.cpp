@@ -0,0 +1,74 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares loading a snapshot with n calls to insert against AVLTree::assign,
+// for input that is already sorted and for input that has to be sorted first.
+// usage: ./bulk-bench [numKeys]
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedMs(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+typedef vector<pair<uint64_t, uint64_t> > Items;
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+// every case is run a few times and the fastest run is reported
+static const int REPS = 3;
+
+static void insertAll(Tree& tree, const Items& items)
+{
+    for(size_t i = 0; i < items.size(); ++i) tree.insert(items[i]);
+}
+
+static void assignAll(Tree& tree, const Items& items)
+{
+    tree.assign(items.begin(), items.end());
+}
+
+static double bestOf(void (*load)(Tree&, const Items&), const Items& items, bool pooled)
+{
+    double best = 0;
+    for(int rep = 0; rep < REPS; ++rep) {
+        Tree tree;
+        if(pooled) tree.enablePool(1 << 16);
+        Clock::time_point start = Clock::now();
+        load(tree, items);
+        double ms = elapsedMs(start);
+        if(rep == 0 || ms < best) best = ms;
+    }
+    return best;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 5000000;
+
+    Items sorted(n);
+    for(size_t i = 0; i < n; ++i) {
+        sorted[i] = make_pair((uint64_t)i * 3, (uint64_t)i);
+    }
+    Items shuffled(sorted);
+    shuffle(shuffled.begin(), shuffled.end(), mt19937(5));
+
+    cout << n << " keys, best of " << REPS << " runs" << endl << fixed << setprecision(1);
+    cout << "insert x n, sorted:    " << setw(10) << bestOf(insertAll, sorted, false) << " ms" << endl;
+    cout << "assign, sorted:        " << setw(10) << bestOf(assignAll, sorted, false) << " ms" << endl;
+    cout << "assign, shuffled:      " << setw(10) << bestOf(assignAll, shuffled, false) << " ms" << endl;
+    cout << "assign, sorted, pool:  " << setw(10) << bestOf(assignAll, sorted, true) << " ms" << endl;
+    // last, since freeing a randomly built tree leaves malloc handing out
+    // scattered addresses, which slows down everything measured after it
+    cout << "insert x n, shuffled:  " << setw(10) << bestOf(insertAll, shuffled, false) << " ms" << endl;
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+
+using namespace std;
+
+// Times how long clear() holds up the calling thread on a big AVLTree,
+// freeing every node itself against handing the tree to the background
+// reclaimer (setBackgroundClear), with plain and pooled nodes. The time
+// the reclaimer then takes to free the nodes is shown too.
+// usage: ./clear-bench [numKeys]
+
+typedef chrono::steady_clock Clock;
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+static double elapsedMs(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) items[i] = make_pair((uint64_t)i, (uint64_t)i);
+
+    cout << n << " keys (ms)" << endl;
+    cout << left << setw(24) << "nodes" << right << setw(14) << "clear()" << setw(16) << "background"
+         << setw(16) << "reclaimer" << endl;
+    for(int pooled = 0; pooled < 2; ++pooled) {
+        Tree direct;
+        if(pooled) direct.enablePool(1 << 16);
+        direct.assign(items.begin(), items.end());
+        Clock::time_point start = Clock::now();
+        direct.clear();
+        double directMs = elapsedMs(start);
+
+        Tree background;
+        if(pooled) background.enablePool(1 << 16);
+        background.setBackgroundClear(true);
+        background.assign(items.begin(), items.end());
+        start = Clock::now();
+        background.clear();
+        double backgroundMs = elapsedMs(start);
+        NodeReclaimer::instance().drain();
+        double reclaimMs = elapsedMs(start);
+
+        cout << left << setw(24) << (pooled ? "pooled" : "new/delete") << right << fixed << setprecision(2)
+             << setw(14) << directMs << setw(16) << backgroundMs << setw(16) << reclaimMs << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,156 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <string>
+#include <tuple>
+#include <algorithm>
+#include <cstdlib>
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares the single-comparison descent used by find() with the old one
+// that tested ==, > and < at every node, for string and tuple keys. Both
+// searches run over the very same AVL tree. A key type that counts its
+// comparisons shows how many each descent makes per lookup.
+// usage: ./compare-bench [numKeys] [numLookups]
+
+typedef chrono::steady_clock Clock;
+
+// exposes the root so the old descent can walk the same nodes
+template<typename Key>
+class BenchTree : public AVLTree<Key, int>
+{
+public:
+    Node<Key, int>* root() const { return this->root_; }
+};
+
+// the descent internalFind used before
+template<typename Key>
+Node<Key, int>* threeTestFind(Node<Key, int>* curr, const Key& key)
+{
+    while(curr != NULL) {
+        if(curr->getKey() == key) return curr;
+        else if(curr->getKey() > key) curr = curr->getLeft();
+        else if(curr->getKey() < key) curr = curr->getRight();
+    }
+    return NULL;
+}
+
+// an int that counts every comparison made on it
+static long long comparisons = 0;
+struct CountedKey
+{
+    int v;
+    CountedKey(int x = 0) : v(x) {}
+    bool operator<(const CountedKey& o) const { ++comparisons; return v < o.v; }
+    bool operator>(const CountedKey& o) const { ++comparisons; return v > o.v; }
+    bool operator==(const CountedKey& o) const { ++comparisons; return v == o.v; }
+};
+
+// the tree's print support needs every key to be printable
+ostream& operator<<(ostream& out, const CountedKey& k)
+{
+    return out << k.v;
+}
+
+// a composite key compared field by field through std::tuple
+struct TupleKey
+{
+    tuple<int, int, string> fields;
+    TupleKey() {}
+    TupleKey(int a, int b, const string& c) : fields(a, b, c) {}
+    bool operator<(const TupleKey& o) const { return fields < o.fields; }
+    bool operator>(const TupleKey& o) const { return fields > o.fields; }
+    bool operator==(const TupleKey& o) const { return fields == o.fields; }
+};
+
+ostream& operator<<(ostream& out, const TupleKey& k)
+{
+    return out << get<2>(k.fields);
+}
+
+// long shared prefixes make every string comparison do real work
+static string makeString(int i)
+{
+    return "customer/region-07/account-" + to_string(i);
+}
+
+static TupleKey makeTuple(int i)
+{
+    return TupleKey(i % 16, i / 16 % 64, makeString(i));
+}
+
+template<typename Key>
+void runKeys(const char* name, const vector<Key>& keys, const vector<Key>& probes)
+{
+    BenchTree<Key> tree;
+    for(size_t i = 0; i < keys.size(); ++i) tree.insert(std::make_pair(keys[i], (int)i));
+
+    long long hits = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        if(tree.find(probes[i]) != tree.end()) ++hits;
+    }
+    double oneNs = chrono::duration<double, nano>(Clock::now() - start).count() / probes.size();
+
+    long long oldHits = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < probes.size(); ++i) {
+        if(threeTestFind(tree.root(), probes[i]) != NULL) ++oldHits;
+    }
+    double threeNs = chrono::duration<double, nano>(Clock::now() - start).count() / probes.size();
+
+    cout << left << setw(10) << name << right << fixed << setprecision(1)
+         << setw(14) << oneNs << setw(14) << threeNs
+         << "   (" << hits << "/" << oldHits << " hits)" << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    size_t lookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+
+    // even ids are in the tree, odd ids are misses
+    vector<int> ids(n);
+    for(size_t i = 0; i < n; ++i) ids[i] = (int)(2 * i);
+    shuffle(ids.begin(), ids.end(), mt19937(3));
+    vector<int> probeIds(lookups);
+    mt19937 rng(4);
+    for(size_t i = 0; i < lookups; ++i) probeIds[i] = (int)(rng() % (2 * n));
+
+    vector<string> strings, stringProbes;
+    vector<TupleKey> tuples, tupleProbes;
+    for(size_t i = 0; i < n; ++i) {
+        strings.push_back(makeString(ids[i]));
+        tuples.push_back(makeTuple(ids[i]));
+    }
+    for(size_t i = 0; i < lookups; ++i) {
+        stringProbes.push_back(makeString(probeIds[i]));
+        tupleProbes.push_back(makeTuple(probeIds[i]));
+    }
+
+    cout << n << " keys, " << lookups << " lookups (ns per lookup)" << endl;
+    cout << left << setw(10) << "key" << right << setw(14) << "single <" << setw(14) << "==, >, <" << endl;
+    runKeys("string", strings, stringProbes);
+    runKeys("tuple", tuples, tupleProbes);
+
+    // comparisons per lookup on a smaller tree of counted ints
+    vector<CountedKey> counted, countedProbes;
+    for(size_t i = 0; i < n; ++i) counted.push_back(CountedKey(ids[i]));
+    for(size_t i = 0; i < lookups && i < 100000; ++i) countedProbes.push_back(CountedKey(probeIds[i]));
+    BenchTree<CountedKey> tree;
+    for(size_t i = 0; i < counted.size(); ++i) tree.insert(std::make_pair(counted[i], (int)i));
+
+    comparisons = 0;
+    for(size_t i = 0; i < countedProbes.size(); ++i) tree.find(countedProbes[i]);
+    double oneCmp = (double)comparisons / countedProbes.size();
+    comparisons = 0;
+    for(size_t i = 0; i < countedProbes.size(); ++i) threeTestFind(tree.root(), countedProbes[i]);
+    double threeCmp = (double)comparisons / countedProbes.size();
+    cout << "comparisons per lookup: single < " << setprecision(2) << oneCmp
+         << ", ==, >, < " << threeCmp << endl;
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <cstdlib>
+#include <cstdint>
+#include "concurrent_avl.h"
+
+using namespace std;
+
+// Measures read-mostly throughput from 1 up to N threads for the
+// ConcurrentAVLTree against one AVLTree behind a single std::mutex, which
+// is how the tree used to be shared. Each thread does the same number of
+// operations, a given percent of them writes (half inserts, half removes).
+// The rest are point lookups, then in a second run a given percent of the
+// operations become range scans instead, so iteration under the read lock
+// is measured too.
+// usage: ./concurrent-bench [maxThreads] [numKeys] [opsPerThread] [writePercent] [scanPercent]
+
+typedef chrono::steady_clock Clock;
+
+// width of the key range one scan covers; every other key is in the tree to
+// start with, so a scan visits about half this many items
+static const uint64_t SCAN_SPAN = 64;
+
+// the old way: every operation takes the one mutex
+class MutexTree
+{
+public:
+    void insert(const pair<const uint64_t, uint64_t>& item)
+    {
+        lock_guard<mutex> guard(lock_);
+        tree_.insert(item);
+    }
+    void remove(uint64_t key)
+    {
+        lock_guard<mutex> guard(lock_);
+        tree_.remove(key);
+    }
+    bool find(uint64_t key, uint64_t& value)
+    {
+        lock_guard<mutex> guard(lock_);
+        AVLTree<uint64_t, uint64_t>::iterator it = tree_.find(key);
+        if(it == tree_.end()) return false;
+        value = it->second;
+        return true;
+    }
+    template<typename Fn>
+    void for_each_in_range(uint64_t lo, uint64_t hi, Fn fn)
+    {
+        lock_guard<mutex> guard(lock_);
+        tree_.for_each_in_range(lo, hi, fn);
+    }
+private:
+    AVLTree<uint64_t, uint64_t> tree_;
+    mutex lock_;
+};
+
+template<typename Tree>
+void worker(Tree* tree, uint64_t keySpace, size_t ops, unsigned writePercent, unsigned scanPercent,
+            unsigned seed, uint64_t* hits)
+{
+    mt19937_64 rng(seed);
+    uint64_t found = 0;
+    for(size_t i = 0; i < ops; ++i) {
+        uint64_t key = rng() % keySpace;
+        unsigned roll = rng() % 200;
+        if(roll < writePercent) tree->insert(make_pair(key, key));
+        else if(roll < 2 * writePercent) tree->remove(key);
+        else if(roll < 2 * writePercent + 2 * scanPercent) {
+            tree->for_each_in_range(key, key + SCAN_SPAN,
+                                    [&found](const pair<const uint64_t, uint64_t>&) { ++found; });
+        }
+        else {
+            uint64_t value;
+            if(tree->find(key, value)) ++found;
+        }
+    }
+    *hits = found;
+}
+
+template<typename Tree>
+double throughput(unsigned threads, size_t n, size_t ops, unsigned writePercent, unsigned scanPercent)
+{
+    Tree tree;
+    for(size_t i = 0; i < n; i += 2) tree.insert(make_pair((uint64_t)i, (uint64_t)i));
+
+    vector<thread> pool;
+    vector<uint64_t> hits(threads);
+    Clock::time_point start = Clock::now();
+    for(unsigned t = 0; t < threads; ++t) {
+        pool.push_back(thread(worker<Tree>, &tree, (uint64_t)n, ops, writePercent, scanPercent, 100 + t, &hits[t]));
+    }
+    for(unsigned t = 0; t < threads; ++t) pool[t].join();
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    return threads * ops / seconds / 1e6;
+}
+
+// prints the table of one mix, doubling thread counts and always ending on
+// maxThreads
+static void report(unsigned maxThreads, size_t n, size_t ops, unsigned writePercent, unsigned scanPercent)
+{
+    cout << left << setw(10) << "threads" << right << setw(14) << "rw lock" << setw(10) << "x"
+         << setw(14) << "one mutex" << setw(10) << "x" << endl;
+    double rwBase = 0, mutexBase = 0;
+    for(unsigned threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads) {
+        double rw = throughput<ConcurrentAVLTree<uint64_t, uint64_t> >(threads, n, ops, writePercent, scanPercent);
+        double mx = throughput<MutexTree>(threads, n, ops, writePercent, scanPercent);
+        if(threads == 1) { rwBase = rw; mutexBase = mx; }
+        cout << left << setw(10) << threads << right << fixed << setprecision(2)
+             << setw(14) << rw << setw(10) << rw / rwBase
+             << setw(14) << mx << setw(10) << mx / mutexBase << endl;
+        if(threads >= maxThreads) break;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned hw = thread::hardware_concurrency();
+    unsigned maxThreads = argc > 1 ? strtoul(argv[1], NULL, 10) : (hw > 0 ? hw : 4);
+    size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    size_t ops = argc > 3 ? strtoul(argv[3], NULL, 10) : 1000000;
+    unsigned writePercent = argc > 4 ? strtoul(argv[4], NULL, 10) : 5;
+    unsigned scanPercent = argc > 5 ? strtoul(argv[5], NULL, 10) : 10;
+    if(writePercent + scanPercent > 100) {
+        cerr << "writePercent and scanPercent add up to more than 100" << endl;
+        return 1;
+    }
+
+    cout << n / 2 << " keys, " << ops << " ops per thread, " << writePercent << "% writes, "
+         << hw << " hardware threads (Mops/s, speedup over 1 thread)" << endl;
+    cout << "\npoint lookups" << endl;
+    report(maxThreads, n, ops, writePercent, 0);
+    cout << "\n" << scanPercent << "% range scans of " << SCAN_SPAN << " keys, the rest point lookups" << endl;
+    report(maxThreads, n, ops, writePercent, scanPercent);
+    return 0;
+}
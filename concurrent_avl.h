@@ -0,0 +1,281 @@
+#ifndef CONCURRENT_AVL_H
+#define CONCURRENT_AVL_H
+
+#include <stdexcept>
+#include <utility>
+#include "avlbst.h"
+#include "rw_lock.h"
+
+/**
+* An AVLTree that can be shared between threads. Reads (find, contains,
+* operator[], range scans) run at the same time as each other under the
+* shared side of a ReadWriteLock; insert, remove and clear take it
+* exclusively.
+*
+* Lookups hand back copies of values, since a reference could be changed
+* or freed by a writer as soon as the lock is dropped. For iteration, take
+* a ReadView: it holds the read lock for as long as it lives, so its
+* iterators stay valid and see one unchanging tree, and writers wait until
+* it is gone. The view has its own lookups and range scan, which use the
+* lock it already holds.
+*
+* While a thread holds a view, or is inside a for_each_in_range callback,
+* it must not call any member of the tree itself, reads included: each one
+* takes the lock again, and once a writer is waiting a second read lock
+* waits behind it while the writer waits for the first, so the thread
+* deadlocks. Do the reads through the view instead.
+*/
+template <typename Key, typename Value>
+class ConcurrentAVLTree
+{
+public:
+    typedef typename AVLTree<Key, Value>::const_iterator const_iterator;
+
+    /**
+    * A read-locked look at the whole tree, for iterating over it.
+    */
+    class ReadView
+    {
+    public:
+        ReadView(ReadView&& other);
+        ~ReadView();
+
+        const_iterator begin() const;
+        const_iterator end() const;
+        const_iterator find(const Key& key) const;
+        const_iterator lower_bound(const Key& key) const;
+        bool contains(const Key& key) const;
+        const Value& operator[](const Key& key) const;
+        bool empty() const;
+        template<typename Fn>
+        void for_each_in_range(const Key& lo, const Key& hi, Fn fn) const;
+
+    protected:
+        friend class ConcurrentAVLTree<Key, Value>;
+        explicit ReadView(const ConcurrentAVLTree<Key, Value>* tree);
+        // NULL once moved from
+        const ConcurrentAVLTree<Key, Value>* tree_;
+
+    private:
+        ReadView(const ReadView&);
+        ReadView& operator=(const ReadView&);
+    };
+
+    ConcurrentAVLTree();
+
+    bool insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    Value operator[](const Key& key) const;
+    bool empty() const;
+    template<typename Fn>
+    void for_each_in_range(const Key& lo, const Key& hi, Fn fn) const;
+    ReadView read() const;
+
+protected:
+    AVLTree<Key, Value> tree_;
+    mutable ReadWriteLock lock_;
+
+private:
+    // no copying, threads share this very object
+    ConcurrentAVLTree(const ConcurrentAVLTree&);
+    ConcurrentAVLTree& operator=(const ConcurrentAVLTree&);
+};
+
+/*
+----------------------------------------------------------------
+Begin implementations for the ConcurrentAVLTree::ReadView class.
+----------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::ReadView::ReadView(const ConcurrentAVLTree<Key, Value>* tree)
+    : tree_(tree)
+{
+    tree_->lock_.lockShared();
+}
+
+/**
+* Takes over the read lock of another view.
+*/
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::ReadView::ReadView(ReadView&& other)
+    : tree_(other.tree_)
+{
+    other.tree_ = NULL;
+}
+
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::ReadView::~ReadView()
+{
+    if(tree_ != NULL){
+        tree_->lock_.unlockShared();
+    }
+}
+
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::const_iterator
+ConcurrentAVLTree<Key, Value>::ReadView::begin() const
+{
+    return tree_->tree_.cbegin();
+}
+
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::const_iterator
+ConcurrentAVLTree<Key, Value>::ReadView::end() const
+{
+    return tree_->tree_.cend();
+}
+
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::const_iterator
+ConcurrentAVLTree<Key, Value>::ReadView::find(const Key& key) const
+{
+    return tree_->tree_.find(key);
+}
+
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::const_iterator
+ConcurrentAVLTree<Key, Value>::ReadView::lower_bound(const Key& key) const
+{
+    return tree_->tree_.lower_bound(key);
+}
+
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::ReadView::contains(const Key& key) const
+{
+    return find(key) != end();
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key, valid while the view lives
+ */
+template<class Key, class Value>
+const Value& ConcurrentAVLTree<Key, Value>::ReadView::operator[](const Key& key) const
+{
+    const_iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::ReadView::empty() const
+{
+    return tree_->tree_.empty();
+}
+
+/**
+* Calls fn(item) for every item with lo <= key < hi in key order, under
+* the view's lock.
+*/
+template<class Key, class Value>
+template<typename Fn>
+void ConcurrentAVLTree<Key, Value>::ReadView::for_each_in_range(const Key& lo, const Key& hi, Fn fn) const
+{
+    tree_->tree_.for_each_in_range(lo, hi, fn);
+}
+
+/*
+--------------------------------------------------------------
+End implementations for the ConcurrentAVLTree::ReadView class.
+--------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+ConcurrentAVLTree<Key, Value>::ConcurrentAVLTree()
+{
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is already there.
+* Returns true if a new key was added.
+*/
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    std::lock_guard<ReadWriteLock> guard(lock_);
+    return tree_.insert(keyValuePair).second;
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::remove(const Key& key)
+{
+    std::lock_guard<ReadWriteLock> guard(lock_);
+    tree_.remove(key);
+}
+
+template<class Key, class Value>
+void ConcurrentAVLTree<Key, Value>::clear()
+{
+    std::lock_guard<ReadWriteLock> guard(lock_);
+    tree_.clear();
+}
+
+/**
+* Copies the value for the key into value and returns true, or returns
+* false and leaves value alone if the key is not there.
+*/
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    ReadView view(this);
+    const_iterator it = view.find(key);
+    if(it == view.end()){
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::contains(const Key& key) const
+{
+    ReadView view(this);
+    return view.contains(key);
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns a copy of the value associated with the key
+ */
+template<class Key, class Value>
+Value ConcurrentAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    ReadView view(this);
+    return view[key];
+}
+
+template<class Key, class Value>
+bool ConcurrentAVLTree<Key, Value>::empty() const
+{
+    ReadView view(this);
+    return view.empty();
+}
+
+/**
+* Calls fn(item) for every item with lo <= key < hi in key order, all
+* under one read lock so the scan sees a single state of the tree.
+*/
+template<class Key, class Value>
+template<typename Fn>
+void ConcurrentAVLTree<Key, Value>::for_each_in_range(const Key& lo, const Key& hi, Fn fn) const
+{
+    ReadView view(this);
+    view.for_each_in_range(lo, hi, fn);
+}
+
+/**
+* Returns a view that keeps the tree read locked until it is destroyed.
+*/
+template<class Key, class Value>
+typename ConcurrentAVLTree<Key, Value>::ReadView
+ConcurrentAVLTree<Key, Value>::read() const
+{
+    return ReadView(this);
+}
+
+#endif
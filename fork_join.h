@@ -0,0 +1,170 @@
+#ifndef FORK_JOIN_H
+#define FORK_JOIN_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+* A fixed set of worker threads for fork-join recursion, as in the
+* parallel AVLTree set operations.
+*
+* invoke(first, second) queues second for the workers and runs first on
+* the calling thread. If no worker has picked second up by the time first
+* is done, the caller takes it back and runs it too, so small problems
+* never pay for a thread switch. Otherwise the caller helps with other
+* queued tasks while it waits, which keeps every thread busy and means
+* nested invoke() calls cannot deadlock the pool.
+*/
+class ForkJoinPool
+{
+public:
+    // threads counts the caller too, so 1 runs everything inline
+    explicit ForkJoinPool(unsigned threads = std::thread::hardware_concurrency());
+    ~ForkJoinPool();
+
+    unsigned threads() const;
+    template<typename First, typename Second>
+    void invoke(First first, Second second);
+
+private:
+    // no copying, the workers point at this very object
+    ForkJoinPool(const ForkJoinPool&);
+    ForkJoinPool& operator=(const ForkJoinPool&);
+
+    struct Task
+    {
+        std::function<void()> run;
+        std::atomic<bool> done;
+    };
+
+    void work();
+    bool takeBack(Task* task);
+    bool helpOne();
+
+    std::vector<std::thread> workers_;
+    // queued tasks, forked last at the back; workers take the oldest
+    // (biggest) ones from the front
+    std::deque<Task*> queue_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    bool stopping_;
+};
+
+inline ForkJoinPool::ForkJoinPool(unsigned threads)
+    : stopping_(false)
+{
+    for(unsigned i = 1; i < threads; ++i){
+        workers_.push_back(std::thread(&ForkJoinPool::work, this));
+    }
+}
+
+inline ForkJoinPool::~ForkJoinPool()
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        stopping_ = true;
+    }
+    cond_.notify_all();
+    for(std::size_t i = 0; i < workers_.size(); ++i){
+        workers_[i].join();
+    }
+}
+
+inline unsigned ForkJoinPool::threads() const
+{
+    return workers_.size() + 1;
+}
+
+/**
+* Runs first and second, possibly at the same time, and returns once both
+* are done. Both must outlive the call, which they do as locals.
+*/
+template<typename First, typename Second>
+void ForkJoinPool::invoke(First first, Second second)
+{
+    if(workers_.empty()){
+        first();
+        second();
+        return;
+    }
+    Task task;
+    task.run = second;
+    task.done.store(false, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        queue_.push_back(&task);
+    }
+    cond_.notify_one();
+
+    first();
+
+    if(takeBack(&task)){
+        second();
+        return;
+    }
+    // a worker has it, help out with other tasks until it is finished
+    while(!task.done.load(std::memory_order_acquire)){
+        if(!helpOne()){
+            std::this_thread::yield();
+        }
+    }
+}
+
+// helper that removes a task nobody has started yet from the queue
+inline bool ForkJoinPool::takeBack(Task* task)
+{
+    std::lock_guard<std::mutex> guard(mutex_);
+    for(std::deque<Task*>::reverse_iterator it = queue_.rbegin(); it != queue_.rend(); ++it){
+        if(*it == task){
+            queue_.erase(std::next(it).base());
+            return true;
+        }
+    }
+    return false;
+}
+
+// helper that runs the newest queued task, returns false if there was none
+inline bool ForkJoinPool::helpOne()
+{
+    Task* task;
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if(queue_.empty()){
+            return false;
+        }
+        task = queue_.back();
+        queue_.pop_back();
+    }
+    task->run();
+    task->done.store(true, std::memory_order_release);
+    return true;
+}
+
+// helper that is the loop each worker thread runs
+inline void ForkJoinPool::work()
+{
+    while(true){
+        Task* task;
+        {
+            std::unique_lock<std::mutex> guard(mutex_);
+            while(queue_.empty() && !stopping_){
+                cond_.wait(guard);
+            }
+            if(queue_.empty()){
+                return;
+            }
+            task = queue_.front();
+            queue_.pop_front();
+        }
+        task->run();
+        task->done.store(true, std::memory_order_release);
+    }
+}
+
+#endif
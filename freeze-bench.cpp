@@ -0,0 +1,80 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares lookups in an AVLTree, which chase node pointers, against the
+// same keys after freeze(), and against a binary search over a sorted
+// array. The default size is well past the last level cache, where the
+// dependent loads of the tree walk hurt the most.
+// usage: ./freeze-bench [numKeys] [numLookups]
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 8000000;
+    size_t lookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 4000000;
+
+    // insert in random order so the nodes are scattered like a real tree's
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = 2 * i;
+    shuffle(keys.begin(), keys.end(), mt19937(10));
+    AVLTree<uint64_t, uint64_t> tree;
+    for(size_t i = 0; i < n; ++i) tree.insert(std::make_pair(keys[i], keys[i]));
+
+    Clock::time_point start = Clock::now();
+    FrozenTree<uint64_t, uint64_t> frozen = tree.freeze();
+    double freezeMs = elapsedNs(start, 1) / 1e6;
+
+    sort(keys.begin(), keys.end());
+
+    // half hits and half misses
+    vector<uint64_t> probes(lookups);
+    mt19937_64 rng(11);
+    for(size_t i = 0; i < lookups; ++i) probes[i] = rng() % (2 * n);
+
+    uint64_t treeSum = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        AVLTree<uint64_t, uint64_t>::iterator it = tree.find(probes[i]);
+        if(it != tree.end()) treeSum += it->second;
+    }
+    double treeNs = elapsedNs(start, lookups);
+
+    uint64_t frozenSum = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        FrozenTree<uint64_t, uint64_t>::const_iterator it = frozen.find(probes[i]);
+        if(it != frozen.end()) frozenSum += it->second;
+    }
+    double frozenNs = elapsedNs(start, lookups);
+
+    uint64_t sortedSum = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        vector<uint64_t>::const_iterator it = lower_bound(keys.begin(), keys.end(), probes[i]);
+        if(it != keys.end() && *it == probes[i]) sortedSum += *it;
+    }
+    double sortedNs = elapsedNs(start, lookups);
+
+    cout << n << " keys, " << lookups << " lookups (ns per lookup)" << endl << fixed << setprecision(1);
+    cout << "AVLTree::find:        " << setw(10) << treeNs << endl;
+    cout << "FrozenTree::find:     " << setw(10) << frozenNs << endl;
+    cout << "sorted array search:  " << setw(10) << sortedNs << endl;
+    cout << "freeze() took " << freezeMs << " ms, sums "
+         << (treeSum == frozenSum && frozenSum == sortedSum ? "agree" : "DIFFER") << endl;
+    return 0;
+}
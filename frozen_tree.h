@@ -0,0 +1,403 @@
+#ifndef FROZEN_TREE_H
+#define FROZEN_TREE_H
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* A read-only copy of a search tree laid out in Eytzinger (BFS) order: the
+* root is slot 1 and the children of slot k are slots 2k and 2k+1, all in
+* one array. A lookup touches the same nodes a balanced tree would, but the
+* next slot is computed instead of loaded, so the search is a branch free
+* loop over contiguous memory and the top levels share a few cache lines.
+*
+* The keys are kept in their own array so a search only pulls keys into
+* the cache; the items (key and value) sit in a parallel array in the same
+* order for iteration and lookups that found something.
+*
+* Build one with AVLTree::freeze(), or from any sorted range of unique keys.
+*/
+template <typename Key, typename Value>
+class FrozenTree
+{
+public:
+    /**
+    * A bidirectional iterator over the items in key order. Moving to the
+    * next item is a few shifts on the slot number.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::bidirectional_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+        const_iterator& operator--();
+        const_iterator operator--(int);
+
+    protected:
+        friend class FrozenTree<Key, Value>;
+        const_iterator(std::size_t slot, const FrozenTree<Key, Value>* tree);
+        // 1-based slot in the layout, 0 is the end
+        std::size_t slot_;
+        const FrozenTree<Key, Value>* tree_;
+    };
+
+    FrozenTree();
+    template<typename ForwardIt>
+    FrozenTree(ForwardIt first, ForwardIt last);
+
+    std::size_t size() const;
+    bool empty() const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lower_bound(const Key& key) const;
+    const_iterator upper_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+
+protected:
+    void place(std::vector<const std::pair<const Key, Value>*>& sorted, std::size_t& next,
+               std::vector<std::size_t>& order, std::size_t slot);
+    std::size_t firstSlot() const;
+    std::size_t lastSlot() const;
+    static std::size_t trailingOnes(std::size_t slot);
+
+    // how many slots further down the search prefetches, about a cache line of keys
+    static const std::size_t PREFETCH_SPAN =
+        sizeof(Key) >= 64 ? 1 : (sizeof(Key) > 32 ? 2 : (sizeof(Key) > 16 ? 4 : (sizeof(Key) > 8 ? 8 : 16)));
+
+    // slot k lives at index k - 1 of both arrays
+    std::vector<Key> keys_;
+    std::vector<std::pair<const Key, Value> > items_;
+};
+
+/*
+--------------------------------------------------------------
+Begin implementations for the FrozenTree::const_iterator class.
+--------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+FrozenTree<Key, Value>::const_iterator::const_iterator(std::size_t slot, const FrozenTree<Key, Value>* tree)
+    : slot_(slot), tree_(tree)
+{
+}
+
+template<class Key, class Value>
+FrozenTree<Key, Value>::const_iterator::const_iterator()
+    : slot_(0), tree_(NULL)
+{
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>&
+FrozenTree<Key, Value>::const_iterator::operator*() const
+{
+    return tree_->items_[slot_ - 1];
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>*
+FrozenTree<Key, Value>::const_iterator::operator->() const
+{
+    return &tree_->items_[slot_ - 1];
+}
+
+template<class Key, class Value>
+bool FrozenTree<Key, Value>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    return slot_ == rhs.slot_;
+}
+
+template<class Key, class Value>
+bool FrozenTree<Key, Value>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return slot_ != rhs.slot_;
+}
+
+/**
+* Moves to the next key: the leftmost slot of the right subtree if there is
+* one, otherwise up past every ancestor we are the right child of.
+*/
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator&
+FrozenTree<Key, Value>::const_iterator::operator++()
+{
+    std::size_t n = tree_->items_.size();
+    if(2 * slot_ + 1 <= n){
+        slot_ = 2 * slot_ + 1;
+        while(2 * slot_ <= n){
+            slot_ = 2 * slot_;
+        }
+    } else {
+        // right children have odd slots, so drop the trailing ones and one more
+        slot_ >>= trailingOnes(slot_) + 1;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator
+FrozenTree<Key, Value>::const_iterator::operator++(int)
+{
+    const_iterator old(*this);
+    ++(*this);
+    return old;
+}
+
+/**
+* Moves to the previous key, the mirror image of operator++. Stepping back
+* from the end goes to the last key.
+*/
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator&
+FrozenTree<Key, Value>::const_iterator::operator--()
+{
+    std::size_t n = tree_->items_.size();
+    if(slot_ == 0){
+        slot_ = tree_->lastSlot();
+    } else if(2 * slot_ <= n){
+        slot_ = 2 * slot_;
+        while(2 * slot_ + 1 <= n){
+            slot_ = 2 * slot_ + 1;
+        }
+    } else {
+        // left children have even slots, so drop the trailing zeros and one more
+        std::size_t zeros = 0;
+        while(((slot_ >> zeros) & 1) == 0){
+            ++zeros;
+        }
+        slot_ >>= zeros + 1;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator
+FrozenTree<Key, Value>::const_iterator::operator--(int)
+{
+    const_iterator old(*this);
+    --(*this);
+    return old;
+}
+
+/*
+------------------------------------------------------------
+End implementations for the FrozenTree::const_iterator class.
+------------------------------------------------------------
+*/
+
+/**
+* An empty snapshot.
+*/
+template<class Key, class Value>
+FrozenTree<Key, Value>::FrozenTree()
+{
+}
+
+/**
+* Builds the layout from key/value pairs in strictly increasing key order,
+* such as a tree's begin() and end(). The range is walked once, but the
+* items are copied only after the walk, so they must still be there: a
+* forward range, not a stream.
+*/
+template<class Key, class Value>
+template<typename ForwardIt>
+FrozenTree<Key, Value>::FrozenTree(ForwardIt first, ForwardIt last)
+{
+    std::vector<const std::pair<const Key, Value>*> sorted;
+    for(; first != last; ++first){
+        sorted.push_back(&*first);
+    }
+
+    // work out which sorted item each slot gets with an in-order walk of the
+    // implicit tree, then copy the items out in slot order
+    std::vector<std::size_t> order(sorted.size() + 1);
+    std::size_t next = 0;
+    place(sorted, next, order, 1);
+
+    keys_.reserve(sorted.size());
+    items_.reserve(sorted.size());
+    for(std::size_t slot = 1; slot <= sorted.size(); ++slot){
+        keys_.push_back(sorted[order[slot]]->first);
+        items_.push_back(*sorted[order[slot]]);
+    }
+}
+
+template<class Key, class Value>
+std::size_t FrozenTree<Key, Value>::size() const
+{
+    return items_.size();
+}
+
+template<class Key, class Value>
+bool FrozenTree<Key, Value>::empty() const
+{
+    return items_.empty();
+}
+
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator
+FrozenTree<Key, Value>::begin() const
+{
+    return const_iterator(firstSlot(), this);
+}
+
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator
+FrozenTree<Key, Value>::end() const
+{
+    return const_iterator(0, this);
+}
+
+/**
+* Returns an iterator to the item with the given key, or end().
+*/
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator
+FrozenTree<Key, Value>::find(const Key& key) const
+{
+    const_iterator it = lower_bound(key);
+    if(it.slot_ != 0 && KeyCompare<Key>::less(key, keys_[it.slot_ - 1])){
+        return end();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first item whose key is not less than the given
+* key, or end(). The loop goes all the way to the bottom without an early
+* exit, so the only branch is the loop itself and the compiler can turn the
+* step into a conditional add. The slot we last went left at is recovered
+* from the final slot number: going right appends a 1 bit, going left a 0.
+*/
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator
+FrozenTree<Key, Value>::lower_bound(const Key& key) const
+{
+    const Key* keys = keys_.data();
+    std::size_t n = keys_.size();
+    std::size_t slot = 1;
+    while(slot <= n){
+#if defined(__GNUC__)
+        // start loading the keys a few levels down while this one is compared,
+        // clamped to the last key so the address stays inside the array
+        __builtin_prefetch(keys + (std::min(PREFETCH_SPAN * slot, n) - 1));
+#endif
+        slot = 2 * slot + KeyCompare<Key>::less(keys[slot - 1], key);
+    }
+    slot >>= trailingOnes(slot) + 1;
+    return const_iterator(slot, this);
+}
+
+/**
+* Returns an iterator to the first item whose key is greater than the given
+* key, or end(). The same walk as lower_bound, going right on equal keys.
+*/
+template<class Key, class Value>
+typename FrozenTree<Key, Value>::const_iterator
+FrozenTree<Key, Value>::upper_bound(const Key& key) const
+{
+    const Key* keys = keys_.data();
+    std::size_t n = keys_.size();
+    std::size_t slot = 1;
+    while(slot <= n){
+#if defined(__GNUC__)
+        __builtin_prefetch(keys + (std::min(PREFETCH_SPAN * slot, n) - 1));
+#endif
+        slot = 2 * slot + !KeyCompare<Key>::less(key, keys[slot - 1]);
+    }
+    slot >>= trailingOnes(slot) + 1;
+    return const_iterator(slot, this);
+}
+
+/**
+ * @precondition The key exists in the snapshot
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+Value const & FrozenTree<Key, Value>::operator[](const Key& key) const
+{
+    const_iterator it = find(key);
+    if(it.slot_ == 0) throw std::out_of_range("Invalid key");
+    return items_[it.slot_ - 1].second;
+}
+
+// helper that does an in-order walk of the implicit tree so slot numbers
+// are handed out to the sorted items in order
+template<class Key, class Value>
+void FrozenTree<Key, Value>::place(std::vector<const std::pair<const Key, Value>*>& sorted, std::size_t& next,
+                                   std::vector<std::size_t>& order, std::size_t slot)
+{
+    if(slot > sorted.size()){
+        return;
+    }
+    place(sorted, next, order, 2 * slot);
+    order[slot] = next++;
+    place(sorted, next, order, 2 * slot + 1);
+}
+
+// helper for the slot of the smallest key, the leftmost one
+template<class Key, class Value>
+std::size_t FrozenTree<Key, Value>::firstSlot() const
+{
+    if(items_.empty()){
+        return 0;
+    }
+    std::size_t slot = 1;
+    while(2 * slot <= items_.size()){
+        slot = 2 * slot;
+    }
+    return slot;
+}
+
+// helper for the slot of the largest key, the rightmost one
+template<class Key, class Value>
+std::size_t FrozenTree<Key, Value>::lastSlot() const
+{
+    if(items_.empty()){
+        return 0;
+    }
+    std::size_t slot = 1;
+    while(2 * slot + 1 <= items_.size()){
+        slot = 2 * slot + 1;
+    }
+    return slot;
+}
+
+// helper that counts the 1 bits at the bottom of a slot number
+template<class Key, class Value>
+std::size_t FrozenTree<Key, Value>::trailingOnes(std::size_t slot)
+{
+#if defined(__GNUC__)
+    // ~slot always has a 1 bit since slots never fill every bit
+    return static_cast<std::size_t>(__builtin_ctzll(~static_cast<unsigned long long>(slot)));
+#else
+    std::size_t ones = 0;
+    while((slot >> ones) & 1){
+        ++ones;
+    }
+    return ones;
+#endif
+}
+
+#endif
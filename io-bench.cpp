@@ -0,0 +1,64 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+#include "tree_io.h"
+
+using namespace std;
+
+// Times saving an AVLTree with saveTree() and loading it back with
+// loadTree(), in GB/s of file, against rebuilding it the old way with one
+// insert per item in the order they arrived. The file is read back from
+// the page cache, so loads from a cold disk will be slower.
+// usage: ./io-bench [numKeys] [path]
+
+typedef chrono::steady_clock Clock;
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+static double elapsedSeconds(Clock::time_point start)
+{
+    return chrono::duration<double>(Clock::now() - start).count();
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    string path = argc > 2 ? argv[2] : "io-bench.tree";
+
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) items[i] = make_pair((uint64_t)i * 2, (uint64_t)i);
+    shuffle(items.begin(), items.end(), mt19937_64(11));
+
+    Clock::time_point start = Clock::now();
+    Tree replayed;
+    for(size_t i = 0; i < n; ++i) replayed.insert(items[i]);
+    double replaySeconds = elapsedSeconds(start);
+
+    start = Clock::now();
+    saveTree(replayed, path);
+    double saveSeconds = elapsedSeconds(start);
+
+    Tree loaded;
+    start = Clock::now();
+    loadTree(loaded, path);
+    double loadSeconds = elapsedSeconds(start);
+
+    double gb = (sizeof(TreeFileHeader) + n * sizeof(pair<uint64_t, uint64_t>)) / 1e9;
+    bool ok = loaded.size() == n && loaded.isBalanced() && loaded.verifyBalance();
+    remove(path.c_str());
+
+    cout << n << " keys, " << fixed << setprecision(3) << gb << " GB file" << endl;
+    cout << left << setw(28) << "replay inserts (s)" << right << setw(10) << replaySeconds << endl;
+    cout << left << setw(28) << "saveTree (s)" << right << setw(10) << saveSeconds
+         << setw(10) << setprecision(2) << gb / saveSeconds << " GB/s" << endl;
+    cout << left << setw(28) << "loadTree (s)" << right << setw(10) << setprecision(3) << loadSeconds
+         << setw(10) << setprecision(2) << gb / loadSeconds << " GB/s" << endl;
+    cout << (ok ? "loaded tree checks out" : "loaded tree is WRONG") << endl;
+    return ok ? 0 : 1;
+}
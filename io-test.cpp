@@ -0,0 +1,242 @@
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <string>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <stdexcept>
+#include "bst.h"
+#include "avlbst.h"
+#include "tree_io.h"
+#include "tree_trace.h"
+
+using namespace std;
+
+// Checks that saveTree() and loadTree() round trip a tree and that
+// loadTree() refuses every kind of bad file, leaving the tree alone, and
+// that readTrace() gives back exactly what a TraceRecorder recorded.
+
+static const char* const PATH = "io-test.tree";
+static const char* const TRACE_PATH = "io-test.trace";
+
+// helpers that read and write a whole file as bytes
+static vector<char> readBytes(const string& path)
+{
+    ifstream in(path.c_str(), ios::binary);
+    return vector<char>(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+}
+
+static void writeBytes(const string& path, const vector<char>& bytes)
+{
+    ofstream out(path.c_str(), ios::binary | ios::trunc);
+    out.write(bytes.data(), bytes.size());
+}
+
+// helper that checks loading path fails with a message containing what,
+// and that the tree it was loaded into keeps its one item
+template<typename Key, typename Value>
+void expectLoadFails(const string& path, const string& what)
+{
+    AVLTree<Key, Value> tree;
+    tree.insert(std::make_pair(Key(7), Value(7)));
+    bool threw = false;
+    try {
+        loadTree(tree, path);
+    } catch(const std::runtime_error& e) {
+        threw = string(e.what()).find(what) != string::npos;
+        if(!threw) cerr << "unexpected error: " << e.what() << endl;
+    }
+    assert(threw);
+    assert(tree.size() == 1 && tree.find(Key(7)) != tree.end());
+}
+
+static void testRoundTrip()
+{
+    // uint32_t keys with uint64_t values leave padding inside each item
+    BinarySearchTree<uint32_t, uint64_t> saved;
+    for(uint32_t i = 0; i < 5000; ++i) {
+        saved.insert(std::make_pair((i * 7919) % 5000, uint64_t(i) << 20));
+    }
+    saveTree(saved, PATH);
+
+    vector<char> bytes = readBytes(PATH);
+    typedef std::pair<uint32_t, uint64_t> Item;
+    assert(bytes.size() == sizeof(TreeFileHeader) + saved.size() * sizeof(Item));
+    for(size_t i = 0; i < saved.size(); ++i) {
+        const char* item = bytes.data() + sizeof(TreeFileHeader) + i * sizeof(Item);
+        for(size_t b = sizeof(uint32_t); b < offsetof(Item, second); ++b) {
+            assert(item[b] == 0);
+        }
+    }
+
+    AVLTree<uint32_t, uint64_t> loaded;
+    loaded.insert(std::make_pair(99999u, uint64_t(1)));
+    loadTree(loaded, PATH);
+    assert(loaded.size() == saved.size());
+    assert(loaded.isBalanced() && loaded.verifyBalance());
+    BinarySearchTree<uint32_t, uint64_t>::const_iterator it = saved.cbegin();
+    for(AVLTree<uint32_t, uint64_t>::const_iterator lit = loaded.cbegin(); lit != loaded.cend(); ++lit, ++it) {
+        assert(lit->first == it->first && lit->second == it->second);
+    }
+    assert(it == saved.cend());
+
+    // an empty tree is just a header
+    BinarySearchTree<uint32_t, uint64_t> empty;
+    saveTree(empty, PATH);
+    loadTree(loaded, PATH);
+    assert(loaded.empty() && loaded.size() == 0);
+}
+
+static void testBadFiles()
+{
+    AVLTree<int, int> tree;
+    for(int i = 0; i < 100; ++i) {
+        tree.insert(std::make_pair(i, -i));
+    }
+    saveTree(tree, PATH);
+    const vector<char> good = readBytes(PATH);
+
+    vector<char> bytes = good;
+    bytes[0] = 'X';
+    writeBytes(PATH, bytes);
+    expectLoadFails<int, int>(PATH, "not a tree file");
+
+    bytes = good;
+    bytes[8] = 99;
+    writeBytes(PATH, bytes);
+    expectLoadFails<int, int>(PATH, "version");
+
+    writeBytes(PATH, good);
+    expectLoadFails<long long, int>(PATH, "different key, value");
+    expectLoadFails<int, long long>(PATH, "different key, value");
+
+    bytes = good;
+    bytes.pop_back();
+    writeBytes(PATH, bytes);
+    expectLoadFails<int, int>(PATH, "truncated");
+
+    bytes = good;
+    bytes.push_back(0);
+    writeBytes(PATH, bytes);
+    expectLoadFails<int, int>(PATH, "past its last item");
+
+    bytes.assign(good.begin(), good.begin() + 10);
+    writeBytes(PATH, bytes);
+    expectLoadFails<int, int>(PATH, "not a tree file");
+
+    std::remove(PATH);
+    expectLoadFails<int, int>(PATH, "cannot open");
+}
+
+// helper that checks reading the trace at path fails with a message
+// containing what
+static void expectReadFails(const string& path, const string& what)
+{
+    bool threw = false;
+    try {
+        readTrace<uint32_t, uint64_t>(path);
+    } catch(const std::runtime_error& e) {
+        threw = string(e.what()).find(what) != string::npos;
+        if(!threw) cerr << "unexpected error: " << e.what() << endl;
+    }
+    assert(threw);
+}
+
+static void testTrace()
+{
+    typedef TraceEvent<uint32_t, uint64_t> Event;
+    vector<Event> expected;
+    AVLTree<uint32_t, uint64_t> tree;
+    {
+        TraceRecorder<uint32_t, uint64_t> recorder(tree, TRACE_PATH);
+        for(uint32_t i = 0; i < 3000; ++i) {
+            Event event = Event();
+            event.key = (i * 7919) % 1000;
+            switch(i % 4) {
+            case 0:
+                event.op = TRACE_INSERT;
+                event.value = uint64_t(i) << 33;
+                recorder.insert(std::make_pair(event.key, event.value));
+                break;
+            case 1:
+                event.op = TRACE_FIND;
+                recorder.find(event.key);
+                break;
+            case 2:
+                event.op = TRACE_RANGE;
+                event.hi = event.key + 10;
+                recorder.for_each_in_range(event.key, event.hi, [](const std::pair<const uint32_t, uint64_t>&) { });
+                break;
+            default:
+                event.op = TRACE_REMOVE;
+                recorder.remove(event.key);
+                break;
+            }
+            expected.push_back(event);
+        }
+        assert(recorder.count() == expected.size());
+        recorder.close();
+    }
+
+    // the recorder did every operation on the tree too
+    map<uint32_t, uint64_t> model;
+    for(size_t i = 0; i < expected.size(); ++i) {
+        if(expected[i].op == TRACE_INSERT) model[expected[i].key] = expected[i].value;
+        if(expected[i].op == TRACE_REMOVE) model.erase(expected[i].key);
+    }
+    assert(tree.size() == model.size() && tree.isBalanced());
+    for(map<uint32_t, uint64_t>::const_iterator it = model.begin(); it != model.end(); ++it) {
+        assert(tree.find(it->first) != tree.end() && tree.find(it->first)->second == it->second);
+    }
+
+    vector<Event> events = readTrace<uint32_t, uint64_t>(TRACE_PATH);
+    assert(events.size() == expected.size());
+    for(size_t i = 0; i < events.size(); ++i) {
+        assert(events[i].op == expected[i].op && events[i].key == expected[i].key);
+        assert(events[i].op != TRACE_INSERT || events[i].value == expected[i].value);
+        assert(events[i].op != TRACE_RANGE || events[i].hi == expected[i].hi);
+    }
+
+    const vector<char> good = readBytes(TRACE_PATH);
+    vector<char> bytes = good;
+    bytes.pop_back();
+    writeBytes(TRACE_PATH, bytes);
+    expectReadFails(TRACE_PATH, "truncated");
+
+    // the first record starts with an insert's op byte
+    bytes = good;
+    bytes[sizeof(TraceFileHeader)] = char(200);
+    writeBytes(TRACE_PATH, bytes);
+    expectReadFails(TRACE_PATH, "unknown operation");
+    bytes[sizeof(TraceFileHeader)] = 0;
+    writeBytes(TRACE_PATH, bytes);
+    expectReadFails(TRACE_PATH, "unknown operation");
+
+    bytes = good;
+    bytes[0] = 'X';
+    writeBytes(TRACE_PATH, bytes);
+    expectReadFails(TRACE_PATH, "not a trace file");
+
+    writeBytes(TRACE_PATH, good);
+    bool threw = false;
+    try {
+        readTrace<uint64_t, uint64_t>(TRACE_PATH);
+    } catch(const std::runtime_error&) {
+        threw = true;
+    }
+    assert(threw);
+    std::remove(TRACE_PATH);
+}
+
+int main()
+{
+    testRoundTrip();
+    testBadFiles();
+    testTrace();
+    std::remove(PATH);
+    cout << "io-test passed" << endl;
+    return 0;
+}
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+
+using namespace std;
+
+// Times full scans forward, backward with rbegin(), and backward with
+// std::reverse_iterator over the plain iterator (which steps back twice per
+// item), plus a top-N query done with rbegin() against the old way of
+// scanning the whole tree forward and keeping the last N.
+// usage: ./iter-bench [numKeys] [topN]
+
+typedef chrono::steady_clock Clock;
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+static double elapsedNs(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    size_t topN = argc > 2 ? strtoul(argv[2], NULL, 10) : 10;
+
+    vector<uint64_t> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = i;
+    shuffle(keys.begin(), keys.end(), mt19937(9));
+    Tree tree;
+    for(size_t i = 0; i < n; ++i) tree.insert(std::make_pair(keys[i], keys[i]));
+
+    uint64_t sum = 0;
+    Clock::time_point start = Clock::now();
+    for(Tree::const_iterator it = tree.cbegin(); it != tree.cend(); ++it) sum += it->second;
+    double fwd = elapsedNs(start, n);
+
+    uint64_t rsum = 0;
+    start = Clock::now();
+    for(Tree::const_reverse_iterator it = tree.crbegin(); it != tree.crend(); ++it) rsum += it->second;
+    double back = elapsedNs(start, n);
+
+    uint64_t ssum = 0;
+    std::reverse_iterator<Tree::const_iterator> first(tree.cend()), last(tree.cbegin());
+    start = Clock::now();
+    for(; first != last; ++first) ssum += first->second;
+    double stdBack = elapsedNs(start, n);
+
+    cout << n << " keys (ns per item)" << endl << fixed << setprecision(2);
+    cout << "forward:                  " << setw(10) << fwd << endl;
+    cout << "rbegin():                 " << setw(10) << back << endl;
+    cout << "std::reverse_iterator:    " << setw(10) << stdBack << endl;
+
+    // top N keys: walk back from the end, or the old full forward scan
+    vector<uint64_t> top, oldTop;
+    start = Clock::now();
+    for(Tree::reverse_iterator it = tree.rbegin(); it != tree.rend() && top.size() < topN; ++it) top.push_back(it->first);
+    double topNs = elapsedNs(start, 1);
+    start = Clock::now();
+    for(Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+        oldTop.push_back(it->first);
+        if(oldTop.size() > topN) oldTop.erase(oldTop.begin());
+    }
+    reverse(oldTop.begin(), oldTop.end());
+    double oldTopNs = elapsedNs(start, 1);
+
+    cout << "top " << topN << " with rbegin(): " << topNs / 1000 << " us, with a forward scan: "
+         << oldTopNs / 1000 << " us (" << (top == oldTop ? "same" : "DIFFERENT") << " keys)" << endl;
+    cout << "sums " << (sum == rsum && rsum == ssum ? "agree" : "DIFFER") << endl;
+    return 0;
+}
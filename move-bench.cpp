@@ -0,0 +1,124 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <vector>
+#include <string>
+#include <utility>
+#include <cstdlib>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Counts how often keys and values are copied or moved on the way into a
+// tree for each insert path, then times the paths with a large value.
+// usage: ./move-bench [numKeys] [valueBytes]
+
+typedef chrono::steady_clock Clock;
+
+static long long copies = 0;
+static long long moves = 0;
+
+// a movable value that counts what happens to it
+struct Tracked
+{
+    vector<char> data;
+    Tracked() {}
+    explicit Tracked(size_t bytes) : data(bytes, 'x') {}
+    Tracked(const Tracked& o) : data(o.data) { ++copies; }
+    Tracked(Tracked&& o) : data(std::move(o.data)) { ++moves; }
+    Tracked& operator=(const Tracked& o) { data = o.data; ++copies; return *this; }
+    Tracked& operator=(Tracked&& o) { data = std::move(o.data); ++moves; return *this; }
+};
+
+// the tree's print support needs every key to be printable
+ostream& operator<<(ostream& out, const Tracked& t)
+{
+    return out << t.data.size();
+}
+
+typedef AVLTree<string, Tracked> Tree;
+
+static string keyFor(size_t i)
+{
+    return "a-key-too-long-for-the-small-string-buffer-" + to_string(i);
+}
+
+static void report(const char* name, size_t n)
+{
+    cout << left << setw(28) << name << right << fixed << setprecision(2)
+         << setw(10) << (double)copies / n << setw(10) << (double)moves / n << endl;
+    copies = moves = 0;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    size_t bytes = argc > 2 ? strtoul(argv[2], NULL, 10) : 1024;
+
+    cout << "Tracked copies/moves per insert (new keys)" << endl;
+    cout << left << setw(28) << "path" << right << setw(10) << "copies" << setw(10) << "moves" << endl;
+    {
+        Tree tree;
+        for(size_t i = 0; i < 1000; ++i) {
+            std::pair<const string, Tracked> item(keyFor(i), Tracked(16));
+            copies = moves = 0;
+            tree.insert(item);
+        }
+        report("insert(const pair&)", 1);
+    }
+    {
+        Tree tree;
+        long long c = 0, m = 0;
+        for(size_t i = 0; i < 1000; ++i) {
+            string key = keyFor(i);
+            Tracked value(16);
+            copies = moves = 0;
+            tree.insert(std::make_pair(std::move(key), std::move(value)));
+            c += copies; m += moves;
+        }
+        copies = c; moves = m;
+        report("insert(make_pair(move...))", 1000);
+    }
+    {
+        Tree tree;
+        long long c = 0, m = 0;
+        for(size_t i = 0; i < 1000; ++i) {
+            string key = keyFor(i);
+            Tracked value(16);
+            copies = moves = 0;
+            tree.emplace(std::move(key), std::move(value));
+            c += copies; m += moves;
+        }
+        copies = c; moves = m;
+        report("emplace(move(k), move(v))", 1000);
+    }
+    {
+        Tree tree;
+        copies = moves = 0;
+        for(size_t i = 0; i < 1000; ++i) {
+            tree.emplace(std::piecewise_construct, std::forward_as_tuple(keyFor(i)), std::forward_as_tuple(16));
+        }
+        report("emplace(piecewise)", 1000);
+    }
+
+    // time the copying path against the moving one with a big value
+    cout << "\n" << n << " inserts of " << bytes << " byte values (ns per insert)" << endl;
+    vector<string> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = keyFor(i * 7919 % n);
+    {
+        vector<Tracked> values(n, Tracked(bytes));
+        Tree tree;
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < n; ++i) tree.insert(std::pair<const string, Tracked>(keys[i], values[i]));
+        cout << "copy:  " << chrono::duration<double, nano>(Clock::now() - start).count() / n << endl;
+    }
+    {
+        vector<Tracked> values(n, Tracked(bytes));
+        Tree tree;
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < n; ++i) tree.emplace(std::move(keys[i]), std::move(values[i]));
+        cout << "move:  " << chrono::duration<double, nano>(Clock::now() - start).count() / n << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "avlbst.h"
+
+using namespace std;
+
+// Measures the cost of a lookup with the non-virtual node getters against
+// the same search over nodes whose getters are virtual, which is how Node
+// and AVLNode used to be laid out. The virtual copy has exactly the shape
+// of the AVL tree so both searches visit the same nodes.
+// usage: ./node-bench [numKeys] [numLookups]
+
+typedef chrono::steady_clock Clock;
+
+// stand-ins for the old node classes
+struct VirtualNode
+{
+    VirtualNode(int k, int v) : key(k), value(v), parent(NULL), left(NULL), right(NULL) {}
+    virtual ~VirtualNode() {}
+    virtual VirtualNode* getLeft() const { return left; }
+    virtual VirtualNode* getRight() const { return right; }
+    int key;
+    int value;
+    VirtualNode* parent;
+    VirtualNode* left;
+    VirtualNode* right;
+};
+
+struct VirtualAVLNode : public VirtualNode
+{
+    VirtualAVLNode(int k, int v) : VirtualNode(k, v), balance(0) {}
+    virtual VirtualAVLNode* getLeft() const { return static_cast<VirtualAVLNode*>(left); }
+    virtual VirtualAVLNode* getRight() const { return static_cast<VirtualAVLNode*>(right); }
+    int8_t balance;
+};
+
+// exposes the root so the shape can be copied
+class BenchTree : public AVLTree<int, int>
+{
+public:
+    Node<int, int>* root() const { return root_; }
+};
+
+static VirtualNode* copyShape(Node<int, int>* n)
+{
+    if(n == NULL) return NULL;
+    VirtualNode* copy = new VirtualAVLNode(n->getKey(), n->getValue());
+    copy->left = copyShape(n->getLeft());
+    copy->right = copyShape(n->getRight());
+    return copy;
+}
+
+static void freeShape(VirtualNode* n)
+{
+    if(n == NULL) return;
+    freeShape(n->left);
+    freeShape(n->right);
+    delete n;
+}
+
+// the same loop internalFind uses, but every step is an indirect call
+static VirtualNode* virtualFind(VirtualNode* root, int key)
+{
+    // keep the calls from being devirtualized since the tree is built here
+    VirtualNode* volatile start = root;
+    VirtualNode* curr = start;
+    while(curr != NULL) {
+        if(curr->key == key) return curr;
+        else if(curr->key > key) curr = curr->getLeft();
+        else curr = curr->getRight();
+    }
+    return NULL;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+    size_t lookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 10000000;
+
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = (int)(i * 2);
+    shuffle(keys.begin(), keys.end(), mt19937(1));
+
+    BenchTree tree;
+    for(size_t i = 0; i < n; ++i) tree.insert(std::make_pair(keys[i], (int)i));
+    VirtualNode* shadow = copyShape(tree.root());
+
+    // half hits and half misses
+    vector<int> probes(lookups);
+    mt19937 rng(2);
+    for(size_t i = 0; i < lookups; ++i) probes[i] = (int)(rng() % (2 * n));
+
+    long long found = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        if(tree.find(probes[i]) != tree.end()) ++found;
+    }
+    double directNs = chrono::duration<double, nano>(Clock::now() - start).count() / lookups;
+
+    long long vfound = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < lookups; ++i) {
+        if(virtualFind(shadow, probes[i]) != NULL) ++vfound;
+    }
+    double virtualNs = chrono::duration<double, nano>(Clock::now() - start).count() / lookups;
+
+    cout << n << " keys, " << lookups << " lookups" << endl;
+    cout << "sizeof AVLNode<int,int>:  direct " << sizeof(AVLNode<int, int>)
+         << " B, virtual " << sizeof(VirtualAVLNode) << " B" << endl;
+    cout << fixed << setprecision(1);
+    cout << "direct getters:  " << directNs << " ns/lookup (" << found << " hits)" << endl;
+    cout << "virtual getters: " << virtualNs << " ns/lookup (" << vfound << " hits)" << endl;
+
+    freeShape(shadow);
+    return 0;
+}
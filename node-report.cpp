@@ -0,0 +1,104 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdint>
+#include "avlbst.h"
+
+using namespace std;
+
+// Prints the size of each node type for a few common key/value types,
+// how much of it is bookkeeping, and what one entry really costs once the
+// allocator is counted. Plain new goes through malloc, which adds an 8 byte
+// header and rounds to 16 bytes on glibc; the NodePool only rounds up to
+// the node's alignment.
+//
+// A node small enough for one cache line can still straddle two, depending
+// on where it lands, so the last two columns give the measured share of
+// nodes that do, pooled and under malloc.
+
+static const size_t CACHE_LINE = 64;
+
+// what glibc malloc uses for a request of the given size
+static size_t mallocChunk(size_t bytes)
+{
+    size_t chunk = (bytes + 8 + 15) / 16 * 16;
+    return chunk < 32 ? 32 : chunk;
+}
+
+// distinct keys for the measured tree
+template<typename Key>
+Key makeKey(int i)
+{
+    return Key(i);
+}
+
+template<>
+std::string makeKey<std::string>(int i)
+{
+    return std::to_string(i);
+}
+
+// helper that gives the percentage of the tree's nodes that cross a cache
+// line boundary. The item is a node's first member, so its address is the
+// node's.
+template<typename Key, typename Value>
+double straddlingPercent(const AVLTree<Key, Value>& tree)
+{
+    size_t nodes = 0, straddling = 0;
+    for(typename AVLTree<Key, Value>::const_iterator it = tree.cbegin(); it != tree.cend(); ++it) {
+        uintptr_t start = reinterpret_cast<uintptr_t>(&*it);
+        ++nodes;
+        straddling += start % CACHE_LINE + sizeof(AVLNode<Key, Value>) > CACHE_LINE;
+    }
+    return nodes ? 100.0 * straddling / nodes : 0;
+}
+
+template<typename Key, typename Value>
+void reportRow(const char* name)
+{
+    typedef AVLNode<Key, Value> NodeType;
+    size_t payload = sizeof(std::pair<const Key, Value>);
+    size_t node = sizeof(NodeType);
+
+    // measure the pooled cost with a real tree instead of trusting the formula
+    AVLTree<Key, Value> tree;
+    AVLTree<Key, Value> unpooled;
+    tree.enablePool(1024);
+    for(int i = 0; i < 1024; ++i) {
+        tree.insert(std::make_pair(makeKey<Key>(i), Value()));
+        unpooled.insert(std::make_pair(makeKey<Key>(i), Value()));
+    }
+    NodePoolStats stats = tree.poolStats();
+    size_t pooled = stats.liveNodes ? stats.bytesLive / stats.liveNodes : node;
+    cout << left << setw(22) << name << right
+         << setw(8) << payload
+         << setw(8) << node
+         << setw(10) << node - payload
+         << setw(10) << mallocChunk(node)
+         << setw(10) << pooled
+         << fixed << setprecision(1)
+         << setw(11) << straddlingPercent(tree) << "%"
+         << setw(11) << straddlingPercent(unpooled) << "%" << endl;
+}
+
+int main()
+{
+    cout << "AVLNode memory per entry (bytes)" << endl;
+    cout << left << setw(22) << "key, value" << right
+         << setw(8) << "item" << setw(8) << "node" << setw(10) << "overhead"
+         << setw(10) << "malloc" << setw(10) << "pooled"
+         << setw(12) << "split pool" << setw(12) << "split heap" << endl;
+
+    reportRow<uint32_t, uint32_t>("uint32_t, uint32_t");
+    reportRow<uint64_t, uint64_t>("uint64_t, uint64_t");
+    reportRow<uint64_t, char>("uint64_t, char");
+    reportRow<int, double>("int, double");
+    reportRow<std::string, int>("std::string, int");
+
+    cout << "\nsizeof Node<uint64_t,uint64_t> = " << sizeof(Node<uint64_t, uint64_t>)
+         << ", sizeof AVLNode<uint64_t,uint64_t> = " << sizeof(AVLNode<uint64_t, uint64_t>)
+         << " (balance lives in the parent pointer)" << endl;
+    cout << "sizeof BSTNode<uint64_t,uint64_t> = " << sizeof(BSTNode<uint64_t, uint64_t>)
+         << " (a plain BST also keeps each subtree height)" << endl;
+    return 0;
+}
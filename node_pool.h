@@ -0,0 +1,186 @@
+#ifndef NODE_POOL_H
+#define NODE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+/**
+* Usage numbers for a NodePool, all in bytes except for the counts.
+*/
+struct NodePoolStats
+{
+    std::size_t bytesReserved;  // memory held in slabs
+    std::size_t bytesLive;      // memory handed out and not yet returned
+    std::size_t liveNodes;      // number of blocks currently handed out
+    std::size_t slabs;          // number of slabs allocated
+};
+
+/**
+* A fixed-size block allocator for tree nodes. Memory is taken from the
+* heap a slab (many blocks) at a time and carved up in order. Freed blocks
+* go on a free list and are handed back out before any new slab space is
+* used, so insert/remove churn does not touch malloc at all.
+*
+* Slabs start on a cache line, so blocks whose size divides the line (32
+* or 64 bytes, say) never straddle two lines; other sizes straddle as
+* often as their stride makes them.
+*
+* All of the memory is returned at once by release() or the destructor.
+* The pool never runs destructors itself; that is up to the caller.
+*/
+class NodePool
+{
+public:
+    NodePool(std::size_t blockSize, std::size_t blockAlign, std::size_t blocksPerSlab = 1024);
+    ~NodePool();
+
+    void* allocate();
+    void deallocate(void* block);
+    void release();
+    NodePoolStats stats() const;
+
+private:
+    // no copying, a pool owns its slabs
+    NodePool(const NodePool&);
+    NodePool& operator=(const NodePool&);
+
+    void addSlab();
+
+    // slabs start on a boundary of this many bytes
+    static const std::size_t SLAB_ALIGN = 64;
+
+    // freed blocks are chained through their own storage
+    struct FreeBlock
+    {
+        FreeBlock* next;
+    };
+
+    std::size_t blockSize_;
+    std::size_t blocksPerSlab_;
+    std::vector<char*> slabs_;
+    FreeBlock* freeList_;
+    char* bump_;
+    char* bumpEnd_;
+    std::size_t live_;
+};
+
+/*
+  ---------------------------------------------
+  Begin implementations for the NodePool class.
+  ---------------------------------------------
+*/
+
+/**
+* Creates an empty pool that hands out blocks of at least blockSize bytes
+* aligned to blockAlign. No memory is reserved until the first allocate().
+*/
+inline NodePool::NodePool(std::size_t blockSize, std::size_t blockAlign, std::size_t blocksPerSlab) :
+    blockSize_(blockSize),
+    blocksPerSlab_(blocksPerSlab == 0 ? 1 : blocksPerSlab),
+    freeList_(NULL),
+    bump_(NULL),
+    bumpEnd_(NULL),
+    live_(0)
+{
+    // every block must be able to hold a free list link
+    if(blockSize_ < sizeof(FreeBlock)){
+        blockSize_ = sizeof(FreeBlock);
+    }
+    if(blockAlign < alignof(FreeBlock)){
+        blockAlign = alignof(FreeBlock);
+    }
+    // round up so that every block in a slab stays aligned
+    blockSize_ = (blockSize_ + blockAlign - 1) / blockAlign * blockAlign;
+}
+
+/**
+* Destructor, which gives every slab back to the heap.
+*/
+inline NodePool::~NodePool()
+{
+    release();
+}
+
+/**
+* Returns storage for one block, reusing a freed block if there is one.
+*/
+inline void* NodePool::allocate()
+{
+    // recycle the most recently freed block first since it is likely still in cache
+    if(freeList_ != NULL){
+        FreeBlock* block = freeList_;
+        freeList_ = block->next;
+        ++live_;
+        return block;
+    }
+    if(bump_ == bumpEnd_){
+        addSlab();
+    }
+    void* block = bump_;
+    bump_ += blockSize_;
+    ++live_;
+    return block;
+}
+
+/**
+* Puts a block that came from allocate() back on the free list.
+*/
+inline void NodePool::deallocate(void* block)
+{
+    if(block == NULL){
+        return;
+    }
+    FreeBlock* freed = static_cast<FreeBlock*>(block);
+    freed->next = freeList_;
+    freeList_ = freed;
+    --live_;
+}
+
+/**
+* Frees every slab at once. Any block still handed out becomes invalid.
+*/
+inline void NodePool::release()
+{
+    for(std::size_t i = 0; i < slabs_.size(); ++i){
+        ::operator delete(slabs_[i]);
+    }
+    slabs_.clear();
+    freeList_ = NULL;
+    bump_ = NULL;
+    bumpEnd_ = NULL;
+    live_ = 0;
+}
+
+/**
+* Returns how much memory the pool holds and how much of it is in use.
+*/
+inline NodePoolStats NodePool::stats() const
+{
+    NodePoolStats result;
+    result.bytesReserved = slabs_.size() * blocksPerSlab_ * blockSize_;
+    result.bytesLive = live_ * blockSize_;
+    result.liveNodes = live_;
+    result.slabs = slabs_.size();
+    return result;
+}
+
+// grabs another slab from the heap and makes it the bump region
+inline void NodePool::addSlab()
+{
+    // operator new only promises 16 bytes, so take a line more and skip ahead
+    char* slab = static_cast<char*>(::operator new(blocksPerSlab_ * blockSize_ + SLAB_ALIGN - 1));
+    slabs_.push_back(slab);
+    std::size_t skip = (SLAB_ALIGN - reinterpret_cast<std::uintptr_t>(slab) % SLAB_ALIGN) % SLAB_ALIGN;
+    bump_ = slab + skip;
+    bumpEnd_ = bump_ + blocksPerSlab_ * blockSize_;
+}
+
+/*
+  -------------------------------------------
+  End implementations for the NodePool class.
+  -------------------------------------------
+*/
+
+#endif
@@ -0,0 +1,108 @@
+#ifndef NODE_RECLAIMER_H
+#define NODE_RECLAIMER_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+/**
+* One background thread that frees trees which have already been detached
+* from their owners, so that clear() and destructors of trees with
+* setBackgroundClear(true) return straight away instead of walking every
+* node.
+*
+* The reclaimer is made on first use and never destroyed: its thread may
+* still be freeing nodes while the program exits, and there is nothing
+* else for it to touch by then. Call drain() to wait until everything
+* handed to it so far is gone, e.g. before measuring memory.
+*/
+class NodeReclaimer
+{
+public:
+    static NodeReclaimer& instance();
+
+    void post(const std::function<void()>& job);
+    void drain();
+
+private:
+    NodeReclaimer();
+    // no copying, there is only the one
+    NodeReclaimer(const NodeReclaimer&);
+    NodeReclaimer& operator=(const NodeReclaimer&);
+
+    void work();
+
+    std::deque<std::function<void()> > jobs_;
+    // true while the thread is running a job it already took off jobs_
+    bool busy_;
+    std::mutex mutex_;
+    // wakes the thread for new jobs, and drain() once there are none
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+};
+
+inline NodeReclaimer::NodeReclaimer()
+    : busy_(false)
+{
+    std::thread(&NodeReclaimer::work, this).detach();
+}
+
+/**
+* Returns the reclaimer, starting its thread the first time.
+*/
+inline NodeReclaimer& NodeReclaimer::instance()
+{
+    // left alive on purpose, see above
+    static NodeReclaimer* reclaimer = new NodeReclaimer();
+    return *reclaimer;
+}
+
+/**
+* Queues a job for the background thread. Jobs run one at a time, in the
+* order they were posted.
+*/
+inline void NodeReclaimer::post(const std::function<void()>& job)
+{
+    {
+        std::lock_guard<std::mutex> guard(mutex_);
+        jobs_.push_back(job);
+    }
+    wake_.notify_one();
+}
+
+/**
+* Waits until every job posted before the call has finished.
+*/
+inline void NodeReclaimer::drain()
+{
+    std::unique_lock<std::mutex> guard(mutex_);
+    while(!jobs_.empty() || busy_){
+        idle_.wait(guard);
+    }
+}
+
+// helper that is the loop the background thread runs
+inline void NodeReclaimer::work()
+{
+    std::unique_lock<std::mutex> guard(mutex_);
+    while(true){
+        while(jobs_.empty()){
+            wake_.wait(guard);
+        }
+        std::function<void()> job;
+        job.swap(jobs_.front());
+        jobs_.pop_front();
+        busy_ = true;
+        guard.unlock();
+        job();
+        guard.lock();
+        busy_ = false;
+        if(jobs_.empty()){
+            idle_.notify_all();
+        }
+    }
+}
+
+#endif
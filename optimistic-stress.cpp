@@ -0,0 +1,141 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <thread>
+#include <cstdlib>
+#include <cstdint>
+#include "concurrent_avl.h"
+#include "optimistic_avl.h"
+
+using namespace std;
+
+// Runs mixed concurrent workloads on the OptimisticAVLTree from 1 up to N
+// threads, then checks it is still a strict AVL tree holding exactly the
+// right items, and compares throughput with the reader-writer locked
+// ConcurrentAVLTree. Writes are split between inserts (which also update)
+// and removes. Each thread only writes keys k with k % threads == its
+// number, so its own std::map says what the tree must end up with, but
+// all threads read the whole key space and share every part of the tree.
+// usage: ./optimistic-stress [maxThreads] [numKeys] [opsPerThread] [writePercent]
+
+typedef chrono::steady_clock Clock;
+
+template<typename Tree>
+void worker(Tree* tree, unsigned id, unsigned threads, uint64_t keySpace, size_t ops,
+            unsigned writePercent, map<uint64_t, uint64_t>* expected, uint64_t* hits)
+{
+    mt19937_64 rng(1000 + id);
+    uint64_t found = 0;
+    for(size_t i = 0; i < ops; ++i) {
+        uint64_t key = rng() % keySpace;
+        unsigned roll = rng() % 200;
+        if(roll < 2 * writePercent) {
+            // move the key into this thread's share
+            key = key - key % threads + id;
+            if(key >= keySpace) continue;
+            if(roll < writePercent) {
+                tree->insert(make_pair(key, key + i));
+                (*expected)[key] = key + i;
+            } else {
+                tree->remove(key);
+                expected->erase(key);
+            }
+        } else {
+            uint64_t value;
+            if(tree->find(key, value)) ++found;
+        }
+    }
+    *hits = found;
+}
+
+// fills the tree with every other key, as the threads' maps start out
+template<typename Tree>
+void prefill(Tree& tree, unsigned threads, size_t n, vector<map<uint64_t, uint64_t> >& expected)
+{
+    for(size_t i = 0; i < n; i += 2) {
+        tree.insert(make_pair((uint64_t)i, (uint64_t)i));
+        expected[i % threads][i] = i;
+    }
+}
+
+template<typename Tree>
+double run(Tree& tree, unsigned threads, size_t n, size_t ops, unsigned writePercent,
+           vector<map<uint64_t, uint64_t> >& expected)
+{
+    vector<thread> pool;
+    vector<uint64_t> hits(threads);
+    Clock::time_point start = Clock::now();
+    for(unsigned t = 0; t < threads; ++t) {
+        pool.push_back(thread(worker<Tree>, &tree, t, threads, (uint64_t)n, ops, writePercent, &expected[t], &hits[t]));
+    }
+    for(unsigned t = 0; t < threads; ++t) pool[t].join();
+    double seconds = chrono::duration<double>(Clock::now() - start).count();
+    return threads * ops / seconds / 1e6;
+}
+
+// checks balance and that the tree holds exactly the expected items
+bool verify(const OptimisticAVLTree<uint64_t, uint64_t>& tree, const vector<map<uint64_t, uint64_t> >& expected, size_t n)
+{
+    if(!tree.isBalanced()) {
+        cout << "tree is not a strict AVL tree" << endl;
+        return false;
+    }
+    size_t total = 0;
+    for(size_t t = 0; t < expected.size(); ++t) total += expected[t].size();
+    if(tree.size() != total) {
+        cout << "tree has " << tree.size() << " keys, expected " << total << endl;
+        return false;
+    }
+    for(uint64_t key = 0; key < n; ++key) {
+        const map<uint64_t, uint64_t>& share = expected[key % expected.size()];
+        map<uint64_t, uint64_t>::const_iterator it = share.find(key);
+        uint64_t value = 0;
+        bool found = tree.find(key, value);
+        if(found != (it != share.end()) || (found && value != it->second)) {
+            cout << "key " << key << " is wrong" << endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    unsigned hw = thread::hardware_concurrency();
+    unsigned maxThreads = argc > 1 ? strtoul(argv[1], NULL, 10) : (hw > 0 ? hw : 4);
+    size_t n = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    size_t ops = argc > 3 ? strtoul(argv[3], NULL, 10) : 1000000;
+    unsigned writePercent = argc > 4 ? strtoul(argv[4], NULL, 10) : 20;
+
+    cout << n / 2 << " keys, " << ops << " ops per thread, " << writePercent << "% writes, "
+         << hw << " hardware threads (Mops/s, speedup over 1 thread)" << endl;
+    cout << left << setw(10) << "threads" << right << setw(14) << "optimistic" << setw(10) << "x"
+         << setw(14) << "rw lock" << setw(10) << "x" << setw(10) << "check" << endl;
+    double optBase = 0, rwBase = 0;
+    bool ok = true;
+    // doubling thread counts, always ending on maxThreads
+    for(unsigned threads = 1; ; threads = threads * 2 < maxThreads ? threads * 2 : maxThreads) {
+        vector<map<uint64_t, uint64_t> > expected(threads);
+        OptimisticAVLTree<uint64_t, uint64_t> opt;
+        prefill(opt, threads, n, expected);
+        double o = run(opt, threads, n, ops, writePercent, expected);
+        bool good = verify(opt, expected, n);
+        ok = ok && good;
+
+        vector<map<uint64_t, uint64_t> > scratch(threads);
+        ConcurrentAVLTree<uint64_t, uint64_t> rw;
+        prefill(rw, threads, n, scratch);
+        double r = run(rw, threads, n, ops, writePercent, scratch);
+
+        if(threads == 1) { optBase = o; rwBase = r; }
+        cout << left << setw(10) << threads << right << fixed << setprecision(2)
+             << setw(14) << o << setw(10) << o / optBase
+             << setw(14) << r << setw(10) << r / rwBase
+             << setw(10) << (good ? "ok" : "FAILED") << endl;
+        if(threads >= maxThreads) break;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,1256 @@
+#ifndef OPTIMISTIC_AVL_H
+#define OPTIMISTIC_AVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* Hands every thread that uses an OptimisticAVLTree a small number, its
+* slot in the trees' epoch tables. Numbers of finished threads are reused.
+*/
+class EpochThreadId
+{
+public:
+    static const unsigned MAX_THREADS = 256;
+
+    static unsigned get();
+    // one more than the largest number handed out so far
+    static unsigned limit();
+
+private:
+    EpochThreadId();
+    ~EpochThreadId();
+
+    static std::mutex& registryMutex();
+    static std::vector<unsigned>& freeIds();
+    static std::atomic<unsigned>& next();
+
+    unsigned id_;
+};
+
+inline unsigned EpochThreadId::get()
+{
+    static thread_local EpochThreadId self;
+    return self.id_;
+}
+
+inline unsigned EpochThreadId::limit()
+{
+    return next().load();
+}
+
+inline EpochThreadId::EpochThreadId()
+{
+    std::lock_guard<std::mutex> guard(registryMutex());
+    if(!freeIds().empty()){
+        id_ = freeIds().back();
+        freeIds().pop_back();
+        return;
+    }
+    if(next().load() >= MAX_THREADS){
+        throw std::runtime_error("too many threads for OptimisticAVLTree");
+    }
+    id_ = next().fetch_add(1);
+}
+
+inline EpochThreadId::~EpochThreadId()
+{
+    std::lock_guard<std::mutex> guard(registryMutex());
+    freeIds().push_back(id_);
+}
+
+inline std::mutex& EpochThreadId::registryMutex()
+{
+    static std::mutex registry;
+    return registry;
+}
+
+inline std::vector<unsigned>& EpochThreadId::freeIds()
+{
+    static std::vector<unsigned> ids;
+    return ids;
+}
+
+inline std::atomic<unsigned>& EpochThreadId::next()
+{
+    static std::atomic<unsigned> counter(0);
+    return counter;
+}
+
+/**
+* A concurrent AVL tree that lets many writers work at once, after
+* "A Practical Concurrent Binary Search Tree" by Bronson, Casper, Chafi and
+* Olukotun (PPoPP 2010).
+*
+* - Lookups take no locks. Every node has a version number that a rotation
+*   marks as shrinking while it moves the node down, and bumps when done.
+*   A search reads a node's version, follows a child, and checks the version
+*   again before trusting that step (hand-over-hand validation); if it
+*   changed, that level of the search is retried.
+* - Writers lock just the nodes they change, always parent before child.
+*   An insert locks the parent it hangs the new node from; a rotation locks
+*   the parent, the node and the child that moves up.
+* - Removing a key with two children only clears its value, leaving a
+*   routing node that still guides searches (like the predecessor swap in
+*   AVLTree::remove, but without moving nodes under other threads).
+*   Routing nodes are unlinked by the rebalancing once they have one child.
+* - Balance is relaxed while threads are running: each writer walks back up
+*   fixing heights and rotating (the concurrent insertfix/removefix), so the
+*   tree is a strict AVL tree again whenever no operation is in flight. The
+*   walk checks every node with its parent locked and comes back to
+*   ancestors it had to leave unbalanced, which the paper's lock-free
+*   height checks could miss.
+*
+* Unlinked nodes and replaced values may still be in use by readers, so
+* they are freed with epoch based reclamation: each operation announces the
+* epoch it started in, and memory retired in epoch e is freed once every
+* thread has been seen in epoch e + 1 or later.
+*
+* size() and isBalanced() walk the tree without any synchronization and are
+* only meant for when no other thread is using it.
+*/
+template <typename Key, typename Value>
+class OptimisticAVLTree
+{
+public:
+    OptimisticAVLTree();
+    ~OptimisticAVLTree();
+
+    bool insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    bool find(const Key& key, Value& value) const;
+    bool contains(const Key& key) const;
+    bool empty() const;
+
+    std::size_t size() const;
+    bool isBalanced() const;
+
+protected:
+    struct OptNode
+    {
+        typename std::aligned_storage<sizeof(Key), alignof(Key)>::type keySlot;
+        // NULL for a routing node
+        std::atomic<const Value*> value;
+        std::atomic<int> height;
+        std::atomic<std::uint64_t> version;
+        std::atomic<OptNode*> parent;
+        std::atomic<OptNode*> left;
+        std::atomic<OptNode*> right;
+        std::atomic<bool> locked;
+
+        const Key& key() const { return *reinterpret_cast<const Key*>(&keySlot); }
+        std::atomic<OptNode*>& child(int dir) { return dir < 0 ? left : right; }
+    };
+
+    // one cache line per thread so announcing an epoch does not bounce
+    struct EpochSlot
+    {
+        std::atomic<std::uint64_t> epoch;
+        char pad[64 - sizeof(std::atomic<std::uint64_t>)];
+    };
+
+    // memory waiting for readers to move on
+    struct Retired
+    {
+        void* ptr;
+        void (*destroy)(void*);
+        std::uint64_t epoch;
+    };
+
+    // marks one operation as running, so nothing it might see is freed
+    class EpochGuard
+    {
+    public:
+        explicit EpochGuard(const OptimisticAVLTree<Key, Value>* tree);
+        ~EpochGuard();
+    private:
+        EpochSlot* slot_;
+    };
+
+    // results of one attempt at an operation
+    enum Outcome { RETRY, ABSENT, PRESENT, INSERTED, UPDATED, REMOVED };
+    // what nodeCondition() found when it is not a new height
+    static const int UNLINK_REQUIRED = -1;
+    static const int REBALANCE_REQUIRED = -2;
+    static const int NOTHING_REQUIRED = -3;
+
+    static const std::uint64_t UNLINKED = 1;
+    static const std::uint64_t SHRINKING = 2;
+    static const std::uint64_t SHRINK_COUNT = 4;
+    static const std::uint64_t QUIESCENT = ~static_cast<std::uint64_t>(0);
+    // retirements between attempts to free memory
+    static const std::size_t RECLAIM_BATCH = 256;
+
+    static int compareKeys(const Key& a, const Key& b);
+    static int height(OptNode* node);
+    static void lockNode(OptNode* node);
+    static void unlockNode(OptNode* node);
+    static void waitUntilNotChanging(OptNode* node);
+    OptNode* newNode(const Key& key, const Value& value, OptNode* parent);
+
+    Outcome attemptGet(const Key& key, OptNode* node, int dir, std::uint64_t nodeV, const Value*& found) const;
+    Outcome attemptPut(const Key& key, const Value& value, OptNode* node, int dir, std::uint64_t nodeV);
+    Outcome attemptInsert(const Key& key, const Value& value, OptNode* node, int dir, std::uint64_t nodeV);
+    Outcome attemptUpdate(OptNode* node, const Value& value);
+    Outcome attemptRemove(const Key& key, OptNode* node, int dir, std::uint64_t nodeV);
+    Outcome attemptRmNode(OptNode* parent, OptNode* node);
+
+    void fixHeightAndRebalance(OptNode* node);
+    static OptNode* heightChange(OptNode* node);
+    static bool isHeightChange(OptNode* node);
+    static OptNode* untagged(OptNode* node);
+    static int nodeCondition(OptNode* node);
+    OptNode* fixHeight_nl(OptNode* node);
+    OptNode* rebalance_nl(OptNode* nParent, OptNode* n);
+    bool attemptUnlink_nl(OptNode* parent, OptNode* n);
+    OptNode* rebalanceToRight_nl(OptNode* nParent, OptNode* n, OptNode* nL, int hR0);
+    OptNode* rebalanceToLeft_nl(OptNode* nParent, OptNode* n, OptNode* nR, int hL0);
+    OptNode* rotateRight_nl(OptNode* nParent, OptNode* n, OptNode* nL, int hR, int hLL, OptNode* nLR, int hLR);
+    OptNode* rotateLeft_nl(OptNode* nParent, OptNode* n, int hL, OptNode* nR, OptNode* nRL, int hRL, int hRR);
+    OptNode* rotateRightOverLeft_nl(OptNode* nParent, OptNode* n, OptNode* nL, int hR, int hLL, OptNode* nLR, int hLRL);
+    OptNode* rotateLeftOverRight_nl(OptNode* nParent, OptNode* n, int hL, OptNode* nR, OptNode* nRL, int hRR, int hRLR);
+
+    void retire(void* ptr, void (*destroy)(void*));
+    void reclaim_nl();
+    static void destroyNode(void* node);
+    static void destroyValue(void* value);
+    void destroyAll(OptNode* node);
+    std::size_t countKeys(OptNode* node) const;
+    bool checkSubtree(OptNode* node, OptNode* parent, const Key* lo, const Key* hi, int& height) const;
+
+    // sentinel whose right child is the root; its version never changes
+    OptNode* rootHolder_;
+    std::atomic<std::uint64_t> epoch_;
+    mutable EpochSlot slots_[EpochThreadId::MAX_THREADS];
+    std::mutex retireMutex_;
+    std::vector<Retired> retired_;
+
+private:
+    // no copying, threads share this very object
+    OptimisticAVLTree(const OptimisticAVLTree&);
+    OptimisticAVLTree& operator=(const OptimisticAVLTree&);
+};
+
+/*
+-----------------------------------------------------------------
+Begin implementations for the OptimisticAVLTree::EpochGuard class.
+-----------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+OptimisticAVLTree<Key, Value>::EpochGuard::EpochGuard(const OptimisticAVLTree<Key, Value>* tree)
+    : slot_(&tree->slots_[EpochThreadId::get()])
+{
+    // a full fence store, so the announcement is visible before any node is read
+    slot_->epoch.store(tree->epoch_.load());
+}
+
+template<class Key, class Value>
+OptimisticAVLTree<Key, Value>::EpochGuard::~EpochGuard()
+{
+    slot_->epoch.store(QUIESCENT, std::memory_order_release);
+}
+
+/*
+---------------------------------------------------------------
+End implementations for the OptimisticAVLTree::EpochGuard class.
+---------------------------------------------------------------
+*/
+
+/**
+* Default constructor, which makes the root holder of an empty tree.
+*/
+template<class Key, class Value>
+OptimisticAVLTree<Key, Value>::OptimisticAVLTree()
+    : epoch_(0)
+{
+    // the holder has no key, searches only ever look at its right child
+    rootHolder_ = new OptNode;
+    rootHolder_->value.store(NULL);
+    rootHolder_->height.store(0);
+    rootHolder_->version.store(0);
+    rootHolder_->parent.store(NULL);
+    rootHolder_->left.store(NULL);
+    rootHolder_->right.store(NULL);
+    rootHolder_->locked.store(false);
+    for(std::size_t i = 0; i < EpochThreadId::MAX_THREADS; ++i){
+        slots_[i].epoch.store(QUIESCENT);
+    }
+}
+
+template<class Key, class Value>
+OptimisticAVLTree<Key, Value>::~OptimisticAVLTree()
+{
+    destroyAll(rootHolder_->right.load());
+    delete rootHolder_;
+    for(std::size_t i = 0; i < retired_.size(); ++i){
+        retired_[i].destroy(retired_[i].ptr);
+    }
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is already there.
+* Returns true if a new key was added.
+*/
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    EpochGuard guard(this);
+    // the holder's version is always 0, so this never comes back as RETRY
+    Outcome result = attemptPut(keyValuePair.first, keyValuePair.second, rootHolder_, 1, 0);
+    return result == INSERTED;
+}
+
+/**
+* Removes the key if it is there.
+*/
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::remove(const Key& key)
+{
+    EpochGuard guard(this);
+    attemptRemove(key, rootHolder_, 1, 0);
+}
+
+/**
+* Copies the value for the key into value and returns true, or returns
+* false if the key is not there. Takes no locks.
+*/
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::find(const Key& key, Value& value) const
+{
+    EpochGuard guard(this);
+    const Value* found = NULL;
+    if(attemptGet(key, rootHolder_, 1, 0, found) != PRESENT){
+        return false;
+    }
+    value = *found;
+    return true;
+}
+
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::contains(const Key& key) const
+{
+    EpochGuard guard(this);
+    const Value* found = NULL;
+    return attemptGet(key, rootHolder_, 1, 0, found) == PRESENT;
+}
+
+/**
+* Returns true if the tree has no nodes. While a remove is still unlinking
+* routing nodes this can briefly say false for a tree with no keys.
+*/
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::empty() const
+{
+    EpochGuard guard(this);
+    return rootHolder_->right.load() == NULL;
+}
+
+/**
+* Returns the number of keys. Only for when no other thread uses the tree.
+*/
+template<class Key, class Value>
+std::size_t OptimisticAVLTree<Key, Value>::size() const
+{
+    return countKeys(rootHolder_->right.load());
+}
+
+/**
+* Checks the tree is a strict AVL tree with correct heights, ordered keys,
+* matching parent pointers and no routing node that could be unlinked.
+* Only for when no other thread uses the tree.
+*/
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::isBalanced() const
+{
+    int h = 0;
+    return checkSubtree(rootHolder_->right.load(), rootHolder_, NULL, NULL, h);
+}
+
+// helper for a three way comparison built on KeyCompare
+template<class Key, class Value>
+int OptimisticAVLTree<Key, Value>::compareKeys(const Key& a, const Key& b)
+{
+    if(KeyCompare<Key>::less(a, b)){
+        return -1;
+    }
+    return KeyCompare<Key>::less(b, a) ? 1 : 0;
+}
+
+// helper that reads the height of a possibly empty subtree
+template<class Key, class Value>
+int OptimisticAVLTree<Key, Value>::height(OptNode* node)
+{
+    return node == NULL ? 0 : node->height.load();
+}
+
+// helper that takes a node's spin lock, yielding if it is held for long
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::lockNode(OptNode* node)
+{
+    int spins = 0;
+    while(node->locked.exchange(true, std::memory_order_acquire)){
+        while(node->locked.load(std::memory_order_relaxed)){
+            if(++spins > 64){
+                std::this_thread::yield();
+            }
+        }
+    }
+}
+
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::unlockNode(OptNode* node)
+{
+    node->locked.store(false, std::memory_order_release);
+}
+
+// helper for a search that met a node in the middle of a rotation; the
+// rotating thread holds the node's lock, so it is done in a moment
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::waitUntilNotChanging(OptNode* node)
+{
+    int spins = 0;
+    while(node->version.load() & SHRINKING){
+        if(++spins > 64){
+            std::this_thread::yield();
+        }
+    }
+}
+
+// helper that makes a leaf node with its own copy of the value
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::newNode(const Key& key, const Value& value, OptNode* parent)
+{
+    OptNode* node = new OptNode;
+    new (&node->keySlot) Key(key);
+    node->value.store(new Value(value));
+    node->height.store(1);
+    node->version.store(0);
+    node->parent.store(parent);
+    node->left.store(NULL);
+    node->right.store(NULL);
+    node->locked.store(false);
+    return node;
+}
+
+// helper for one level of a lookup: node was seen at version nodeV, and the
+// key lies in its dir subtree. Anything that changed node since comes back
+// as RETRY so the level above can look again.
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::Outcome
+OptimisticAVLTree<Key, Value>::attemptGet(const Key& key, OptNode* node, int dir, std::uint64_t nodeV, const Value*& found) const
+{
+    while(true){
+        OptNode* child = node->child(dir).load();
+        if(node->version.load() != nodeV){
+            return RETRY;
+        }
+        if(child == NULL){
+            return ABSENT;
+        }
+
+        int nextD = compareKeys(key, child->key());
+        if(nextD == 0){
+            found = child->value.load();
+            return found != NULL ? PRESENT : ABSENT;
+        }
+
+        std::uint64_t chV = child->version.load();
+        if(chV & SHRINKING){
+            waitUntilNotChanging(child);
+        } else if(chV != UNLINKED && child == node->child(dir).load()){
+            // the child was still ours when its version was read
+            if(node->version.load() != nodeV){
+                return RETRY;
+            }
+            Outcome result = attemptGet(key, child, nextD, chV, found);
+            if(result != RETRY){
+                return result;
+            }
+        }
+    }
+}
+
+// helper for one level of an insert, the same walk as attemptGet
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::Outcome
+OptimisticAVLTree<Key, Value>::attemptPut(const Key& key, const Value& value, OptNode* node, int dir, std::uint64_t nodeV)
+{
+    Outcome result = RETRY;
+    do {
+        OptNode* child = node->child(dir).load();
+        if(node->version.load() != nodeV){
+            return RETRY;
+        }
+        if(child == NULL){
+            result = attemptInsert(key, value, node, dir, nodeV);
+        } else {
+            int nextD = compareKeys(key, child->key());
+            if(nextD == 0){
+                result = attemptUpdate(child, value);
+            } else {
+                std::uint64_t chV = child->version.load();
+                if(chV & SHRINKING){
+                    waitUntilNotChanging(child);
+                } else if(chV != UNLINKED && child == node->child(dir).load()){
+                    if(node->version.load() != nodeV){
+                        return RETRY;
+                    }
+                    result = attemptPut(key, value, child, nextD, chV);
+                }
+            }
+        }
+    } while(result == RETRY);
+    return result;
+}
+
+// helper that hangs a new leaf off node, if node has not changed
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::Outcome
+OptimisticAVLTree<Key, Value>::attemptInsert(const Key& key, const Value& value, OptNode* node, int dir, std::uint64_t nodeV)
+{
+    lockNode(node);
+    if(node->version.load() != nodeV || node->child(dir).load() != NULL){
+        unlockNode(node);
+        return RETRY;
+    }
+    node->child(dir).store(newNode(key, value, node));
+    unlockNode(node);
+
+    fixHeightAndRebalance(node);
+    return INSERTED;
+}
+
+// helper that swaps in a new value, which also brings a routing node back
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::Outcome
+OptimisticAVLTree<Key, Value>::attemptUpdate(OptNode* node, const Value& value)
+{
+    const Value* fresh = new Value(value);
+    lockNode(node);
+    if(node->version.load() == UNLINKED){
+        unlockNode(node);
+        delete fresh;
+        return RETRY;
+    }
+    const Value* old = node->value.exchange(fresh);
+    unlockNode(node);
+
+    if(old == NULL){
+        return INSERTED;
+    }
+    retire(const_cast<Value*>(old), &destroyValue);
+    return UPDATED;
+}
+
+// helper for one level of a remove, the same walk as attemptGet
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::Outcome
+OptimisticAVLTree<Key, Value>::attemptRemove(const Key& key, OptNode* node, int dir, std::uint64_t nodeV)
+{
+    Outcome result = RETRY;
+    do {
+        OptNode* child = node->child(dir).load();
+        if(node->version.load() != nodeV){
+            return RETRY;
+        }
+        if(child == NULL){
+            return ABSENT;
+        }
+        int nextD = compareKeys(key, child->key());
+        if(nextD == 0){
+            result = attemptRmNode(node, child);
+        } else {
+            std::uint64_t chV = child->version.load();
+            if(chV & SHRINKING){
+                waitUntilNotChanging(child);
+            } else if(chV != UNLINKED && child == node->child(dir).load()){
+                if(node->version.load() != nodeV){
+                    return RETRY;
+                }
+                result = attemptRemove(key, child, nextD, chV);
+            }
+        }
+    } while(result == RETRY);
+    return result;
+}
+
+// helper that removes the key held by node: a node with two children just
+// becomes a routing node, anything else is spliced out of the tree
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::Outcome
+OptimisticAVLTree<Key, Value>::attemptRmNode(OptNode* parent, OptNode* node)
+{
+    if(node->value.load() == NULL){
+        return ABSENT;
+    }
+
+    const Value* prev = NULL;
+    if(node->left.load() != NULL && node->right.load() != NULL){
+        lockNode(node);
+        if(node->version.load() == UNLINKED || node->left.load() == NULL || node->right.load() == NULL){
+            unlockNode(node);
+            return RETRY;
+        }
+        prev = node->value.exchange(NULL);
+        unlockNode(node);
+        if(prev == NULL){
+            return ABSENT;
+        }
+        retire(const_cast<Value*>(prev), &destroyValue);
+        return REMOVED;
+    }
+
+    lockNode(parent);
+    if(parent->version.load() == UNLINKED || node->parent.load() != parent){
+        unlockNode(parent);
+        return RETRY;
+    }
+    lockNode(node);
+    prev = node->value.exchange(NULL);
+    if(prev == NULL){
+        unlockNode(node);
+        unlockNode(parent);
+        return ABSENT;
+    }
+    // a routing node is unlinked by the rebalancing once it has a free side
+    bool unlinked = attemptUnlink_nl(parent, node);
+    unlockNode(node);
+    unlockNode(parent);
+
+    retire(const_cast<Value*>(prev), &destroyValue);
+    fixHeightAndRebalance(unlinked ? parent : node);
+    return REMOVED;
+}
+
+// the concurrent counterpart of insertfix/removefix: walks up from node
+// fixing heights and rotating until nothing more is needed. Every step
+// looks at a node with it and its parent locked. A node only changes height
+// while it is locked, and only changes parent while its old parent is
+// locked, so after a height change the walk checks the changed node's
+// parent as it is now (a rotation may have moved it meanwhile), and a
+// "nothing to do" can never rest on a height someone is about to change.
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::fixHeightAndRebalance(OptNode* node)
+{
+    // ancestors left unbalanced while a child was fixed first
+    std::vector<OptNode*> pending;
+    while(node != NULL || !pending.empty()){
+        if(node == NULL){
+            node = pending.back();
+            pending.pop_back();
+        }
+        OptNode* changed = NULL;
+        if(isHeightChange(node)){
+            changed = untagged(node);
+            if(changed->version.load() == UNLINKED){
+                // whoever unlinked it looks after its parent
+                node = NULL;
+                continue;
+            }
+            node = changed->parent.load();
+        }
+        if(node == rootHolder_){
+            node = NULL;
+            continue;
+        }
+
+        OptNode* nParent = node->parent.load();
+        lockNode(nParent);
+        if(nParent->version.load() == UNLINKED || node->parent.load() != nParent){
+            // moved under us, look again
+            unlockNode(nParent);
+            if(changed != NULL){
+                node = heightChange(changed);
+            } else if(node->version.load() == UNLINKED){
+                node = NULL;
+            }
+            continue;
+        }
+        lockNode(node);
+        OptNode* next = NULL;
+        if(changed != NULL && changed->parent.load() != node){
+            next = heightChange(changed);
+        } else if(node->version.load() != UNLINKED){
+            next = rebalance_nl(nParent, node);
+            if(next != NULL && !isHeightChange(next)){
+                // a rotation that hands back a node to fix has not looked
+                // at nParent's height yet
+                if(nParent != rootHolder_ && (pending.empty() || pending.back() != nParent)){
+                    pending.push_back(nParent);
+                }
+                if(next != node && nodeCondition(node) == REBALANCE_REQUIRED){
+                    pending.push_back(node);
+                }
+            }
+        }
+        unlockNode(node);
+        unlockNode(nParent);
+        node = next;
+    }
+}
+
+// helpers that mark a node pointer returned from the rebalancing as "this
+// node's height changed, look at its parent next", in the low pointer bit
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::heightChange(OptNode* node)
+{
+    return reinterpret_cast<OptNode*>(reinterpret_cast<std::uintptr_t>(node) | 1);
+}
+
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::isHeightChange(OptNode* node)
+{
+    return (reinterpret_cast<std::uintptr_t>(node) & 1) != 0;
+}
+
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::untagged(OptNode* node)
+{
+    return reinterpret_cast<OptNode*>(reinterpret_cast<std::uintptr_t>(node) & ~static_cast<std::uintptr_t>(1));
+}
+
+// helper that says what a node needs: unlinking (a routing node with a
+// free side), a rotation, a new height, or nothing
+template<class Key, class Value>
+int OptimisticAVLTree<Key, Value>::nodeCondition(OptNode* node)
+{
+    OptNode* nL = node->left.load();
+    OptNode* nR = node->right.load();
+    if((nL == NULL || nR == NULL) && node->value.load() == NULL){
+        return UNLINK_REQUIRED;
+    }
+
+    int hN = node->height.load();
+    int hL0 = height(nL);
+    int hR0 = height(nR);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int bal = hL0 - hR0;
+    if(bal < -1 || bal > 1){
+        return REBALANCE_REQUIRED;
+    }
+    return hN != hNRepl ? hNRepl : NOTHING_REQUIRED;
+}
+
+// helper, with node locked, that fixes its height. Returns what to look at
+// next: node marked as a height change, node itself if it needs more than
+// a height, or NULL when done.
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::fixHeight_nl(OptNode* node)
+{
+    int condition = nodeCondition(node);
+    if(condition == REBALANCE_REQUIRED || condition == UNLINK_REQUIRED){
+        return node;
+    }
+    if(condition == NOTHING_REQUIRED){
+        return NULL;
+    }
+    node->height.store(condition);
+    return heightChange(node);
+}
+
+// helper, with nParent and n locked, that unlinks or rotates n as needed
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::rebalance_nl(OptNode* nParent, OptNode* n)
+{
+    OptNode* nL = n->left.load();
+    OptNode* nR = n->right.load();
+    if((nL == NULL || nR == NULL) && n->value.load() == NULL){
+        if(attemptUnlink_nl(nParent, n)){
+            return fixHeight_nl(nParent);
+        }
+        return n;
+    }
+
+    int hN = n->height.load();
+    int hL0 = height(nL);
+    int hR0 = height(nR);
+    int hNRepl = 1 + std::max(hL0, hR0);
+    int bal = hL0 - hR0;
+    if(bal > 1){
+        return rebalanceToRight_nl(nParent, n, nL, hR0);
+    } else if(bal < -1){
+        return rebalanceToLeft_nl(nParent, n, nR, hL0);
+    } else if(hNRepl != hN){
+        n->height.store(hNRepl);
+        return fixHeight_nl(nParent);
+    }
+    return NULL;
+}
+
+// helper, with parent and n locked, that splices out a routing node with a
+// free side. The node is retired since searches may still be on it.
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::attemptUnlink_nl(OptNode* parent, OptNode* n)
+{
+    OptNode* parentL = parent->left.load();
+    OptNode* parentR = parent->right.load();
+    if(parentL != n && parentR != n){
+        return false;
+    }
+    OptNode* nL = n->left.load();
+    OptNode* nR = n->right.load();
+    if(nL != NULL && nR != NULL){
+        return false;
+    }
+
+    OptNode* splice = nL != NULL ? nL : nR;
+    if(parentL == n){
+        parent->left.store(splice);
+    } else {
+        parent->right.store(splice);
+    }
+    if(splice != NULL){
+        splice->parent.store(parent);
+    }
+    n->version.store(UNLINKED);
+    retire(n, &destroyNode);
+    return true;
+}
+
+// helper for a node whose left side is too tall: a single right rotation,
+// a double rotation, or a left rotation of the child first when the
+// double rotation would leave the child unbalanced
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::rebalanceToRight_nl(OptNode* nParent, OptNode* n, OptNode* nL, int hR0)
+{
+    lockNode(nL);
+    int hL = nL->height.load();
+    if(hL - hR0 <= 1){
+        // changed since we looked, start over at n
+        unlockNode(nL);
+        return n;
+    }
+
+    OptNode* nLR = nL->right.load();
+    int hLL0 = height(nL->left.load());
+    int hLR0 = height(nLR);
+    if(hLL0 >= hLR0){
+        OptNode* next = rotateRight_nl(nParent, n, nL, hR0, hLL0, nLR, hLR0);
+        unlockNode(nL);
+        return next;
+    }
+
+    lockNode(nLR);
+    int hLR = nLR->height.load();
+    if(hLL0 >= hLR){
+        OptNode* next = rotateRight_nl(nParent, n, nL, hR0, hLL0, nLR, hLR);
+        unlockNode(nLR);
+        unlockNode(nL);
+        return next;
+    }
+    int hLRL = height(nLR->left.load());
+    int b = hLL0 - hLRL;
+    if(b >= -1 && b <= 1 && !((hLL0 == 0 || hLRL == 0) && nL->value.load() == NULL)){
+        OptNode* next = rotateRightOverLeft_nl(nParent, n, nL, hR0, hLL0, nLR, hLRL);
+        unlockNode(nLR);
+        unlockNode(nL);
+        return next;
+    }
+    if(hLRL == 0 && hLL0 != 0 && nL->value.load() == NULL){
+        // the double rotation would leave nL a routing node with one child,
+        // so rotate nL left and unlink it on the spot instead
+        rotateLeft_nl(n, nL, hLL0, nLR, NULL, 0, height(nLR->right.load()));
+        attemptUnlink_nl(nLR, nL);
+        OptNode* next = fixHeight_nl(nLR);
+        unlockNode(nLR);
+        unlockNode(nL);
+        return next != NULL ? next : n;
+    }
+    unlockNode(nLR);
+
+    // the double rotation would unbalance nL, so fix nL first; the caller
+    // comes back to n afterwards
+    OptNode* next = rebalanceToLeft_nl(n, nL, nLR, hLL0);
+    unlockNode(nL);
+    return next;
+}
+
+// helper for a node whose right side is too tall, the mirror image of the above
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::rebalanceToLeft_nl(OptNode* nParent, OptNode* n, OptNode* nR, int hL0)
+{
+    lockNode(nR);
+    int hR = nR->height.load();
+    if(hL0 - hR >= -1){
+        unlockNode(nR);
+        return n;
+    }
+
+    OptNode* nRL = nR->left.load();
+    int hRL0 = height(nRL);
+    int hRR0 = height(nR->right.load());
+    if(hRR0 >= hRL0){
+        OptNode* next = rotateLeft_nl(nParent, n, hL0, nR, nRL, hRL0, hRR0);
+        unlockNode(nR);
+        return next;
+    }
+
+    lockNode(nRL);
+    int hRL = nRL->height.load();
+    if(hRR0 >= hRL){
+        OptNode* next = rotateLeft_nl(nParent, n, hL0, nR, nRL, hRL, hRR0);
+        unlockNode(nRL);
+        unlockNode(nR);
+        return next;
+    }
+    int hRLR = height(nRL->right.load());
+    int b = hRR0 - hRLR;
+    if(b >= -1 && b <= 1 && !((hRR0 == 0 || hRLR == 0) && nR->value.load() == NULL)){
+        OptNode* next = rotateLeftOverRight_nl(nParent, n, hL0, nR, nRL, hRR0, hRLR);
+        unlockNode(nRL);
+        unlockNode(nR);
+        return next;
+    }
+    if(hRLR == 0 && hRR0 != 0 && nR->value.load() == NULL){
+        rotateRight_nl(n, nR, nRL, hRR0, height(nRL->left.load()), NULL, 0);
+        attemptUnlink_nl(nRL, nR);
+        OptNode* next = fixHeight_nl(nRL);
+        unlockNode(nRL);
+        unlockNode(nR);
+        return next != NULL ? next : n;
+    }
+    unlockNode(nRL);
+
+    OptNode* next = rebalanceToRight_nl(n, nR, nRL, hRR0);
+    unlockNode(nR);
+    return next;
+}
+
+// helper for rotating right, with nParent, n and nL locked. n moves down so
+// it is marked as shrinking while its links change. Returns the next node
+// that may need work.
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::rotateRight_nl(OptNode* nParent, OptNode* n, OptNode* nL, int hR, int hLL, OptNode* nLR, int hLR)
+{
+    std::uint64_t nodeOVL = n->version.load();
+    OptNode* nPL = nParent->left.load();
+    n->version.store(nodeOVL | SHRINKING);
+
+    n->left.store(nLR);
+    if(nLR != NULL){
+        nLR->parent.store(n);
+    }
+    nL->right.store(n);
+    n->parent.store(nL);
+    if(nPL == n){
+        nParent->left.store(nL);
+    } else {
+        nParent->right.store(nL);
+    }
+    nL->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hLR, hR);
+    n->height.store(hNRepl);
+    nL->height.store(1 + std::max(hLL, hNRepl));
+
+    n->version.store(nodeOVL + SHRINK_COUNT);
+
+    // see if n or nL need more, otherwise carry on with the parent's height
+    int balN = hLR - hR;
+    if(balN < -1 || balN > 1){
+        return n;
+    }
+    if((nLR == NULL || hR == 0) && n->value.load() == NULL){
+        return n;
+    }
+    int balL = hLL - hNRepl;
+    if(balL < -1 || balL > 1){
+        return nL;
+    }
+    if(hLL == 0 && nL->value.load() == NULL){
+        return nL;
+    }
+    return fixHeight_nl(nParent);
+}
+
+// helper for rotating left, the mirror image of rotateRight_nl
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::rotateLeft_nl(OptNode* nParent, OptNode* n, int hL, OptNode* nR, OptNode* nRL, int hRL, int hRR)
+{
+    std::uint64_t nodeOVL = n->version.load();
+    OptNode* nPL = nParent->left.load();
+    n->version.store(nodeOVL | SHRINKING);
+
+    n->right.store(nRL);
+    if(nRL != NULL){
+        nRL->parent.store(n);
+    }
+    nR->left.store(n);
+    n->parent.store(nR);
+    if(nPL == n){
+        nParent->left.store(nR);
+    } else {
+        nParent->right.store(nR);
+    }
+    nR->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hL, hRL);
+    n->height.store(hNRepl);
+    nR->height.store(1 + std::max(hNRepl, hRR));
+
+    n->version.store(nodeOVL + SHRINK_COUNT);
+
+    int balN = hRL - hL;
+    if(balN < -1 || balN > 1){
+        return n;
+    }
+    if((nRL == NULL || hL == 0) && n->value.load() == NULL){
+        return n;
+    }
+    int balR = hRR - hNRepl;
+    if(balR < -1 || balR > 1){
+        return nR;
+    }
+    if(hRR == 0 && nR->value.load() == NULL){
+        return nR;
+    }
+    return fixHeight_nl(nParent);
+}
+
+// helper for the double rotation (nL left, then n right) done in one step,
+// with nParent, n, nL and nLR locked. n and nL both move down.
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::rotateRightOverLeft_nl(OptNode* nParent, OptNode* n, OptNode* nL, int hR, int hLL, OptNode* nLR, int hLRL)
+{
+    std::uint64_t nodeOVL = n->version.load();
+    std::uint64_t leftOVL = nL->version.load();
+    OptNode* nPL = nParent->left.load();
+    OptNode* nLRL = nLR->left.load();
+    OptNode* nLRR = nLR->right.load();
+    int hLRR = height(nLRR);
+
+    n->version.store(nodeOVL | SHRINKING);
+    nL->version.store(leftOVL | SHRINKING);
+
+    n->left.store(nLRR);
+    if(nLRR != NULL){
+        nLRR->parent.store(n);
+    }
+    nL->right.store(nLRL);
+    if(nLRL != NULL){
+        nLRL->parent.store(nL);
+    }
+    nLR->left.store(nL);
+    nL->parent.store(nLR);
+    nLR->right.store(n);
+    n->parent.store(nLR);
+    if(nPL == n){
+        nParent->left.store(nLR);
+    } else {
+        nParent->right.store(nLR);
+    }
+    nLR->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hLRR, hR);
+    n->height.store(hNRepl);
+    int hLRepl = 1 + std::max(hLL, hLRL);
+    nL->height.store(hLRepl);
+    nLR->height.store(1 + std::max(hLRepl, hNRepl));
+
+    n->version.store(nodeOVL + SHRINK_COUNT);
+    nL->version.store(leftOVL + SHRINK_COUNT);
+
+    int balN = hLRR - hR;
+    if(balN < -1 || balN > 1){
+        return n;
+    }
+    if((nLRR == NULL || hR == 0) && n->value.load() == NULL){
+        return n;
+    }
+    int balLR = hLRepl - hNRepl;
+    if(balLR < -1 || balLR > 1){
+        return nLR;
+    }
+    return fixHeight_nl(nParent);
+}
+
+// helper for the double rotation the other way, the mirror image of the above
+template<class Key, class Value>
+typename OptimisticAVLTree<Key, Value>::OptNode*
+OptimisticAVLTree<Key, Value>::rotateLeftOverRight_nl(OptNode* nParent, OptNode* n, int hL, OptNode* nR, OptNode* nRL, int hRR, int hRLR)
+{
+    std::uint64_t nodeOVL = n->version.load();
+    std::uint64_t rightOVL = nR->version.load();
+    OptNode* nPL = nParent->left.load();
+    OptNode* nRLL = nRL->left.load();
+    OptNode* nRLR = nRL->right.load();
+    int hRLL = height(nRLL);
+
+    n->version.store(nodeOVL | SHRINKING);
+    nR->version.store(rightOVL | SHRINKING);
+
+    n->right.store(nRLL);
+    if(nRLL != NULL){
+        nRLL->parent.store(n);
+    }
+    nR->left.store(nRLR);
+    if(nRLR != NULL){
+        nRLR->parent.store(nR);
+    }
+    nRL->right.store(nR);
+    nR->parent.store(nRL);
+    nRL->left.store(n);
+    n->parent.store(nRL);
+    if(nPL == n){
+        nParent->left.store(nRL);
+    } else {
+        nParent->right.store(nRL);
+    }
+    nRL->parent.store(nParent);
+
+    int hNRepl = 1 + std::max(hL, hRLL);
+    n->height.store(hNRepl);
+    int hRRepl = 1 + std::max(hRLR, hRR);
+    nR->height.store(hRRepl);
+    nRL->height.store(1 + std::max(hNRepl, hRRepl));
+
+    n->version.store(nodeOVL + SHRINK_COUNT);
+    nR->version.store(rightOVL + SHRINK_COUNT);
+
+    int balN = hRLL - hL;
+    if(balN < -1 || balN > 1){
+        return n;
+    }
+    if((nRLL == NULL || hL == 0) && n->value.load() == NULL){
+        return n;
+    }
+    int balRL = hRRepl - hNRepl;
+    if(balRL < -1 || balRL > 1){
+        return nRL;
+    }
+    return fixHeight_nl(nParent);
+}
+
+// helper that hands memory to the reclaimer, tagged with the current epoch
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::retire(void* ptr, void (*destroy)(void*))
+{
+    std::lock_guard<std::mutex> guard(retireMutex_);
+    Retired item = {ptr, destroy, epoch_.load()};
+    retired_.push_back(item);
+    if(retired_.size() % RECLAIM_BATCH == 0){
+        reclaim_nl();
+    }
+}
+
+// helper, with retireMutex_ held, that moves the epoch on if every running
+// operation has seen the current one, then frees what no one can still see
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::reclaim_nl()
+{
+    std::uint64_t epoch = epoch_.load();
+    bool advance = true;
+    unsigned threads = EpochThreadId::limit();
+    for(unsigned i = 0; i < threads && advance; ++i){
+        std::uint64_t seen = slots_[i].epoch.load();
+        if(seen != QUIESCENT && seen != epoch){
+            advance = false;
+        }
+    }
+    if(advance){
+        epoch_.store(++epoch);
+    }
+
+    // anything retired two epochs back was unlinked before every running
+    // operation started
+    std::size_t kept = 0;
+    for(std::size_t i = 0; i < retired_.size(); ++i){
+        if(retired_[i].epoch + 2 <= epoch){
+            retired_[i].destroy(retired_[i].ptr);
+        } else {
+            retired_[kept++] = retired_[i];
+        }
+    }
+    retired_.resize(kept);
+}
+
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::destroyNode(void* node)
+{
+    OptNode* n = static_cast<OptNode*>(node);
+    reinterpret_cast<Key*>(&n->keySlot)->~Key();
+    delete n;
+}
+
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::destroyValue(void* value)
+{
+    delete static_cast<Value*>(value);
+}
+
+// helper for the destructor that frees a subtree and its values
+template<class Key, class Value>
+void OptimisticAVLTree<Key, Value>::destroyAll(OptNode* node)
+{
+    if(node == NULL){
+        return;
+    }
+    destroyAll(node->left.load());
+    destroyAll(node->right.load());
+    delete node->value.load();
+    destroyNode(node);
+}
+
+// helper that counts the keys in a subtree, skipping routing nodes
+template<class Key, class Value>
+std::size_t OptimisticAVLTree<Key, Value>::countKeys(OptNode* node) const
+{
+    if(node == NULL){
+        return 0;
+    }
+    std::size_t self = node->value.load() != NULL ? 1 : 0;
+    return self + countKeys(node->left.load()) + countKeys(node->right.load());
+}
+
+// helper for isBalanced that checks a subtree and works out its height
+template<class Key, class Value>
+bool OptimisticAVLTree<Key, Value>::checkSubtree(OptNode* node, OptNode* parent, const Key* lo, const Key* hi, int& height) const
+{
+    if(node == NULL){
+        height = 0;
+        return true;
+    }
+    if(node->parent.load() != parent || node->version.load() == UNLINKED || (node->version.load() & SHRINKING)){
+        return false;
+    }
+    if((lo != NULL && !KeyCompare<Key>::less(*lo, node->key())) ||
+       (hi != NULL && !KeyCompare<Key>::less(node->key(), *hi))){
+        return false;
+    }
+    OptNode* nL = node->left.load();
+    OptNode* nR = node->right.load();
+    if(node->value.load() == NULL && (nL == NULL || nR == NULL)){
+        return false;
+    }
+
+    int hL = 0;
+    int hR = 0;
+    if(!checkSubtree(nL, node, lo, &node->key(), hL) || !checkSubtree(nR, node, &node->key(), hi, hR)){
+        return false;
+    }
+    height = 1 + std::max(hL, hR);
+    return height == node->height.load() && hL - hR >= -1 && hL - hR <= 1;
+}
+
+#endif
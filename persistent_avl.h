@@ -0,0 +1,658 @@
+#ifndef PERSISTENT_AVL_H
+#define PERSISTENT_AVL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "bst.h"
+
+/**
+* An AVL tree with O(1) snapshots. snapshot() (or just copying the tree)
+* hands back a second tree that shares every node with the first; after
+* that an insert or remove on either one copies only the nodes on its
+* root-to-leaf path and keeps sharing the rest, so each tree goes on seeing
+* exactly the items it had. Nobody else's nodes are ever changed in place.
+*
+* A node can be shared by several trees, so it has no parent pointer (and
+* there is no nodeSwap; remove moves the successor node itself into place).
+* Instead each node counts the trees and nodes pointing at it, and is freed
+* when the last of them lets go. A node only one pointer leads to belongs to
+* the tree being written alone, so while no snapshot is alive nothing gets
+* copied and writes cost about what they do in AVLTree.
+*
+* Snapshots are the way to hand a consistent view to another thread: take
+* the snapshot on the thread that writes the tree (or under whatever lock
+* the writes hold), after which the snapshot can be read, iterated, or
+* dropped on any thread while writes to the original carry on.
+* Iterators keep a stack of the nodes above them instead of climbing parent
+* pointers, and stay valid until their own tree is next written to.
+*/
+template <typename Key, typename Value>
+class PersistentAVLTree
+{
+protected:
+    struct PNode;
+
+public:
+    /**
+    * A forward iterator over the items in key order.
+    */
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef std::pair<const Key, Value> value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const value_type* pointer;
+        typedef const value_type& reference;
+
+        const_iterator();
+
+        reference operator*() const;
+        pointer operator->() const;
+
+        bool operator==(const const_iterator& rhs) const;
+        bool operator!=(const const_iterator& rhs) const;
+
+        const_iterator& operator++();
+        const_iterator operator++(int);
+
+    protected:
+        friend class PersistentAVLTree<Key, Value>;
+        void pushLeftSpine(const PNode* node);
+        // the current node on top, under it every ancestor still to visit
+        std::vector<const PNode*> stack_;
+    };
+
+    PersistentAVLTree();
+    template<typename ForwardIt>
+    PersistentAVLTree(ForwardIt first, ForwardIt last);
+    PersistentAVLTree(const PersistentAVLTree<Key, Value>& other);
+    PersistentAVLTree(PersistentAVLTree<Key, Value>&& other);
+    PersistentAVLTree<Key, Value>& operator=(const PersistentAVLTree<Key, Value>& other);
+    PersistentAVLTree<Key, Value>& operator=(PersistentAVLTree<Key, Value>&& other);
+    ~PersistentAVLTree();
+
+    PersistentAVLTree<Key, Value> snapshot() const;
+
+    bool insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    void clear();
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    const_iterator find(const Key& key) const;
+    const_iterator lower_bound(const Key& key) const;
+    Value const & operator[](const Key& key) const;
+    std::size_t size() const;
+    bool empty() const;
+    bool isBalanced() const;
+
+protected:
+    struct PNode
+    {
+        PNode(const std::pair<const Key, Value>& keyValuePair);
+        PNode(const PNode& other);
+
+        std::pair<const Key, Value> item;
+        PNode* left;
+        PNode* right;
+        int height;
+        // trees and nodes pointing here
+        std::atomic<unsigned> refs;
+    };
+
+    static int height(const PNode* node);
+    static void fixHeight(PNode* node);
+    static PNode* retain(PNode* node);
+    static void release(PNode* node);
+    static PNode* own(PNode* node);
+    static PNode* rotateLeft(PNode* node);
+    static PNode* rotateRight(PNode* node);
+    static PNode* rebalance(PNode* node);
+    static PNode* insertAt(PNode* node, const std::pair<const Key, Value>& keyValuePair, bool& added);
+    static PNode* removeAt(PNode* node, const Key& key);
+    static PNode* removeMin(PNode* node, PNode*& min);
+    template<typename ForwardIt>
+    static PNode* buildSorted(ForwardIt& next, std::size_t count);
+    static bool checkSubtree(const PNode* node, const Key* lo, const Key* hi, int& height);
+
+    PNode* root_;
+    std::size_t size_;
+};
+
+/*
+--------------------------------------------------------------------
+Begin implementations for the PersistentAVLTree::const_iterator class.
+--------------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::const_iterator::const_iterator()
+{
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>&
+PersistentAVLTree<Key, Value>::const_iterator::operator*() const
+{
+    return stack_.back()->item;
+}
+
+template<class Key, class Value>
+const std::pair<const Key, Value>*
+PersistentAVLTree<Key, Value>::const_iterator::operator->() const
+{
+    return &stack_.back()->item;
+}
+
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::const_iterator::operator==(const const_iterator& rhs) const
+{
+    if(stack_.empty() || rhs.stack_.empty()){
+        return stack_.empty() == rhs.stack_.empty();
+    }
+    return stack_.back() == rhs.stack_.back();
+}
+
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::const_iterator::operator!=(const const_iterator& rhs) const
+{
+    return !(*this == rhs);
+}
+
+/**
+* Moves to the next key: the leftmost node of the right subtree if there is
+* one, otherwise the nearest ancestor still on the stack.
+*/
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::const_iterator&
+PersistentAVLTree<Key, Value>::const_iterator::operator++()
+{
+    const PNode* curr = stack_.back();
+    stack_.pop_back();
+    pushLeftSpine(curr->right);
+    return *this;
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::const_iterator
+PersistentAVLTree<Key, Value>::const_iterator::operator++(int)
+{
+    const_iterator before(*this);
+    ++(*this);
+    return before;
+}
+
+// helper that stacks node and its chain of left children
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::const_iterator::pushLeftSpine(const PNode* node)
+{
+    while(node != NULL){
+        stack_.push_back(node);
+        node = node->left;
+    }
+}
+
+/*
+------------------------------------------------------------------
+End implementations for the PersistentAVLTree::const_iterator class.
+------------------------------------------------------------------
+*/
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::PNode::PNode(const std::pair<const Key, Value>& keyValuePair)
+    : item(keyValuePair), left(NULL), right(NULL), height(1), refs(1)
+{
+}
+
+/**
+* Copies a shared node so it can be changed, taking a reference on each
+* child since both copies now point at them.
+*/
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::PNode::PNode(const PNode& other)
+    : item(other.item), left(retain(other.left)), right(retain(other.right)),
+      height(other.height), refs(1)
+{
+}
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree()
+    : root_(NULL), size_(0)
+{
+}
+
+/**
+* Builds a tree from a range of items. A range already sorted by unique key
+* is built in linear time, anything else is inserted one item at a time
+* (so a repeated key keeps its last value).
+*/
+template<class Key, class Value>
+template<typename ForwardIt>
+PersistentAVLTree<Key, Value>::PersistentAVLTree(ForwardIt first, ForwardIt last)
+    : root_(NULL), size_(0)
+{
+    std::size_t count = 0;
+    bool sorted = true;
+    for(ForwardIt it = first, prev = first; it != last; ++it, ++count){
+        if(count > 0 && !KeyCompare<Key>::less(prev->first, it->first)){
+            sorted = false;
+            break;
+        }
+        prev = it;
+    }
+
+    if(sorted){
+        ForwardIt next = first;
+        root_ = buildSorted(next, count);
+        size_ = count;
+        return;
+    }
+    for(; first != last; ++first){
+        insert(*first);
+    }
+}
+
+/**
+* Shares every node of other, O(1).
+*/
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree(const PersistentAVLTree<Key, Value>& other)
+    : root_(retain(other.root_)), size_(other.size_)
+{
+}
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::PersistentAVLTree(PersistentAVLTree<Key, Value>&& other)
+    : root_(other.root_), size_(other.size_)
+{
+    other.root_ = NULL;
+    other.size_ = 0;
+}
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>&
+PersistentAVLTree<Key, Value>::operator=(const PersistentAVLTree<Key, Value>& other)
+{
+    // retain first so assigning a tree to itself keeps its nodes
+    PNode* root = retain(other.root_);
+    release(root_);
+    root_ = root;
+    size_ = other.size_;
+    return *this;
+}
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>&
+PersistentAVLTree<Key, Value>::operator=(PersistentAVLTree<Key, Value>&& other)
+{
+    if(this != &other){
+        release(root_);
+        root_ = other.root_;
+        size_ = other.size_;
+        other.root_ = NULL;
+        other.size_ = 0;
+    }
+    return *this;
+}
+
+template<class Key, class Value>
+PersistentAVLTree<Key, Value>::~PersistentAVLTree()
+{
+    release(root_);
+}
+
+/**
+* Returns a tree holding the current items, sharing all nodes with this one.
+*/
+template<class Key, class Value>
+PersistentAVLTree<Key, Value> PersistentAVLTree<Key, Value>::snapshot() const
+{
+    return PersistentAVLTree<Key, Value>(*this);
+}
+
+/**
+* Inserts the item, or overwrites the value if the key is already there.
+* Returns true if a new key was added. Copies the nodes on the path that
+* are shared with another tree.
+*/
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    bool added = false;
+    root_ = insertAt(root_, keyValuePair, added);
+    if(added){
+        ++size_;
+    }
+    return added;
+}
+
+/**
+* Removes the key if it is there. A missing key copies nothing.
+*/
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::remove(const Key& key)
+{
+    if(find(key) == end()){
+        return;
+    }
+    root_ = removeAt(root_, key);
+    --size_;
+}
+
+/**
+* Drops this tree's nodes; ones a snapshot still uses stay alive for it.
+*/
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::clear()
+{
+    release(root_);
+    root_ = NULL;
+    size_ = 0;
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::const_iterator
+PersistentAVLTree<Key, Value>::begin() const
+{
+    const_iterator it;
+    it.pushLeftSpine(root_);
+    return it;
+}
+
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::const_iterator
+PersistentAVLTree<Key, Value>::end() const
+{
+    return const_iterator();
+}
+
+/**
+* Returns an iterator to the key, or end(). The descent keeps every node it
+* turned left at, so the iterator can carry on from there.
+*/
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::const_iterator
+PersistentAVLTree<Key, Value>::find(const Key& key) const
+{
+    const_iterator it = lower_bound(key);
+    if(it != end() && KeyCompare<Key>::less(key, it->first)){
+        return end();
+    }
+    return it;
+}
+
+/**
+* Returns an iterator to the first key that is not less than key, or end().
+*/
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::const_iterator
+PersistentAVLTree<Key, Value>::lower_bound(const Key& key) const
+{
+    const_iterator it;
+    const PNode* curr = root_;
+    while(curr != NULL){
+        if(KeyCompare<Key>::less(curr->item.first, key)){
+            curr = curr->right;
+        } else {
+            it.stack_.push_back(curr);
+            if(!KeyCompare<Key>::less(key, curr->item.first)){
+                break;
+            }
+            curr = curr->left;
+        }
+    }
+    return it;
+}
+
+/**
+ * @precondition The key exists in the map
+ * Returns the value associated with the key
+ */
+template<class Key, class Value>
+Value const & PersistentAVLTree<Key, Value>::operator[](const Key& key) const
+{
+    const_iterator it = find(key);
+    if(it == end()) throw std::out_of_range("Invalid key");
+    return it->second;
+}
+
+template<class Key, class Value>
+std::size_t PersistentAVLTree<Key, Value>::size() const
+{
+    return size_;
+}
+
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::empty() const
+{
+    return root_ == NULL;
+}
+
+/**
+* Checks the keys are ordered and every stored height and balance is right.
+*/
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::isBalanced() const
+{
+    int h = 0;
+    return checkSubtree(root_, NULL, NULL, h);
+}
+
+template<class Key, class Value>
+int PersistentAVLTree<Key, Value>::height(const PNode* node)
+{
+    return node == NULL ? 0 : node->height;
+}
+
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::fixHeight(PNode* node)
+{
+    node->height = 1 + std::max(height(node->left), height(node->right));
+}
+
+// helper that adds a reference to a node, which may be NULL
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::retain(PNode* node)
+{
+    if(node != NULL){
+        node->refs.fetch_add(1, std::memory_order_relaxed);
+    }
+    return node;
+}
+
+// helper that drops a reference, freeing the node (and its share of the
+// nodes below) when it was the last one
+template<class Key, class Value>
+void PersistentAVLTree<Key, Value>::release(PNode* node)
+{
+    if(node != NULL && node->refs.fetch_sub(1, std::memory_order_acq_rel) == 1){
+        release(node->left);
+        release(node->right);
+        delete node;
+    }
+}
+
+// helper that turns the caller's reference to node into a node only the
+// caller points at: node itself if nothing else does, otherwise a copy
+// (and the reference to the shared original is dropped)
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::own(PNode* node)
+{
+    if(node->refs.load(std::memory_order_acquire) == 1){
+        return node;
+    }
+    PNode* copy = new PNode(*node);
+    release(node);
+    return copy;
+}
+
+// helper for rotating left around an owned node; the right child moves up,
+// so it is owned first. Returns the new subtree root.
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::rotateLeft(PNode* node)
+{
+    PNode* child = own(node->right);
+    node->right = child->left;
+    child->left = node;
+    fixHeight(node);
+    fixHeight(child);
+    return child;
+}
+
+// helper for rotating right, the mirror image of rotateLeft
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::rotateRight(PNode* node)
+{
+    PNode* child = own(node->left);
+    node->left = child->right;
+    child->right = node;
+    fixHeight(node);
+    fixHeight(child);
+    return child;
+}
+
+// helper that fixes the height of an owned node whose subtrees differ by at
+// most two, rotating (twice if the inner grandchild is taller) when needed
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::rebalance(PNode* node)
+{
+    int balance = height(node->right) - height(node->left);
+    if(balance < -1){
+        if(height(node->left->right) > height(node->left->left)){
+            node->left = rotateLeft(own(node->left));
+        }
+        return rotateRight(node);
+    }
+    if(balance > 1){
+        if(height(node->right->left) > height(node->right->right)){
+            node->right = rotateRight(own(node->right));
+        }
+        return rotateLeft(node);
+    }
+    fixHeight(node);
+    return node;
+}
+
+// helper for insert: takes the caller's reference to a subtree and returns
+// the subtree with the item in it
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::insertAt(PNode* node, const std::pair<const Key, Value>& keyValuePair, bool& added)
+{
+    if(node == NULL){
+        added = true;
+        return new PNode(keyValuePair);
+    }
+    node = own(node);
+    if(KeyCompare<Key>::less(keyValuePair.first, node->item.first)){
+        node->left = insertAt(node->left, keyValuePair, added);
+    } else if(KeyCompare<Key>::less(node->item.first, keyValuePair.first)){
+        node->right = insertAt(node->right, keyValuePair, added);
+    } else {
+        node->item.second = keyValuePair.second;
+        return node;
+    }
+    return rebalance(node);
+}
+
+// helper for remove, for a key known to be in the subtree
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::removeAt(PNode* node, const Key& key)
+{
+    node = own(node);
+    if(KeyCompare<Key>::less(key, node->item.first)){
+        node->left = removeAt(node->left, key);
+        return rebalance(node);
+    }
+    if(KeyCompare<Key>::less(node->item.first, key)){
+        node->right = removeAt(node->right, key);
+        return rebalance(node);
+    }
+
+    // found it; the keys are const, so the successor node itself moves here
+    PNode* replacement;
+    if(node->left == NULL || node->right == NULL){
+        replacement = node->left != NULL ? node->left : node->right;
+    } else {
+        PNode* rest = removeMin(node->right, replacement);
+        replacement->left = node->left;
+        replacement->right = rest;
+        replacement = rebalance(replacement);
+    }
+    node->left = node->right = NULL;
+    release(node);
+    return replacement;
+}
+
+// helper that takes the smallest node out of a subtree, handing it back
+// owned and unlinked in min
+template<class Key, class Value>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::removeMin(PNode* node, PNode*& min)
+{
+    node = own(node);
+    if(node->left == NULL){
+        PNode* rest = node->right;
+        node->right = NULL;
+        min = node;
+        return rest;
+    }
+    node->left = removeMin(node->left, min);
+    return rebalance(node);
+}
+
+// helper for the range constructor: the middle item goes on top and each
+// half is built the same way
+template<class Key, class Value>
+template<typename ForwardIt>
+typename PersistentAVLTree<Key, Value>::PNode*
+PersistentAVLTree<Key, Value>::buildSorted(ForwardIt& next, std::size_t count)
+{
+    if(count == 0){
+        return NULL;
+    }
+    std::size_t leftcount = count / 2;
+    PNode* left = buildSorted(next, leftcount);
+    PNode* node = new PNode(*next);
+    ++next;
+    node->left = left;
+    node->right = buildSorted(next, count - leftcount - 1);
+    fixHeight(node);
+    return node;
+}
+
+// helper for isBalanced that checks a subtree and works out its height
+template<class Key, class Value>
+bool PersistentAVLTree<Key, Value>::checkSubtree(const PNode* node, const Key* lo, const Key* hi, int& height)
+{
+    if(node == NULL){
+        height = 0;
+        return true;
+    }
+    if((lo != NULL && !KeyCompare<Key>::less(*lo, node->item.first)) ||
+       (hi != NULL && !KeyCompare<Key>::less(node->item.first, *hi))){
+        return false;
+    }
+    int hL = 0;
+    int hR = 0;
+    if(!checkSubtree(node->left, lo, &node->item.first, hL) ||
+       !checkSubtree(node->right, &node->item.first, hi, hR)){
+        return false;
+    }
+    height = 1 + std::max(hL, hR);
+    return height == node->height && hL - hR >= -1 && hL - hR <= 1;
+}
+
+#endif
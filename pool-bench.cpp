@@ -0,0 +1,86 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "bst.h"
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares node allocation through the NodePool against plain new/delete.
+// Each run fills a tree, churns it with remove/insert pairs, then clears it.
+// usage: ./pool-bench [numKeys] [churnOps]
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point start)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count();
+}
+
+template<typename Tree>
+void runWorkload(const char* name, bool pooled, const vector<int>& keys, size_t churnOps)
+{
+    Tree tree;
+    if(pooled) {
+        tree.enablePool(4096);
+    }
+
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < keys.size(); ++i) {
+        tree.insert(std::make_pair(keys[i], (int)i));
+    }
+    double fillNs = elapsedNs(start);
+
+    // remove a key and put it straight back so the tree size stays the same
+    mt19937 rng(7);
+    start = Clock::now();
+    for(size_t i = 0; i < churnOps; ++i) {
+        int k = keys[rng() % keys.size()];
+        tree.remove(k);
+        tree.insert(std::make_pair(k, (int)i));
+    }
+    double churnNs = elapsedNs(start);
+
+    NodePoolStats stats = tree.poolStats();
+
+    start = Clock::now();
+    tree.clear();
+    double clearNs = elapsedNs(start);
+
+    cout << left << setw(6) << name << setw(10) << (pooled ? "pool" : "new") << right
+         << setw(12) << fixed << setprecision(1) << fillNs / keys.size()
+         << setw(12) << churnNs / (2.0 * churnOps)
+         << setw(12) << clearNs / keys.size();
+    if(pooled) {
+        cout << "   reserved " << stats.bytesReserved << " B, live " << stats.bytesLive
+             << " B in " << stats.slabs << " slabs";
+    }
+    cout << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t churn = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) {
+        keys[i] = (int)i;
+    }
+    // random order so the plain BST stays reasonably shallow
+    shuffle(keys.begin(), keys.end(), mt19937(42));
+
+    cout << n << " keys, " << churn << " remove/insert pairs (ns per op)" << endl;
+    cout << left << setw(6) << "tree" << setw(10) << "alloc" << right
+         << setw(12) << "insert" << setw(12) << "churn" << setw(12) << "clear" << endl;
+
+    runWorkload<BinarySearchTree<int, int> >("bst", false, keys, churn);
+    runWorkload<BinarySearchTree<int, int> >("bst", true, keys, churn);
+    runWorkload<AVLTree<int, int> >("avl", false, keys, churn);
+    runWorkload<AVLTree<int, int> >("avl", true, keys, churn);
+    return 0;
+}
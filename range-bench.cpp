@@ -0,0 +1,88 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares narrow range scans done the old way, starting at begin() and
+// filtering every item, against for_each_in_range() and a lower_bound()
+// loop, which find the first key in O(log n) and stop at the end of the range.
+// usage: ./range-bench [numKeys] [rangeWidth] [numScans]
+
+typedef chrono::steady_clock Clock;
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+static double elapsedUs(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, micro>(Clock::now() - start).count() / ops;
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 10000000;
+    uint64_t width = argc > 2 ? strtoull(argv[2], NULL, 10) : 100;
+    size_t scans = argc > 3 ? strtoul(argv[3], NULL, 10) : 10;
+
+    // every third number is a key so ranges hold about width / 3 items
+    vector<pair<uint64_t, uint64_t> > items(n);
+    for(size_t i = 0; i < n; ++i) items[i] = make_pair((uint64_t)i * 3, (uint64_t)i);
+    Tree tree;
+    tree.enablePool(1 << 16);
+    tree.assign(items.begin(), items.end());
+    items.clear();
+    items.shrink_to_fit();
+
+    // each way gets its own ranges so none of them runs on nodes the one
+    // before it just pulled into the cache
+    vector<uint64_t> starts(scans), rangeStarts(scans), boundStarts(scans);
+    mt19937_64 rng(8);
+    for(size_t i = 0; i < scans; ++i) {
+        starts[i] = rng() % (3 * n);
+        rangeStarts[i] = rng() % (3 * n);
+        boundStarts[i] = rng() % (3 * n);
+    }
+
+    // old way: walk everything and keep what is in range
+    uint64_t filtered = 0;
+    size_t hits = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < scans; ++i) {
+        uint64_t lo = starts[i], hi = starts[i] + width;
+        for(Tree::iterator it = tree.begin(); it != tree.end(); ++it) {
+            if(it->first >= lo && it->first < hi) { filtered += it->second; ++hits; }
+        }
+    }
+    double filterUs = elapsedUs(start, scans);
+
+    size_t visited = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < scans; ++i) {
+        tree.for_each_in_range(rangeStarts[i], rangeStarts[i] + width,
+            [&visited](const pair<const uint64_t, uint64_t>&) { ++visited; });
+    }
+    double rangeUs = elapsedUs(start, scans);
+
+    size_t bounded = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < scans; ++i) {
+        uint64_t hi = boundStarts[i] + width;
+        for(Tree::iterator it = tree.lower_bound(boundStarts[i]); it != tree.end() && it->first < hi; ++it) {
+            ++bounded;
+        }
+    }
+    double boundUs = elapsedUs(start, scans);
+
+    cout << n << " keys, ranges " << width << " wide, " << scans << " scans (us per scan)" << endl;
+    cout << fixed << setprecision(2);
+    cout << "begin() + filter:     " << setw(14) << filterUs << endl;
+    cout << "for_each_in_range:    " << setw(14) << rangeUs << endl;
+    cout << "lower_bound + ++:     " << setw(14) << boundUs << endl;
+    cout << "items per scan: " << (double)hits / scans << ", " << (double)visited / scans
+         << ", " << (double)bounded / scans << " (sum " << filtered << ")" << endl;
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares percentile and rank queries answered by walking iterators from
+// begin() on a plain AVLTree against select() and rank() on an
+// OrderStatTree, and what keeping the sizes costs on insert and remove.
+// usage: ./rank-bench [numKeys] [numQueries]
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+}
+
+// the way percentiles were found before: step to the position
+template<typename Tree>
+int walkSelect(const Tree& tree, size_t index)
+{
+    typename Tree::iterator it = tree.begin();
+    for(size_t i = 0; i < index; ++i) ++it;
+    return it->first;
+}
+
+template<typename Tree>
+size_t walkRank(const Tree& tree, int key)
+{
+    size_t below = 0;
+    for(typename Tree::iterator it = tree.begin(); it != tree.end() && it->first < key; ++it) ++below;
+    return below;
+}
+
+template<typename Tree>
+double churn(const vector<int>& keys)
+{
+    Tree tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < keys.size(); ++i) tree.insert(std::make_pair(keys[i], (int)i));
+    for(size_t i = 0; i < keys.size(); ++i) tree.remove(keys[i]);
+    return elapsedNs(start, 2 * keys.size());
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 200000;
+    size_t queries = argc > 2 ? strtoul(argv[2], NULL, 10) : 200;
+
+    vector<int> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = (int)(i * 2);
+    shuffle(keys.begin(), keys.end(), mt19937(6));
+
+    AVLTree<int, int> plain;
+    OrderStatTree<int, int> counted;
+    for(size_t i = 0; i < n; ++i) {
+        plain.insert(std::make_pair(keys[i], (int)i));
+        counted.insert(std::make_pair(keys[i], (int)i));
+    }
+
+    vector<size_t> positions(queries);
+    vector<int> probes(queries);
+    mt19937 rng(7);
+    for(size_t i = 0; i < queries; ++i) {
+        positions[i] = rng() % n;
+        probes[i] = (int)(rng() % (2 * n));
+    }
+
+    long long sum = 0;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < queries; ++i) sum += walkSelect(plain, positions[i]);
+    double walkSel = elapsedNs(start, queries);
+    start = Clock::now();
+    for(size_t i = 0; i < queries; ++i) sum -= counted.select(positions[i])->first;
+    double sel = elapsedNs(start, queries);
+
+    long long ranks = 0;
+    start = Clock::now();
+    for(size_t i = 0; i < queries; ++i) ranks += walkRank(plain, probes[i]);
+    double walkRk = elapsedNs(start, queries);
+    start = Clock::now();
+    for(size_t i = 0; i < queries; ++i) ranks -= counted.rank(probes[i]);
+    double rk = elapsedNs(start, queries);
+
+    cout << n << " keys, " << queries << " queries (ns per query)" << endl << fixed << setprecision(1);
+    cout << left << setw(10) << "query" << right << setw(14) << "walk" << setw(14) << "sizes" << endl;
+    cout << left << setw(10) << "select" << right << setw(14) << walkSel << setw(14) << sel << endl;
+    cout << left << setw(10) << "rank" << right << setw(14) << walkRk << setw(14) << rk << endl;
+    cout << "answers " << (sum == 0 && ranks == 0 ? "agree" : "DIFFER") << endl;
+
+    cout << "insert+remove (ns per op): plain " << churn<AVLTree<int, int> >(keys)
+         << ", with sizes " << churn<OrderStatTree<int, int> >(keys) << endl;
+    return 0;
+}
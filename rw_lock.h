@@ -0,0 +1,112 @@
+#ifndef RW_LOCK_H
+#define RW_LOCK_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/**
+* A reader-writer lock: any number of readers at once, or one writer.
+*
+* Readers only touch one atomic word when no writer is around, so a
+* read-mostly load does not queue up on a mutex. A writer first raises the
+* WRITER bit, which turns new readers away, then sleeps until the readers
+* already inside have left. Writers are preferred, so a steady stream of
+* readers cannot starve them. Waiting is done on a mutex and condition
+* variable, never by spinning.
+*/
+class ReadWriteLock
+{
+public:
+    ReadWriteLock();
+
+    void lockShared();
+    void unlockShared();
+    void lock();
+    void unlock();
+
+private:
+    // no copying, threads wait on this very object
+    ReadWriteLock(const ReadWriteLock&);
+    ReadWriteLock& operator=(const ReadWriteLock&);
+
+    static const std::uint32_t WRITER = 1u << 31;
+
+    // WRITER bit plus the number of readers inside
+    std::atomic<std::uint32_t> state_;
+    // one writer at a time gets to raise the WRITER bit
+    std::mutex writerMutex_;
+    // sleeping readers and the writer waiting for readers to drain
+    std::mutex waitMutex_;
+    std::condition_variable waitCond_;
+};
+
+inline ReadWriteLock::ReadWriteLock()
+    : state_(0)
+{
+}
+
+/**
+* Takes the lock for reading, waiting while a writer holds or wants it.
+*/
+inline void ReadWriteLock::lockShared()
+{
+    std::uint32_t state = state_.load(std::memory_order_relaxed);
+    while(true){
+        if((state & WRITER) == 0){
+            if(state_.compare_exchange_weak(state, state + 1, std::memory_order_acquire, std::memory_order_relaxed)){
+                return;
+            }
+            continue;
+        }
+        // a writer is in or on its way, sleep until it is done
+        std::unique_lock<std::mutex> guard(waitMutex_);
+        while(state_.load(std::memory_order_relaxed) & WRITER){
+            waitCond_.wait(guard);
+        }
+        state = state_.load(std::memory_order_relaxed);
+    }
+}
+
+/**
+* Gives up a read lock. The last reader out wakes a waiting writer.
+*/
+inline void ReadWriteLock::unlockShared()
+{
+    std::uint32_t before = state_.fetch_sub(1, std::memory_order_release);
+    if(before == (WRITER | 1)){
+        // take the mutex so the writer is either asleep already or has
+        // not checked the count yet, then it cannot miss this wakeup
+        std::lock_guard<std::mutex> guard(waitMutex_);
+        waitCond_.notify_all();
+    }
+}
+
+/**
+* Takes the lock for writing, once every reader already inside has left.
+*/
+inline void ReadWriteLock::lock()
+{
+    writerMutex_.lock();
+    state_.fetch_or(WRITER, std::memory_order_acquire);
+    std::unique_lock<std::mutex> guard(waitMutex_);
+    while(state_.load(std::memory_order_acquire) != WRITER){
+        waitCond_.wait(guard);
+    }
+}
+
+/**
+* Gives up the write lock and wakes the readers that were turned away.
+*/
+inline void ReadWriteLock::unlock()
+{
+    {
+        std::lock_guard<std::mutex> guard(waitMutex_);
+        state_.fetch_and(~WRITER, std::memory_order_release);
+    }
+    waitCond_.notify_all();
+    writerMutex_.unlock();
+}
+
+#endif
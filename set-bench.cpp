@@ -0,0 +1,105 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+
+using namespace std;
+
+// Compares merging two AVLTrees one element at a time (an insert, find or
+// remove per key of the second tree) against unite(), intersect() and
+// subtract(), which cut and join whole subtrees, run on a ForkJoinPool of
+// 1, 2, 4, ... up to maxThreads threads. Half of the second tree's keys
+// are also in the first.
+// usage: ./set-bench [numKeys] [otherKeys] [maxThreads] [grain]
+
+typedef chrono::steady_clock Clock;
+typedef AVLTree<uint64_t, uint64_t> Tree;
+
+static double elapsedMs(Clock::time_point start)
+{
+    return chrono::duration<double, milli>(Clock::now() - start).count();
+}
+
+// the baseline, one lookup or update in a per key of b
+static double oneByOne(int op, Tree& a, const vector<pair<uint64_t, uint64_t> >& b)
+{
+    Tree result;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < b.size(); ++i) {
+        if(op == 0) {
+            a.insert(b[i]);
+        } else if(op == 1) {
+            if(a.find(b[i].first) != a.end()) result.insert(b[i]);
+        } else {
+            a.remove(b[i].first);
+        }
+    }
+    return elapsedMs(start);
+}
+
+static double bulk(int op, Tree& a, Tree& b, ForkJoinPool* pool, size_t grain)
+{
+    Clock::time_point start = Clock::now();
+    if(op == 0) a.unite(b, pool, grain);
+    else if(op == 1) a.intersect(b, pool, grain);
+    else a.subtract(b, pool, grain);
+    return elapsedMs(start);
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 2000000;
+    size_t m = argc > 2 ? strtoul(argv[2], NULL, 10) : 2000000;
+    unsigned hw = thread::hardware_concurrency();
+    unsigned maxThreads = argc > 3 ? strtoul(argv[3], NULL, 10) : (hw > 0 ? hw : 4);
+    size_t grain = argc > 4 ? strtoul(argv[4], NULL, 10) : 4096;
+
+    // a holds the even keys below 2n; b gets m keys, half of them shared
+    mt19937_64 rng(17);
+    vector<pair<uint64_t, uint64_t> > va(n), vb(m);
+    for(size_t i = 0; i < n; ++i) va[i] = make_pair(2 * i, i);
+    for(size_t i = 0; i < m; ++i) {
+        uint64_t key = rng() % (2 * n);
+        vb[i] = make_pair(i % 2 ? key | 1 : key & ~(uint64_t)1, i);
+    }
+    sort(vb.begin(), vb.end());
+    vb.erase(unique(vb.begin(), vb.end(), [](const pair<uint64_t, uint64_t>& x, const pair<uint64_t, uint64_t>& y) {
+        return x.first == y.first;
+    }), vb.end());
+    // the baseline visits b in random order, as an index merge would
+    vector<pair<uint64_t, uint64_t> > shuffled(vb);
+    shuffle(shuffled.begin(), shuffled.end(), rng);
+
+    cout << n << " and " << vb.size() << " keys, grain " << grain << ", " << hw
+         << " hardware threads (ms)" << endl;
+    cout << left << setw(12) << "op" << right << setw(12) << "one by one";
+    vector<unsigned> counts;
+    for(unsigned t = 1; ; t = t * 2 < maxThreads ? t * 2 : maxThreads) {
+        counts.push_back(t);
+        cout << setw(12) << (to_string(t) + (t == 1 ? " thread" : " threads"));
+        if(t >= maxThreads) break;
+    }
+    cout << endl;
+
+    const char* names[] = { "unite", "intersect", "subtract" };
+    bool ok = true;
+    for(int op = 0; op < 3; ++op) {
+        Tree base(va.begin(), va.end());
+        double single = oneByOne(op, base, shuffled);
+        cout << left << setw(12) << names[op] << right << fixed << setprecision(1) << setw(12) << single;
+        for(size_t c = 0; c < counts.size(); ++c) {
+            ForkJoinPool pool(counts[c]);
+            Tree a(va.begin(), va.end());
+            Tree b(vb.begin(), vb.end());
+            cout << setw(12) << bulk(op, a, b, &pool, grain) << flush;
+            ok = ok && a.isBalanced() && b.empty();
+        }
+        cout << endl;
+    }
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+#include "persistent_avl.h"
+
+using namespace std;
+
+// Compares taking a point-in-time view of a tree: copying an AVLTree (its
+// items rebuilt into a new tree in linear time) against the O(1) snapshot()
+// of a PersistentAVLTree. Then measures what snapshots cost the writer:
+// random inserts and removes with no snapshot alive, and with a fresh
+// snapshot held every so many writes, so the paths get copied.
+// usage: ./snapshot-bench [numKeys] [numWrites] [writesPerSnapshot]
+
+typedef chrono::steady_clock Clock;
+
+static double elapsedNs(Clock::time_point start, size_t ops)
+{
+    return chrono::duration<double, nano>(Clock::now() - start).count() / ops;
+}
+
+// random writes on a tree that holds every even key, half inserts of odd keys
+template<typename Tree>
+double writes(Tree& tree, uint64_t keySpace, size_t count, size_t perSnapshot, PersistentAVLTree<uint64_t, uint64_t>* (*take)(Tree&))
+{
+    mt19937_64 rng(3);
+    PersistentAVLTree<uint64_t, uint64_t>* held = NULL;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < count; ++i) {
+        if(take != NULL && i % perSnapshot == 0) {
+            delete held;
+            held = take(tree);
+        }
+        uint64_t key = rng() % keySpace;
+        if(key & 1) tree.insert(make_pair(key, key));
+        else tree.remove(key | 1);
+    }
+    double ns = elapsedNs(start, count);
+    delete held;
+    return ns;
+}
+
+static PersistentAVLTree<uint64_t, uint64_t>* takeSnapshot(PersistentAVLTree<uint64_t, uint64_t>& tree)
+{
+    return new PersistentAVLTree<uint64_t, uint64_t>(tree.snapshot());
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t count = argc > 2 ? strtoul(argv[2], NULL, 10) : 1000000;
+    size_t perSnapshot = argc > 3 ? strtoul(argv[3], NULL, 10) : 100;
+
+    vector<pair<uint64_t, uint64_t> > sorted(n);
+    for(size_t i = 0; i < n; ++i) sorted[i] = make_pair(2 * i, 2 * i);
+    AVLTree<uint64_t, uint64_t> avl(sorted.begin(), sorted.end());
+    PersistentAVLTree<uint64_t, uint64_t> persistent(sorted.begin(), sorted.end());
+
+    Clock::time_point start = Clock::now();
+    AVLTree<uint64_t, uint64_t> copy(avl.begin(), avl.end());
+    double copyNs = elapsedNs(start, 1);
+    start = Clock::now();
+    PersistentAVLTree<uint64_t, uint64_t> snap = persistent.snapshot();
+    double snapNs = elapsedNs(start, 1);
+    snap.clear();
+
+    double avlNs = writes<AVLTree<uint64_t, uint64_t> >(avl, 2 * n, count, perSnapshot, NULL);
+    double plainNs = writes<PersistentAVLTree<uint64_t, uint64_t> >(persistent, 2 * n, count, perSnapshot, NULL);
+    double sharedNs = writes<PersistentAVLTree<uint64_t, uint64_t> >(persistent, 2 * n, count, perSnapshot, takeSnapshot);
+
+    cout << n << " keys, " << count << " writes" << endl;
+    cout << fixed << setprecision(1);
+    cout << left << setw(44) << "copy an AVLTree (ms)" << right << setw(12) << copyNs / 1e6 << endl;
+    cout << left << setw(44) << "PersistentAVLTree::snapshot (ns)" << right << setw(12) << snapNs << endl;
+    cout << left << setw(44) << "AVLTree write (ns)" << right << setw(12) << avlNs << endl;
+    cout << left << setw(44) << "persistent write, no snapshot (ns)" << right << setw(12) << plainNs << endl;
+    cout << left << setw(44) << ("persistent write, snapshot every " + to_string(perSnapshot) + " (ns)")
+         << right << setw(12) << sharedNs << endl;
+    return persistent.isBalanced() ? 0 : 1;
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include "avlbst.h"
+#include "splaybst.h"
+#include "bench_keys.h"
+
+using namespace std;
+
+// Compares SplayTree with AVLTree on lookups whose keys are Zipfian
+// (exponent 0.99 by default, so a few keys take most of the hits),
+// sequential (every key in order, over and over) and, for contrast,
+// uniformly random. Both trees start from the same keys inserted in random
+// order, so neither has its nodes laid out in key order in memory.
+// usage: ./splay-bench [numKeys] [numLookups] [zipfExponent]
+
+typedef chrono::steady_clock Clock;
+typedef uint64_t Key;
+
+// results are added up here, where the compiler cannot drop the work
+uint64_t sink = 0;
+
+template<typename Tree>
+double insertNs(Tree& tree, const vector<Key>& keys)
+{
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < keys.size(); ++i) tree.insert(std::make_pair(keys[i], keys[i]));
+    return chrono::duration<double, nano>(Clock::now() - start).count() / keys.size();
+}
+
+template<typename Tree>
+double lookupNs(Tree& tree, const vector<Key>& probes)
+{
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < probes.size(); ++i) sink += tree.find(probes[i])->second;
+    return chrono::duration<double, nano>(Clock::now() - start).count() / probes.size();
+}
+
+int main(int argc, char* argv[])
+{
+    size_t n = argc > 1 ? strtoul(argv[1], NULL, 10) : 1000000;
+    size_t lookups = argc > 2 ? strtoul(argv[2], NULL, 10) : 4000000;
+    double exponent = argc > 3 ? atof(argv[3]) : 0.99;
+
+    vector<Key> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = i;
+    shuffle(keys.begin(), keys.end(), mt19937_64(30));
+
+    // the popular ranks are scattered over the key space
+    vector<Key> zipfian = zipfianKeys(scatteredKeys(n, 1, 31), lookups, exponent, 32);
+    vector<Key> sequential(lookups);
+    for(size_t i = 0; i < lookups; ++i) sequential[i] = i % n;
+    vector<Key> uniform(lookups);
+    mt19937_64 rng(33);
+    for(size_t i = 0; i < lookups; ++i) uniform[i] = rng() % n;
+
+    AVLTree<Key, Key> avl;
+    SplayTree<Key, Key> splay;
+    double avlInsert = insertNs(avl, keys);
+    double splayInsert = insertNs(splay, keys);
+
+    cout << n << " keys, " << lookups << " lookups, Zipf exponent " << exponent << " (ns per op)" << endl;
+    cout << left << setw(22) << "workload" << right << setw(12) << "AVLTree" << setw(12) << "SplayTree" << endl;
+    cout << fixed << setprecision(1);
+    cout << left << setw(22) << "random inserts" << right << setw(12) << avlInsert << setw(12) << splayInsert << endl;
+    const char* names[] = { "zipfian finds", "sequential finds", "uniform finds" };
+    const vector<Key>* workloads[] = { &zipfian, &sequential, &uniform };
+    for(int w = 0; w < 3; ++w) {
+        double avlNs = lookupNs(avl, *workloads[w]);
+        double splayNs = lookupNs(splay, *workloads[w]);
+        cout << left << setw(22) << names[w] << right << setw(12) << avlNs << setw(12) << splayNs << endl;
+    }
+    cout << "heights after: AVLTree " << avl.height() << ", SplayTree " << splay.height() << endl;
+    return 0;
+}
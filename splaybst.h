@@ -0,0 +1,189 @@
+#ifndef SPLAYBST_H
+#define SPLAYBST_H
+
+#include <utility>
+#include "bst.h"
+
+/**
+* A self-adjusting binary search tree. find, insert and remove splay the
+* node they reach to the root, so keys that are used often stay near the
+* top and skewed lookups (a few keys taking most of the hits) or runs of
+* nearby keys get much cheaper than O(log n). Any sequence of operations
+* costs O(log n) amortized each, but a single one can take O(n).
+*
+* Nodes are the plain BSTNodes and everything else (iterators, the node
+* pool, nodeSwap and the removal of a node) is BinarySearchTree's. The
+* heights and balance flags BinarySearchTree keeps are updated by every
+* rotation, so height() and isBalanced() stay O(1).
+*
+* Only the non-const find() splays; finding through a const tree, or
+* lower_bound() and the other ordered lookups, leave the shape alone. New
+* keys are splayed however they are inserted, while a key that is already
+* there is only splayed by insert().
+*/
+template <class Key, class Value>
+class SplayTree : public BinarySearchTree<Key, Value>
+{
+public:
+    virtual std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+    insert(const std::pair<const Key, Value>& keyValuePair);
+    virtual void remove(const Key& key);
+    typename BinarySearchTree<Key, Value>::iterator find(const Key& key);
+
+    // the move-aware inserts, emplace and the const find come from BinarySearchTree
+    using BinarySearchTree<Key, Value>::insert;
+    using BinarySearchTree<Key, Value>::find;
+
+protected:
+    virtual void rebalanceInsert(Node<Key, Value>* node);
+
+    // Add helper functions here
+    BSTNode<Key, Value>* access(const Key& key);
+    void splay(BSTNode<Key, Value>* node, BSTNode<Key, Value>* stop);
+    void rotateUp(BSTNode<Key, Value>* node);
+};
+
+/**
+* Inserts the item, or overwrites the value if the key is already there,
+* and splays its node to the root.
+*/
+template<class Key, class Value>
+std::pair<typename BinarySearchTree<Key, Value>::iterator, bool>
+SplayTree<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    TREE_TIME(TREE_OP_INSERT);
+    std::pair<Node<Key, Value>*, bool> result = this->template insertItem<BSTNode<Key, Value> >(keyValuePair);
+    // new nodes were already splayed by rebalanceInsert
+    if(!result.second){
+        splay(static_cast<BSTNode<Key, Value>*>(result.first), nullptr);
+    }
+    return std::make_pair(this->makeIterator(result.first), result.second);
+}
+
+/**
+* Removes the key if it is there. The key's node is splayed to the root
+* first, or the last node looked at if the key is missing.
+*/
+template<class Key, class Value>
+void SplayTree<Key, Value>::remove(const Key& key)
+{
+    TREE_TIME(TREE_OP_REMOVE);
+    BSTNode<Key, Value>* node = access(key);
+    if(node == nullptr){
+        return;
+    }
+    if(node->getLeft() != nullptr && node->getRight() != nullptr){
+        // bring the predecessor up under the root, where it has no right
+        // child, so swapping with it and unlinking only touch the top
+        splay(static_cast<BSTNode<Key, Value>*>(this->predecessor(node)), node);
+    }
+    this->removeNode(node);
+}
+
+/**
+* Returns an iterator to the key, or end() if it is not there, and splays
+* the key's node (or the last node looked at) to the root.
+*/
+template<class Key, class Value>
+typename BinarySearchTree<Key, Value>::iterator SplayTree<Key, Value>::find(const Key& key)
+{
+    TREE_TIME(TREE_OP_FIND);
+    return this->makeIterator(access(key));
+}
+
+// hook the shared insert calls once the new node is linked in
+template<class Key, class Value>
+void SplayTree<Key, Value>::rebalanceInsert(Node<Key, Value>* node)
+{
+    // every node above the new leaf is rotated, which fixes their heights too
+    splay(static_cast<BSTNode<Key, Value>*>(node), nullptr);
+}
+
+// helper that looks for the key, stopping where it matches, then splays
+// the node it stopped at and returns it if it holds the key
+template<class Key, class Value>
+BSTNode<Key, Value>* SplayTree<Key, Value>::access(const Key& key)
+{
+    BSTNode<Key, Value>* curr = static_cast<BSTNode<Key, Value>*>(this->root_);
+    BSTNode<Key, Value>* last = nullptr;
+    TREE_STAT(descents);
+    while(curr != nullptr){
+        TREE_STAT(descentSteps);
+        last = curr;
+        if(KeyCompare<Key>::less(key, curr->getKey())){
+            curr = curr->getLeft();
+        } else if(KeyCompare<Key>::less(curr->getKey(), key)){
+            curr = curr->getRight();
+        } else {
+            break;
+        }
+    }
+    if(last != nullptr){
+        splay(last, nullptr);
+    }
+    return curr;
+}
+
+// helper that rotates node up until its parent is stop, nullptr meaning
+// all the way to the root, two levels at a time
+template<class Key, class Value>
+void SplayTree<Key, Value>::splay(BSTNode<Key, Value>* node, BSTNode<Key, Value>* stop)
+{
+    while(node->getParent() != stop){
+        BSTNode<Key, Value>* parent = node->getParent();
+        BSTNode<Key, Value>* grand = parent->getParent();
+        if(grand == stop){
+            // zig, one level left
+            rotateUp(node);
+        } else if((grand->getLeft() == parent) == (parent->getLeft() == node)){
+            // zig-zig, a straight line, so the parent goes up first
+            rotateUp(parent);
+            rotateUp(node);
+        } else {
+            // zig-zag, a bend, so node goes up twice
+            rotateUp(node);
+            rotateUp(node);
+        }
+    }
+    // the nodes above stop only see a subtree that changed shape
+    this->fixHeights(stop);
+}
+
+// helper that rotates node above its parent and fixes both heights
+template<class Key, class Value>
+void SplayTree<Key, Value>::rotateUp(BSTNode<Key, Value>* node)
+{
+    BSTNode<Key, Value>* parent = node->getParent();
+    BSTNode<Key, Value>* grand = parent->getParent();
+    if(parent->getLeft() == node){
+        TREE_STAT(rotateRights);
+        BSTNode<Key, Value>* inner = node->getRight();
+        parent->setLeft(inner);
+        if(inner != nullptr){
+            inner->setParent(parent);
+        }
+        node->setRight(parent);
+    } else {
+        TREE_STAT(rotateLefts);
+        BSTNode<Key, Value>* inner = node->getLeft();
+        parent->setRight(inner);
+        if(inner != nullptr){
+            inner->setParent(parent);
+        }
+        node->setLeft(parent);
+    }
+    parent->setParent(node);
+    node->setParent(grand);
+    if(grand == nullptr){
+        this->root_ = node;
+    } else if(grand->getLeft() == parent){
+        grand->setLeft(node);
+    } else {
+        grand->setRight(node);
+    }
+    // parent is below node now, so it goes first
+    this->updateHeight(parent);
+    this->updateHeight(node);
+}
+
+#endif
@@ -0,0 +1,224 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <string>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include "bst.h"
+#include "avlbst.h"
+#include "bench_keys.h"
+
+using namespace std;
+
+// The benchmark suite behind 'make bench'. Times insert, find, iterate and
+// remove on BinarySearchTree, AVLTree and std::map, for keys that arrive in
+// sequential, random, reverse and Zipfian order, at several sizes, and
+// prints ns per operation as a table and optionally as JSON.
+//
+// The keys are seeded, so two runs do the same work. Each case is run
+// --repeats times and the median is reported. A repeat at a small size
+// runs several rounds, each on a fresh tree, so that every timing covers
+// enough operations to be read reliably.
+//
+// A plain BinarySearchTree fed sorted keys degenerates into a list and
+// costs O(n^2), so those cases are only run up to --max-chain keys.
+// usage: ./suite-bench [--json file] [--repeats n] [--max-chain n] [sizes...]
+
+typedef chrono::steady_clock Clock;
+typedef uint64_t Key;
+typedef uint64_t Value;
+
+static const char* const OPS[] = { "insert", "find", "iterate", "remove" };
+static const int NUM_OPS = 4;
+// each repeat runs whole rounds until it has taken at least this long
+static const double MIN_REPEAT_NS = 50e6;
+
+// results are added up here, where the compiler cannot drop the work
+uint64_t sink = 0;
+
+enum Distribution { SEQUENTIAL, RANDOM, REVERSE, ZIPFIAN };
+static const char* const DISTRIBUTIONS[] = { "sequential", "random", "reverse", "zipfian" };
+
+struct Result
+{
+    string tree;
+    string distribution;
+    size_t size;
+    string op;
+    double nsPerOp;
+};
+
+// helper that makes the n keys in the order they are inserted, found and
+// removed. The Zipfian keys are n draws (exponent 0.99) over n ranks, with
+// the ranks scattered over the key space, so a few keys repeat very often
+// and the tree ends up with fewer than n of them.
+static vector<Key> makeKeys(Distribution dist, size_t n)
+{
+    vector<Key> keys(n);
+    for(size_t i = 0; i < n; ++i) keys[i] = i;
+    if(dist == RANDOM) {
+        shuffle(keys.begin(), keys.end(), mt19937_64(n));
+    } else if(dist == REVERSE) {
+        reverse(keys.begin(), keys.end());
+    } else if(dist == ZIPFIAN) {
+        keys = zipfianKeys(scatteredKeys(n, 1, n + 1), n, 0.99, n + 2);
+    }
+    return keys;
+}
+
+// helpers that give the three containers the same interface, with insert
+// replacing the value of a key that is already there as the trees do
+template<typename Tree>
+void benchInsert(Tree& tree, Key key)
+{
+    tree.insert(std::make_pair(key, key));
+}
+
+static void benchInsert(map<Key, Value>& tree, Key key)
+{
+    tree[key] = key;
+}
+
+template<typename Tree>
+void benchRemove(Tree& tree, Key key)
+{
+    tree.remove(key);
+}
+
+static void benchRemove(map<Key, Value>& tree, Key key)
+{
+    tree.erase(key);
+}
+
+// helper that runs one round of every operation on a fresh tree and adds
+// each one's time in ns to spent
+template<typename Tree>
+void runRound(const vector<Key>& keys, double spent[NUM_OPS])
+{
+    Tree tree;
+    Clock::time_point start = Clock::now();
+    for(size_t i = 0; i < keys.size(); ++i) benchInsert(tree, keys[i]);
+    Clock::time_point inserted = Clock::now();
+    for(size_t i = 0; i < keys.size(); ++i) sink += tree.find(keys[i])->second;
+    Clock::time_point found = Clock::now();
+    for(typename Tree::iterator it = tree.begin(); it != tree.end(); ++it) sink += it->second;
+    Clock::time_point iterated = Clock::now();
+    for(size_t i = 0; i < keys.size(); ++i) benchRemove(tree, keys[i]);
+    Clock::time_point removed = Clock::now();
+
+    spent[0] += chrono::duration<double, nano>(inserted - start).count();
+    spent[1] += chrono::duration<double, nano>(found - inserted).count();
+    spent[2] += chrono::duration<double, nano>(iterated - found).count();
+    spent[3] += chrono::duration<double, nano>(removed - iterated).count();
+}
+
+template<typename Tree>
+void runCase(const char* name, Distribution dist, size_t n, int repeats, vector<Result>& results)
+{
+    vector<Key> keys = makeKeys(dist, n);
+    // iterate visits each distinct key once, the others do one op per key
+    vector<Key> distinct(keys);
+    sort(distinct.begin(), distinct.end());
+    size_t items = unique(distinct.begin(), distinct.end()) - distinct.begin();
+
+    vector<vector<double> > perOp(NUM_OPS);
+    for(int r = 0; r < repeats; ++r) {
+        double spent[NUM_OPS] = { 0, 0, 0, 0 };
+        size_t rounds = 0;
+        do {
+            runRound<Tree>(keys, spent);
+            ++rounds;
+        } while(spent[0] + spent[1] + spent[2] + spent[3] < MIN_REPEAT_NS);
+        for(int op = 0; op < NUM_OPS; ++op) {
+            perOp[op].push_back(spent[op] / rounds / (op == 2 ? items : n));
+        }
+    }
+
+    cout << left << setw(18) << name << setw(12) << DISTRIBUTIONS[dist] << right << setw(10) << n
+         << fixed << setprecision(1);
+    for(int op = 0; op < NUM_OPS; ++op) {
+        sort(perOp[op].begin(), perOp[op].end());
+        Result result = { name, DISTRIBUTIONS[dist], n, OPS[op], perOp[op][perOp[op].size() / 2] };
+        results.push_back(result);
+        cout << setw(11) << result.nsPerOp;
+    }
+    cout << endl;
+}
+
+// helper that writes the results as one JSON object
+static void writeJson(ostream& out, const vector<Result>& results, int repeats)
+{
+    out << "{\n  \"suite\": \"hw4-trees\",\n  \"version\": 1,\n  \"unit\": \"ns/op\",\n"
+        << "  \"compiler\": \"" << __VERSION__ << "\",\n  \"repeats\": " << repeats << ",\n"
+        << "  \"results\": [\n" << fixed << setprecision(2);
+    for(size_t i = 0; i < results.size(); ++i) {
+        const Result& r = results[i];
+        out << "    {\"tree\": \"" << r.tree << "\", \"distribution\": \"" << r.distribution
+            << "\", \"size\": " << r.size << ", \"op\": \"" << r.op << "\", \"ns_per_op\": " << r.nsPerOp
+            << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    out << "  ]\n}\n";
+}
+
+int main(int argc, char* argv[])
+{
+    string jsonPath;
+    int repeats = 3;
+    size_t maxChain = 20000;
+    vector<size_t> sizes;
+    for(int i = 1; i < argc; ++i) {
+        if(strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else if(strcmp(argv[i], "--repeats") == 0 && i + 1 < argc) {
+            repeats = max(1, atoi(argv[++i]));
+        } else if(strcmp(argv[i], "--max-chain") == 0 && i + 1 < argc) {
+            maxChain = strtoul(argv[++i], NULL, 10);
+        } else {
+            size_t n = strtoul(argv[i], NULL, 10);
+            if(n == 0) {
+                cerr << "usage: " << argv[0] << " [--json file] [--repeats n] [--max-chain n] [sizes...]" << endl;
+                return 1;
+            }
+            sizes.push_back(n);
+        }
+    }
+    if(sizes.empty()) {
+        size_t defaults[] = { 1000, 10000, 100000, 1000000 };
+        sizes.assign(defaults, defaults + 4);
+    }
+
+    cout << "ns per operation, median of " << repeats << endl;
+    cout << left << setw(18) << "tree" << setw(12) << "keys" << right << setw(10) << "size";
+    for(int op = 0; op < NUM_OPS; ++op) cout << setw(11) << OPS[op];
+    cout << endl;
+
+    vector<Result> results;
+    for(size_t s = 0; s < sizes.size(); ++s) {
+        for(int d = SEQUENTIAL; d <= ZIPFIAN; ++d) {
+            Distribution dist = static_cast<Distribution>(d);
+            bool chain = dist == SEQUENTIAL || dist == REVERSE;
+            if(!chain || sizes[s] <= maxChain) {
+                runCase<BinarySearchTree<Key, Value> >("BinarySearchTree", dist, sizes[s], repeats, results);
+            }
+            runCase<AVLTree<Key, Value> >("AVLTree", dist, sizes[s], repeats, results);
+            runCase<map<Key, Value> >("std::map", dist, sizes[s], repeats, results);
+        }
+    }
+
+    if(!jsonPath.empty()) {
+        ofstream out(jsonPath.c_str());
+        writeJson(out, results, repeats);
+        if(!out) {
+            cerr << "cannot write " << jsonPath << endl;
+            return 1;
+        }
+        cout << "results written to " << jsonPath << endl;
+    }
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include <iostream>
+#include <iomanip>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <map>
+#include <string>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+#include "bst.h"
+#include "avlbst.h"
+#include "bplustree.h"
+#include "bench_keys.h"
+#include "tree_latency.h"
+#include "tree_trace.h"
+
+using namespace std;
+
+// Replays a trace made by TraceRecorder (see tree_trace.h) against
+// BinarySearchTree, AVLTree, OrderStatTree, BPlusTree and std::map, each
+// starting empty. Every tree runs the trace twice: once flat out for the
+// throughput, and once timing each operation for p50/p99/p999/max
+// latencies per kind of operation.
+//
+// With --sample it instead records a trace of a made up workload, so there
+// is something to replay: Zipfian keys, half finds, 30% inserts, 10%
+// removes and 10% short ranges.
+// usage: ./trace-replay file.trace
+//        ./trace-replay --sample file.trace [numOps]
+
+typedef chrono::steady_clock Clock;
+typedef uint64_t Key;
+typedef uint64_t Value;
+typedef TraceEvent<Key, Value> Event;
+
+static const int NUM_TRACE_OPS = 4;
+static const char* const TRACE_OP_NAMES[NUM_TRACE_OPS] = { "insert", "remove", "find", "range" };
+
+// results are added up here, where the compiler cannot drop the work
+uint64_t sink = 0;
+
+// helpers that give every tree the same interface, with insert replacing
+// the value of a key that is already there as the trees do
+template<typename Tree>
+void replayInsert(Tree& tree, Key key, Value value)
+{
+    tree.insert(std::make_pair(key, value));
+}
+
+static void replayInsert(map<Key, Value>& tree, Key key, Value value)
+{
+    tree[key] = value;
+}
+
+template<typename Tree>
+void replayRemove(Tree& tree, Key key)
+{
+    tree.remove(key);
+}
+
+static void replayRemove(map<Key, Value>& tree, Key key)
+{
+    tree.erase(key);
+}
+
+// helper that runs one event against a tree
+template<typename Tree>
+inline void replayEvent(Tree& tree, const Event& event)
+{
+    switch(event.op) {
+    case TRACE_INSERT:
+        replayInsert(tree, event.key, event.value);
+        break;
+    case TRACE_REMOVE:
+        replayRemove(tree, event.key);
+        break;
+    case TRACE_FIND:
+        sink += tree.find(event.key) != tree.end();
+        break;
+    case TRACE_RANGE:
+        for(typename Tree::iterator it = tree.lower_bound(event.key); it != tree.end() && it->first < event.hi; ++it) {
+            sink += it->second;
+        }
+        break;
+    }
+}
+
+template<typename Tree>
+void run(const char* name, const vector<Event>& events)
+{
+    double seconds;
+    {
+        Tree tree;
+        Clock::time_point start = Clock::now();
+        for(size_t i = 0; i < events.size(); ++i) replayEvent(tree, events[i]);
+        seconds = chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    LatencyHistogram latency[NUM_TRACE_OPS];
+    {
+        Tree tree;
+        for(size_t i = 0; i < events.size(); ++i) {
+            Clock::time_point start = Clock::now();
+            replayEvent(tree, events[i]);
+            Clock::duration spent = Clock::now() - start;
+            latency[events[i].op - TRACE_INSERT].record(chrono::duration_cast<chrono::nanoseconds>(spent).count());
+        }
+    }
+
+    cout << name << ": " << fixed << setprecision(3) << seconds << " s, "
+         << setprecision(2) << events.size() / seconds / 1e6 << " Mops/s" << endl;
+    for(int op = 0; op < NUM_TRACE_OPS; ++op) {
+        if(latency[op].count() == 0) continue;
+        cout << "    " << left << setw(8) << TRACE_OP_NAMES[op] << right << setw(12) << latency[op].count()
+             << setw(10) << latency[op].percentile(50) << setw(10) << latency[op].percentile(99)
+             << setw(10) << latency[op].percentile(99.9) << setw(12) << latency[op].max() << endl;
+    }
+}
+
+// helper that records the sample workload described at the top
+static void recordSample(const string& path, size_t numOps)
+{
+    // Zipfian ranks (exponent 0.99) over a million keys, scattered over the key space
+    const size_t universe = 1000000;
+    ZipfianDistribution zipf(universe, 0.99);
+    vector<Key> scattered = scatteredKeys(universe, 16, 21);
+    mt19937_64 rng(22);
+
+    AVLTree<Key, Value> tree;
+    TraceRecorder<Key, Value> recorder(tree, path);
+    for(size_t i = 0; i < numOps; ++i) {
+        Key key = scattered[zipf(rng)];
+        unsigned mix = rng() % 10;
+        if(mix < 5) {
+            sink += recorder.find(key) != tree.end();
+        } else if(mix < 8) {
+            recorder.insert(std::make_pair(key, (Value)i));
+        } else if(mix < 9) {
+            recorder.remove(key);
+        } else {
+            recorder.for_each_in_range(key, key + 16 * 32, [](const std::pair<const Key, Value>& item) { sink += item.second; });
+        }
+    }
+    recorder.close();
+    cout << "recorded " << recorder.count() << " operations to " << path << endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc >= 3 && strcmp(argv[1], "--sample") == 0) {
+        recordSample(argv[2], argc > 3 ? strtoul(argv[3], NULL, 10) : 2000000);
+        return 0;
+    }
+    if(argc != 2) {
+        cerr << "usage: " << argv[0] << " file.trace" << endl
+             << "       " << argv[0] << " --sample file.trace [numOps]" << endl;
+        return 1;
+    }
+
+    vector<Event> events;
+    try {
+        events = readTrace<Key, Value>(argv[1]);
+    } catch(const std::runtime_error& e) {
+        cerr << e.what() << endl;
+        return 1;
+    }
+
+    cout << events.size() << " operations; latencies in ns" << endl;
+    cout << "    " << left << setw(8) << "op" << right << setw(12) << "count" << setw(10) << "p50"
+         << setw(10) << "p99" << setw(10) << "p999" << setw(12) << "max" << endl;
+    run<BinarySearchTree<Key, Value> >("BinarySearchTree", events);
+    run<AVLTree<Key, Value> >("AVLTree", events);
+    run<OrderStatTree<Key, Value> >("OrderStatTree", events);
+    run<BPlusTree<Key, Value> >("BPlusTree", events);
+    run<map<Key, Value> >("std::map", events);
+    return 0;
+}
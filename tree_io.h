@@ -0,0 +1,223 @@
+#ifndef TREE_IO_H
+#define TREE_IO_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "bst.h"
+#include "avlbst.h"
+
+/**
+* Saving a tree to a file and loading it back, for keys and values that are
+* trivially copyable (plain numbers, fixed size structs).
+*
+* The file is a TreeFileHeader followed by the items as an array of
+* std::pair<Key, Value> in key order, written with one sequential pass over
+* the tree. Loading maps the file into memory and hands that array straight
+* to AVLTree::assign(), which sees it is sorted and builds a balanced tree
+* in linear time, so nothing is parsed or inserted one item at a time.
+*
+* Files are only meant to be read on the kind of machine that wrote them:
+* the header records the byte order and item layout, and a file that does
+* not match is refused rather than converted.
+*
+* The padding std::pair puts around the key and value is written as
+* zeros. Padding inside a struct key or value is part of its bytes and is
+* written as whatever the object holds, so zero such structs (memset)
+* before filling them in if stray memory must not end up in the file.
+*/
+
+/**
+* The fixed 64 byte start of a tree file. Its size keeps the items after
+* it aligned for any key and value.
+*/
+struct TreeFileHeader
+{
+    char magic[8];                // TREE_FILE_MAGIC
+    std::uint32_t version;        // TREE_FILE_VERSION
+    std::uint32_t byteOrder;      // TREE_FILE_BYTE_ORDER as the writer stored it
+    std::uint32_t keySize;        // sizeof(Key)
+    std::uint32_t valueSize;      // sizeof(Value)
+    std::uint32_t itemSize;       // sizeof(std::pair<Key, Value>), padding included
+    std::uint32_t valueOffset;    // where the value starts inside an item
+    std::uint64_t count;          // number of items
+    std::uint32_t height;         // height of the tree that was saved
+    std::uint32_t reserved[5];    // zero, room for later versions
+};
+
+static const char TREE_FILE_MAGIC[8] = { 'h', 'w', '4', 't', 'r', 'e', 'e', '\0' };
+static const std::uint32_t TREE_FILE_VERSION = 1;
+static const std::uint32_t TREE_FILE_BYTE_ORDER = 0x01020304;
+
+/**
+* A read-only mapping of a whole file, unmapped when it goes away.
+*/
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    ~MappedFile();
+
+    const char* data() const;
+    std::size_t size() const;
+
+private:
+    // no copying, the mapping is owned
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    void* data_;
+    std::size_t size_;
+};
+
+inline MappedFile::MappedFile(const std::string& path)
+    : data_(NULL), size_(0)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0) throw std::runtime_error("cannot open " + path);
+    struct stat info;
+    if(fstat(fd, &info) != 0){
+        close(fd);
+        throw std::runtime_error("cannot stat " + path);
+    }
+    size_ = static_cast<std::size_t>(info.st_size);
+    if(size_ > 0){
+        data_ = mmap(NULL, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data_ == MAP_FAILED){
+            close(fd);
+            throw std::runtime_error("cannot map " + path);
+        }
+        // the whole file is read once front to back
+        madvise(data_, size_, MADV_SEQUENTIAL);
+    }
+    // the mapping stays valid without the descriptor
+    close(fd);
+}
+
+inline MappedFile::~MappedFile()
+{
+    if(data_ != NULL){
+        munmap(data_, size_);
+    }
+}
+
+inline const char* MappedFile::data() const
+{
+    return static_cast<const char*>(data_);
+}
+
+inline std::size_t MappedFile::size() const
+{
+    return size_;
+}
+
+// helper that fills in the header for a tree of the given key and value types
+template<typename Key, typename Value>
+TreeFileHeader makeTreeFileHeader(std::uint64_t count, int height)
+{
+    typedef std::pair<Key, Value> Item;
+    TreeFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TREE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TREE_FILE_VERSION;
+    header.byteOrder = TREE_FILE_BYTE_ORDER;
+    header.keySize = sizeof(Key);
+    header.valueSize = sizeof(Value);
+    header.itemSize = sizeof(Item);
+    header.valueOffset = static_cast<std::uint32_t>(offsetof(Item, second));
+    header.count = count;
+    header.height = static_cast<std::uint32_t>(height);
+    return header;
+}
+
+/**
+* Writes the tree to path, replacing the file if it exists. Works for any
+* BinarySearchTree; the items go out in key order through a buffer so the
+* file is written in large sequential pieces.
+*/
+template<typename Key, typename Value>
+void saveTree(const BinarySearchTree<Key, Value>& tree, const std::string& path)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "saveTree() needs trivially copyable keys and values");
+    typedef std::pair<Key, Value> Item;
+
+    FILE* out = std::fopen(path.c_str(), "wb");
+    if(out == NULL) throw std::runtime_error("cannot create " + path);
+    TreeFileHeader header = makeTreeFileHeader<Key, Value>(tree.size(), tree.height());
+    bool ok = std::fwrite(&header, sizeof(header), 1, out) == 1;
+
+    // about 1MB at a time, laid out as an array of Items. The buffer is
+    // zeroed first so the padding between key and value, which copying a
+    // pair leaves uninitialized, goes out as zeros
+    const std::size_t chunk = (1 << 20) / sizeof(Item) + 1;
+    std::vector<char> buffer(chunk * sizeof(Item));
+    typename BinarySearchTree<Key, Value>::const_iterator it = tree.cbegin();
+    while(ok && it != tree.cend()){
+        std::memset(buffer.data(), 0, buffer.size());
+        std::size_t n = 0;
+        for(char* slot = buffer.data(); it != tree.cend() && n < chunk; ++it, ++n, slot += sizeof(Item)){
+            std::memcpy(slot, &it->first, sizeof(Key));
+            std::memcpy(slot + offsetof(Item, second), &it->second, sizeof(Value));
+        }
+        ok = std::fwrite(buffer.data(), sizeof(Item), n, out) == n;
+    }
+    ok = std::fclose(out) == 0 && ok;
+    if(!ok) throw std::runtime_error("cannot write " + path);
+}
+
+/**
+* Replaces the contents of tree with the items saved in path. Throws
+* std::runtime_error if the file cannot be read or was not written by
+* saveTree() for these key and value types on this kind of machine; the
+* tree is left as it was then.
+*/
+template<typename Key, typename Value, bool CountSizes>
+void loadTree(AVLTree<Key, Value, CountSizes>& tree, const std::string& path)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "loadTree() needs trivially copyable keys and values");
+    typedef std::pair<Key, Value> Item;
+
+    MappedFile file(path);
+    TreeFileHeader header;
+    if(file.size() < sizeof(header)) throw std::runtime_error(path + " is not a tree file");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(std::memcmp(header.magic, TREE_FILE_MAGIC, sizeof(header.magic)) != 0){
+        throw std::runtime_error(path + " is not a tree file");
+    }
+    if(header.version != TREE_FILE_VERSION){
+        throw std::runtime_error(path + " has tree file version " + std::to_string(header.version)
+                                 + ", expected " + std::to_string(TREE_FILE_VERSION));
+    }
+    TreeFileHeader expected = makeTreeFileHeader<Key, Value>(header.count, header.height);
+    if(header.byteOrder != expected.byteOrder || header.keySize != expected.keySize
+       || header.valueSize != expected.valueSize || header.itemSize != expected.itemSize
+       || header.valueOffset != expected.valueOffset){
+        throw std::runtime_error(path + " holds a different key, value or byte order");
+    }
+    // exactly count items must follow, checked without overflowing count * sizeof(Item)
+    std::size_t itemBytes = file.size() - sizeof(header);
+    if(header.count > itemBytes / sizeof(Item)){
+        throw std::runtime_error(path + " is truncated");
+    }
+    if(itemBytes != header.count * sizeof(Item)){
+        throw std::runtime_error(path + " has bytes past its last item");
+    }
+
+    // the items are already laid out as an array, straight after the header
+    const Item* items = reinterpret_cast<const Item*>(file.data() + sizeof(header));
+    tree.assign(items, items + header.count);
+}
+
+#endif
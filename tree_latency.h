@@ -0,0 +1,281 @@
+#ifndef TREE_LATENCY_H
+#define TREE_LATENCY_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+/**
+* A histogram of latencies in ns in the style of HdrHistogram: values are
+* counted in buckets that keep about 3% precision from 1 ns up to days, so
+* recording one is a bit scan and an increment and the memory is fixed.
+* Percentiles are read back as the top of the bucket they fall in, and the
+* largest value is kept exactly.
+*/
+class LatencyHistogram
+{
+public:
+    // constexpr so thread_local histograms need no guard to set them up
+    constexpr LatencyHistogram() : counts_(), total_(0), max_(0) { }
+
+    void record(std::uint64_t ns);
+    void merge(const LatencyHistogram& other);
+    void reset();
+
+    std::uint64_t count() const;
+    std::uint64_t max() const;
+    std::uint64_t percentile(double p) const;
+
+private:
+    // each power of two is split into 2^SUB_BITS buckets
+    static const int SUB_BITS = 5;
+    static const std::uint64_t SUB_COUNT = std::uint64_t(1) << SUB_BITS;
+    // values from 2^MAX_BITS ns (about 39 hours) up share the last bucket
+    static const int MAX_BITS = 47;
+    static const std::size_t BUCKETS = (MAX_BITS - SUB_BITS + 1) * SUB_COUNT;
+
+    static std::size_t bucketFor(std::uint64_t ns);
+    static std::uint64_t bucketTop(std::size_t bucket);
+
+    std::uint64_t counts_[BUCKETS];
+    std::uint64_t total_;
+    std::uint64_t max_;
+};
+
+// helper that finds the bucket a value is counted in
+inline std::size_t LatencyHistogram::bucketFor(std::uint64_t ns)
+{
+    if(ns < 2 * SUB_COUNT){
+        return static_cast<std::size_t>(ns);
+    }
+    if(ns >> MAX_BITS != 0){
+        return BUCKETS - 1;
+    }
+    // the top SUB_BITS + 1 bits of the value pick the bucket
+#if defined(__GNUC__)
+    int shift = 63 - __builtin_clzll(ns) - SUB_BITS;
+#else
+    int shift = -SUB_BITS;
+    while(ns >> (shift + SUB_BITS + 1) != 0){
+        ++shift;
+    }
+#endif
+    return static_cast<std::size_t>(shift * SUB_COUNT + (ns >> shift));
+}
+
+// helper that gives the largest value counted in a bucket
+inline std::uint64_t LatencyHistogram::bucketTop(std::size_t bucket)
+{
+    if(bucket < 2 * SUB_COUNT){
+        return bucket;
+    }
+    int shift = static_cast<int>(bucket / SUB_COUNT) - 1;
+    std::uint64_t sub = bucket % SUB_COUNT + SUB_COUNT;
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+* Counts one value.
+*/
+inline void LatencyHistogram::record(std::uint64_t ns)
+{
+    ++counts_[bucketFor(ns)];
+    ++total_;
+    if(ns > max_){
+        max_ = ns;
+    }
+}
+
+/**
+* Adds the values counted by other, e.g. to combine histograms that
+* several threads handed over.
+*/
+inline void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+    for(std::size_t i = 0; i < BUCKETS; ++i){
+        counts_[i] += other.counts_[i];
+    }
+    total_ += other.total_;
+    if(other.max_ > max_){
+        max_ = other.max_;
+    }
+}
+
+/**
+* Forgets every value counted so far.
+*/
+inline void LatencyHistogram::reset()
+{
+    *this = LatencyHistogram();
+}
+
+/**
+* Returns how many values were counted.
+*/
+inline std::uint64_t LatencyHistogram::count() const
+{
+    return total_;
+}
+
+/**
+* Returns the largest value counted, 0 if there are none.
+*/
+inline std::uint64_t LatencyHistogram::max() const
+{
+    return max_;
+}
+
+/**
+* Returns the value that p percent of the values are at or below, e.g.
+* percentile(99.9). 0 if nothing was counted.
+*/
+inline std::uint64_t LatencyHistogram::percentile(double p) const
+{
+    if(total_ == 0){
+        return 0;
+    }
+    // the rank of the value wanted, counting from 1
+    std::uint64_t rank = static_cast<std::uint64_t>(p / 100.0 * total_ + 0.999999);
+    if(rank == 0){
+        rank = 1;
+    }
+    std::uint64_t seen = 0;
+    for(std::size_t i = 0; i < BUCKETS; ++i){
+        seen += counts_[i];
+        if(seen >= rank){
+            // the top of the bucket can overshoot the largest value itself
+            return bucketTop(i) < max_ ? bucketTop(i) : max_;
+        }
+    }
+    return max_;
+}
+
+/**
+* The tree operations whose latency can be recorded.
+*/
+enum TreeOp
+{
+    TREE_OP_INSERT,     // insert, emplace, try_emplace and insert_or_assign
+    TREE_OP_REMOVE,
+    TREE_OP_FIND,
+    TREE_OP_INCREMENT,  // ++ on any iterator
+    NUM_TREE_OPS
+};
+
+/**
+* Returns the name a tree operation is written out under.
+*/
+inline const char* treeOpName(TreeOp op)
+{
+    static const char* const names[NUM_TREE_OPS] = { "insert", "remove", "find", "increment" };
+    return names[op];
+}
+
+/**
+* Latency recording for the tree operations, opt-in at build time.
+*
+* When TREE_LATENCY is defined (make DEFS=-DTREE_LATENCY) insert, remove,
+* find and iterator ++ on BinarySearchTree and AVLTree each time themselves
+* with two steady_clock reads and count the result in a histogram of the
+* calling thread, so threads never share one. Otherwise TREE_TIME() is
+* an empty statement and the histograms stay empty.
+*
+* The clock reads cost about as much as an iterator step, so ++ looks
+* slower while it is being timed; the spread of the other operations is
+* what this is for.
+*/
+#ifdef TREE_LATENCY
+static const bool TREE_LATENCY_ENABLED = true;
+#else
+static const bool TREE_LATENCY_ENABLED = false;
+#endif
+
+/**
+* Returns the calling thread's histogram for op.
+*/
+inline LatencyHistogram& treeLatency(TreeOp op)
+{
+    static thread_local LatencyHistogram histograms[NUM_TREE_OPS];
+    return histograms[op];
+}
+
+/**
+* Empties the calling thread's histograms.
+*/
+inline void resetTreeLatencies()
+{
+    for(int op = 0; op < NUM_TREE_OPS; ++op){
+        treeLatency(static_cast<TreeOp>(op)).reset();
+    }
+}
+
+/**
+* Writes a table of count, p50, p99, p999 and max in ns for each operation
+* the calling thread did.
+*/
+inline void writeTreeLatencies(std::ostream& out)
+{
+    out << std::left << std::setw(12) << "op" << std::right << std::setw(14) << "count"
+        << std::setw(10) << "p50" << std::setw(10) << "p99" << std::setw(10) << "p999"
+        << std::setw(12) << "max" << "\n";
+    for(int op = 0; op < NUM_TREE_OPS; ++op){
+        const LatencyHistogram& histogram = treeLatency(static_cast<TreeOp>(op));
+        out << std::left << std::setw(12) << treeOpName(static_cast<TreeOp>(op)) << std::right
+            << std::setw(14) << histogram.count() << std::setw(10) << histogram.percentile(50)
+            << std::setw(10) << histogram.percentile(99) << std::setw(10) << histogram.percentile(99.9)
+            << std::setw(12) << histogram.max() << "\n";
+    }
+}
+
+/**
+* Writes the table from writeTreeLatencies() to path, replacing the file.
+* Throws std::runtime_error if it cannot be written.
+*/
+inline void dumpTreeLatencies(const std::string& path)
+{
+    std::ofstream out(path.c_str());
+    out << "# tree operation latencies in ns\n";
+    writeTreeLatencies(out);
+    out.close();
+    if(!out){
+        throw std::runtime_error("cannot write " + path);
+    }
+}
+
+/**
+* Times the scope it lives in and counts it as one op.
+*/
+class TreeLatencyTimer
+{
+public:
+    explicit TreeLatencyTimer(TreeOp op);
+    ~TreeLatencyTimer();
+
+private:
+    TreeOp op_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+inline TreeLatencyTimer::TreeLatencyTimer(TreeOp op)
+    : op_(op), start_(std::chrono::steady_clock::now())
+{
+}
+
+inline TreeLatencyTimer::~TreeLatencyTimer()
+{
+    std::chrono::steady_clock::duration spent = std::chrono::steady_clock::now() - start_;
+    treeLatency(op_).record(std::chrono::duration_cast<std::chrono::nanoseconds>(spent).count());
+}
+
+#ifdef TREE_LATENCY
+#define TREE_TIME(op) TreeLatencyTimer treeLatencyTimer(op)
+#else
+#define TREE_TIME(op) ((void)0)
+#endif
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef TREE_STATS_H
+#define TREE_STATS_H
+
+#include <cstdint>
+
+/**
+* Counters for the work BinarySearchTree and AVLTree do on their hot
+* paths, for telling whether a slowdown comes from the shape of the tree
+* (comparisons, descent steps), rotation churn or allocation.
+*
+* They are only compiled in when TREE_STATS is defined (make
+* DEFS=-DTREE_STATS). Otherwise TREE_STAT() is an empty statement, the
+* trees hold no extra state and treeOpStats() always reads zero, so normal
+* builds pay nothing for them.
+*
+* The counters are kept per thread, so readers sharing a tree under a
+* read lock never write to the same cache line. Read them on the thread
+* that did the work. The set operations fork subproblems onto a
+* ForkJoinPool's workers; those hand their counts back with
+* takeTreeOpStats() and addTreeOpStats(), so a unite() or subtract() is
+* counted on the thread that called it like everything else.
+*/
+struct TreeOpStats
+{
+    std::uint64_t comparisons;    // KeyCompare<Key>::less calls
+    std::uint64_t descents;       // walks from the root looking for a key or position
+    std::uint64_t descentSteps;   // nodes visited by those walks
+    std::uint64_t rotateLefts;    // rotateleft() calls
+    std::uint64_t rotateRights;   // rotateright() calls
+    std::uint64_t nodeSwaps;      // nodeSwap() calls made by remove
+    std::uint64_t retraceSteps;   // nodes visited fixing balance, heights or sizes on the way back up
+    std::uint64_t allocations;    // nodes made by allocateNode()
+    std::uint64_t frees;          // nodes given back one at a time by freeNode()
+};
+
+#ifdef TREE_STATS
+static const bool TREE_STATS_ENABLED = true;
+
+// helper that holds the calling thread's counters
+inline TreeOpStats& treeOpCounters()
+{
+    // plain data, so this is zeroed without any guard
+    static thread_local TreeOpStats counters;
+    return counters;
+}
+
+#define TREE_STAT(counter) (++treeOpCounters().counter)
+#else
+static const bool TREE_STATS_ENABLED = false;
+
+#define TREE_STAT(counter) ((void)0)
+#endif
+
+/**
+* Returns a copy of the calling thread's counters, all zero when the
+* counters are not compiled in.
+*/
+inline TreeOpStats treeOpStats()
+{
+#ifdef TREE_STATS
+    return treeOpCounters();
+#else
+    TreeOpStats none = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    return none;
+#endif
+}
+
+/**
+* Zeroes the calling thread's counters, e.g. before the operations being
+* measured.
+*/
+inline void resetTreeOpStats()
+{
+#ifdef TREE_STATS
+    TreeOpStats none = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+    treeOpCounters() = none;
+#endif
+}
+
+/**
+* Returns what the calling thread has counted since before was read with
+* treeOpStats(), and sets its counters back to before, for work that runs
+* on one thread but should be counted on another.
+*/
+inline TreeOpStats takeTreeOpStats(const TreeOpStats& before)
+{
+#ifdef TREE_STATS
+    TreeOpStats& now = treeOpCounters();
+    TreeOpStats taken = {now.comparisons - before.comparisons, now.descents - before.descents,
+                         now.descentSteps - before.descentSteps, now.rotateLefts - before.rotateLefts,
+                         now.rotateRights - before.rotateRights, now.nodeSwaps - before.nodeSwaps,
+                         now.retraceSteps - before.retraceSteps, now.allocations - before.allocations,
+                         now.frees - before.frees};
+    now = before;
+    return taken;
+#else
+    return before;
+#endif
+}
+
+/**
+* Adds stats, e.g. taken from another thread with takeTreeOpStats(), to
+* the calling thread's counters.
+*/
+inline void addTreeOpStats(const TreeOpStats& stats)
+{
+#ifdef TREE_STATS
+    TreeOpStats& now = treeOpCounters();
+    now.comparisons += stats.comparisons;
+    now.descents += stats.descents;
+    now.descentSteps += stats.descentSteps;
+    now.rotateLefts += stats.rotateLefts;
+    now.rotateRights += stats.rotateRights;
+    now.nodeSwaps += stats.nodeSwaps;
+    now.retraceSteps += stats.retraceSteps;
+    now.allocations += stats.allocations;
+    now.frees += stats.frees;
+#else
+    (void)stats;
+#endif
+}
+
+#endif
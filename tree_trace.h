@@ -0,0 +1,311 @@
+#ifndef TREE_TRACE_H
+#define TREE_TRACE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include "bst.h"
+#include "tree_io.h"
+
+/**
+* Recording the operations a program does on a tree so they can be
+* replayed later against any tree, e.g. to try the access pattern of real
+* data without the data itself (see trace-replay.cpp).
+*
+* A trace file is a TraceFileHeader followed by one record per operation:
+* a TraceOp byte and then the operation's key, key and value (insert) or
+* low and high key (range), stored as their raw bytes with no padding.
+* Like tree files (see tree_io.h) traces need trivially copyable keys and
+* values, are only read on the kind of machine that wrote them, and carry
+* whatever padding bytes a struct key or value holds, so zero those
+* structs before filling them in.
+*/
+
+/**
+* The fixed 32 byte start of a trace file.
+*/
+struct TraceFileHeader
+{
+    char magic[8];                // TRACE_FILE_MAGIC
+    std::uint32_t version;        // TRACE_FILE_VERSION
+    std::uint32_t byteOrder;      // TREE_FILE_BYTE_ORDER as the writer stored it
+    std::uint32_t keySize;        // sizeof(Key)
+    std::uint32_t valueSize;      // sizeof(Value)
+    std::uint32_t reserved[2];    // zero, room for later versions
+};
+
+static const char TRACE_FILE_MAGIC[8] = { 'h', 'w', '4', 't', 'r', 'a', 'c', 'e' };
+static const std::uint32_t TRACE_FILE_VERSION = 1;
+
+/**
+* The operations a trace records, as stored in the first byte of a record.
+*/
+enum TraceOp
+{
+    TRACE_INSERT = 1,   // key and value, replacing the value of a key already there
+    TRACE_REMOVE = 2,   // key
+    TRACE_FIND = 3,     // key
+    TRACE_RANGE = 4     // lo and hi, visiting every item with lo <= key < hi
+};
+
+/**
+* One operation read back from a trace. hi is only set for TRACE_RANGE
+* and value only for TRACE_INSERT.
+*/
+template<typename Key, typename Value>
+struct TraceEvent
+{
+    TraceOp op;
+    Key key;
+    Key hi;
+    Value value;
+};
+
+// helper that fills in the header for a trace of the given key and value types
+template<typename Key, typename Value>
+TraceFileHeader makeTraceFileHeader()
+{
+    TraceFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic));
+    header.version = TRACE_FILE_VERSION;
+    header.byteOrder = TREE_FILE_BYTE_ORDER;
+    header.keySize = sizeof(Key);
+    header.valueSize = sizeof(Value);
+    return header;
+}
+
+/**
+* Stands in front of a tree and does every operation on it while writing
+* it to a trace file. Works for any BinarySearchTree, AVLTree included:
+* inserts go through insert_or_assign(), which makes the tree's own kind
+* of node even through a base class reference.
+*
+* Records are gathered in memory and written out in large pieces. close()
+* writes what is left and reports errors; the destructor closes too but
+* has to keep quiet about them.
+*/
+template<typename Key, typename Value>
+class TraceRecorder
+{
+public:
+    TraceRecorder(BinarySearchTree<Key, Value>& tree, const std::string& path);
+    ~TraceRecorder();
+
+    void insert(const std::pair<const Key, Value>& keyValuePair);
+    void remove(const Key& key);
+    typename BinarySearchTree<Key, Value>::iterator find(const Key& key);
+    template<typename Fn>
+    void for_each_in_range(const Key& lo, const Key& hi, Fn fn);
+
+    std::uint64_t count() const;
+    void close();
+
+private:
+    // no copying, the file is owned
+    TraceRecorder(const TraceRecorder&);
+    TraceRecorder& operator=(const TraceRecorder&);
+
+    void append(TraceOp op, const void* first, std::size_t firstSize, const void* second, std::size_t secondSize);
+    void flush();
+
+    // records are written out once this many bytes are waiting
+    static const std::size_t BUFFER_BYTES = 1 << 20;
+
+    BinarySearchTree<Key, Value>& tree_;
+    std::string path_;
+    std::FILE* out_;
+    std::vector<char> buffer_;
+    std::uint64_t count_;
+    bool failed_;
+};
+
+/**
+* Starts a trace at path, replacing the file if it exists, for operations
+* on tree. Throws std::runtime_error if the file cannot be made.
+*/
+template<typename Key, typename Value>
+TraceRecorder<Key, Value>::TraceRecorder(BinarySearchTree<Key, Value>& tree, const std::string& path)
+    : tree_(tree), path_(path), out_(NULL), count_(0), failed_(false)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "TraceRecorder needs trivially copyable keys and values");
+    out_ = std::fopen(path.c_str(), "wb");
+    if(out_ == NULL) throw std::runtime_error("cannot create " + path);
+    buffer_.reserve(BUFFER_BYTES + sizeof(TraceFileHeader) + 1 + 2 * (sizeof(Key) + sizeof(Value)));
+    TraceFileHeader header = makeTraceFileHeader<Key, Value>();
+    buffer_.insert(buffer_.end(), reinterpret_cast<const char*>(&header),
+                   reinterpret_cast<const char*>(&header) + sizeof(header));
+}
+
+template<typename Key, typename Value>
+TraceRecorder<Key, Value>::~TraceRecorder()
+{
+    if(out_ != NULL){
+        flush();
+        std::fclose(out_);
+    }
+}
+
+/**
+* Inserts the item into the tree and records it.
+*/
+template<typename Key, typename Value>
+void TraceRecorder<Key, Value>::insert(const std::pair<const Key, Value>& keyValuePair)
+{
+    append(TRACE_INSERT, &keyValuePair.first, sizeof(Key), &keyValuePair.second, sizeof(Value));
+    tree_.insert_or_assign(keyValuePair.first, keyValuePair.second);
+}
+
+/**
+* Removes the key from the tree and records it.
+*/
+template<typename Key, typename Value>
+void TraceRecorder<Key, Value>::remove(const Key& key)
+{
+    append(TRACE_REMOVE, &key, sizeof(Key), NULL, 0);
+    tree_.remove(key);
+}
+
+/**
+* Looks the key up in the tree and records it.
+*/
+template<typename Key, typename Value>
+typename BinarySearchTree<Key, Value>::iterator TraceRecorder<Key, Value>::find(const Key& key)
+{
+    append(TRACE_FIND, &key, sizeof(Key), NULL, 0);
+    return tree_.find(key);
+}
+
+/**
+* Calls fn on every item with lo <= key < hi, see
+* BinarySearchTree::for_each_in_range(), and records the range.
+*/
+template<typename Key, typename Value>
+template<typename Fn>
+void TraceRecorder<Key, Value>::for_each_in_range(const Key& lo, const Key& hi, Fn fn)
+{
+    append(TRACE_RANGE, &lo, sizeof(Key), &hi, sizeof(Key));
+    tree_.for_each_in_range(lo, hi, fn);
+}
+
+/**
+* Returns how many operations have been recorded.
+*/
+template<typename Key, typename Value>
+std::uint64_t TraceRecorder<Key, Value>::count() const
+{
+    return count_;
+}
+
+/**
+* Writes out the rest of the trace and closes the file. Throws
+* std::runtime_error if any of the trace could not be written. Nothing is
+* recorded after this.
+*/
+template<typename Key, typename Value>
+void TraceRecorder<Key, Value>::close()
+{
+    if(out_ == NULL){
+        return;
+    }
+    flush();
+    failed_ = std::fclose(out_) != 0 || failed_;
+    out_ = NULL;
+    if(failed_) throw std::runtime_error("cannot write " + path_);
+}
+
+// helper that adds one record to the buffer
+template<typename Key, typename Value>
+void TraceRecorder<Key, Value>::append(TraceOp op, const void* first, std::size_t firstSize,
+                                       const void* second, std::size_t secondSize)
+{
+    if(out_ == NULL) throw std::logic_error("TraceRecorder used after close()");
+    buffer_.push_back(static_cast<char>(op));
+    buffer_.insert(buffer_.end(), static_cast<const char*>(first), static_cast<const char*>(first) + firstSize);
+    if(secondSize > 0){
+        buffer_.insert(buffer_.end(), static_cast<const char*>(second), static_cast<const char*>(second) + secondSize);
+    }
+    ++count_;
+    if(buffer_.size() >= BUFFER_BYTES){
+        flush();
+    }
+}
+
+// helper that writes the buffer to the file
+template<typename Key, typename Value>
+void TraceRecorder<Key, Value>::flush()
+{
+    if(!buffer_.empty() && std::fwrite(buffer_.data(), 1, buffer_.size(), out_) != buffer_.size()){
+        failed_ = true;
+    }
+    buffer_.clear();
+}
+
+/**
+* Reads every operation in the trace at path, in the order they were
+* recorded. Throws std::runtime_error if the file cannot be read, was not
+* written by a TraceRecorder for these key and value types on this kind
+* of machine, or ends part way through a record.
+*/
+template<typename Key, typename Value>
+std::vector<TraceEvent<Key, Value> > readTrace(const std::string& path)
+{
+    static_assert(std::is_trivially_copyable<Key>::value && std::is_trivially_copyable<Value>::value,
+                  "readTrace() needs trivially copyable keys and values");
+    MappedFile file(path);
+    TraceFileHeader header;
+    if(file.size() < sizeof(header)) throw std::runtime_error(path + " is not a trace file");
+    std::memcpy(&header, file.data(), sizeof(header));
+    if(std::memcmp(header.magic, TRACE_FILE_MAGIC, sizeof(header.magic)) != 0){
+        throw std::runtime_error(path + " is not a trace file");
+    }
+    if(header.version != TRACE_FILE_VERSION){
+        throw std::runtime_error(path + " has trace file version " + std::to_string(header.version)
+                                 + ", expected " + std::to_string(TRACE_FILE_VERSION));
+    }
+    TraceFileHeader expected = makeTraceFileHeader<Key, Value>();
+    if(header.byteOrder != expected.byteOrder || header.keySize != expected.keySize
+       || header.valueSize != expected.valueSize){
+        throw std::runtime_error(path + " holds a different key, value or byte order");
+    }
+
+    std::vector<TraceEvent<Key, Value> > events;
+    // the smallest record is an op and a key
+    events.reserve((file.size() - sizeof(header)) / (1 + sizeof(Key) + sizeof(Value)));
+    const char* at = file.data() + sizeof(header);
+    const char* end = file.data() + file.size();
+    while(at < end){
+        TraceEvent<Key, Value> event;
+        std::memset(&event, 0, sizeof(event));
+        // check the raw byte first, a TraceOp can only hold the known values
+        unsigned char op = static_cast<unsigned char>(*at++);
+        if(op < TRACE_INSERT || op > TRACE_RANGE){
+            throw std::runtime_error(path + " has an unknown operation at byte "
+                                     + std::to_string(at - 1 - file.data()));
+        }
+        event.op = static_cast<TraceOp>(op);
+        std::size_t secondSize = event.op == TRACE_INSERT ? sizeof(Value) : event.op == TRACE_RANGE ? sizeof(Key) : 0;
+        if(static_cast<std::size_t>(end - at) < sizeof(Key) + secondSize){
+            throw std::runtime_error(path + " is truncated");
+        }
+        std::memcpy(&event.key, at, sizeof(Key));
+        at += sizeof(Key);
+        if(event.op == TRACE_INSERT){
+            std::memcpy(&event.value, at, sizeof(Value));
+        } else if(event.op == TRACE_RANGE){
+            std::memcpy(&event.hi, at, sizeof(Key));
+        }
+        at += secondSize;
+        events.push_back(event);
+    }
+    return events;
+}
+
+#endif